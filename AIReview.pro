@@ -25,7 +25,7 @@ DEFINES += QT_DEPRECATED_WARNINGS
 CONFIG += c++11
 
 # 添加系统库支持
-LIBS += -lcups
+LIBS += -lcups -ljpeg
 
 SOURCES += \
         form.cpp \
@@ -35,7 +35,21 @@ SOURCES += \
         scanmanager.cpp \
         printmanager.cpp \
         exammanager.cpp \
-        devicemanager.cpp
+        devicemanager.cpp \
+        devicediscoveryworker.cpp \
+        processwatchdog.cpp \
+        esclclient.cpp \
+        ippclient.cpp \
+        pageprocessor.cpp \
+        stripimage.cpp \
+        pagebufferpool.cpp \
+        bitonal.cpp \
+        deskew.cpp \
+        examlayout.cpp \
+        regionextractor.cpp \
+        omrreader.cpp \
+        pagepreview.cpp \
+        previewbrowser.cpp
 
 HEADERS += \
         form.h \
@@ -44,7 +58,21 @@ HEADERS += \
         scanmanager.h \
         printmanager.h \
         exammanager.h \
-        devicemanager.h
+        devicemanager.h \
+        devicediscoveryworker.h \
+        processwatchdog.h \
+        esclclient.h \
+        ippclient.h \
+        pageprocessor.h \
+        stripimage.h \
+        pagebufferpool.h \
+        bitonal.h \
+        deskew.h \
+        examlayout.h \
+        regionextractor.h \
+        omrreader.h \
+        pagepreview.h \
+        previewbrowser.h
 
 FORMS += \
         form.ui \
@@ -0,0 +1,473 @@
+#include "bitonal.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+const int TiffFlushBytes = 64 * 1024;  // 编码数据累积到64KB写一次文件
+
+struct G4Code
+{
+    quint16 code;
+    quint8 length;
+};
+
+// 白色游程终止码 0-63
+const G4Code WhiteTerminating[] = {
+    {0x035, 8}, {0x007, 6}, {0x007, 4}, {0x008, 4}, {0x00b, 4}, {0x00c, 4}, {0x00e, 4}, {0x00f, 4},
+    {0x013, 5}, {0x014, 5}, {0x007, 5}, {0x008, 5}, {0x008, 6}, {0x003, 6}, {0x034, 6}, {0x035, 6},
+    {0x02a, 6}, {0x02b, 6}, {0x027, 7}, {0x00c, 7}, {0x008, 7}, {0x017, 7}, {0x003, 7}, {0x004, 7},
+    {0x028, 7}, {0x02b, 7}, {0x013, 7}, {0x024, 7}, {0x018, 7}, {0x002, 8}, {0x003, 8}, {0x01a, 8},
+    {0x01b, 8}, {0x012, 8}, {0x013, 8}, {0x014, 8}, {0x015, 8}, {0x016, 8}, {0x017, 8}, {0x028, 8},
+    {0x029, 8}, {0x02a, 8}, {0x02b, 8}, {0x02c, 8}, {0x02d, 8}, {0x004, 8}, {0x005, 8}, {0x00a, 8},
+    {0x00b, 8}, {0x052, 8}, {0x053, 8}, {0x054, 8}, {0x055, 8}, {0x024, 8}, {0x025, 8}, {0x058, 8},
+    {0x059, 8}, {0x05a, 8}, {0x05b, 8}, {0x04a, 8}, {0x04b, 8}, {0x032, 8}, {0x033, 8}, {0x034, 8}
+};
+
+// 黑色游程终止码 0-63
+const G4Code BlackTerminating[] = {
+    {0x037, 10}, {0x002, 3}, {0x003, 2}, {0x002, 2}, {0x003, 3}, {0x003, 4}, {0x002, 4}, {0x003, 5},
+    {0x005, 6}, {0x004, 6}, {0x004, 7}, {0x005, 7}, {0x007, 7}, {0x004, 8}, {0x007, 8}, {0x018, 9},
+    {0x017, 10}, {0x018, 10}, {0x008, 10}, {0x067, 11}, {0x068, 11}, {0x06c, 11}, {0x037, 11}, {0x028, 11},
+    {0x017, 11}, {0x018, 11}, {0x0ca, 12}, {0x0cb, 12}, {0x0cc, 12}, {0x0cd, 12}, {0x068, 12}, {0x069, 12},
+    {0x06a, 12}, {0x06b, 12}, {0x0d2, 12}, {0x0d3, 12}, {0x0d4, 12}, {0x0d5, 12}, {0x0d6, 12}, {0x0d7, 12},
+    {0x06c, 12}, {0x06d, 12}, {0x0da, 12}, {0x0db, 12}, {0x054, 12}, {0x055, 12}, {0x056, 12}, {0x057, 12},
+    {0x064, 12}, {0x065, 12}, {0x052, 12}, {0x053, 12}, {0x024, 12}, {0x037, 12}, {0x038, 12}, {0x027, 12},
+    {0x028, 12}, {0x058, 12}, {0x059, 12}, {0x02b, 12}, {0x02c, 12}, {0x05a, 12}, {0x066, 12}, {0x067, 12}
+};
+
+// 白色游程组合码 64-1728（步长64）
+const G4Code WhiteMakeup[] = {
+    {0x01b, 5}, {0x012, 5}, {0x017, 6}, {0x037, 7}, {0x036, 8}, {0x037, 8}, {0x064, 8}, {0x065, 8},
+    {0x068, 8}, {0x067, 8}, {0x0cc, 9}, {0x0cd, 9}, {0x0d2, 9}, {0x0d3, 9}, {0x0d4, 9}, {0x0d5, 9},
+    {0x0d6, 9}, {0x0d7, 9}, {0x0d8, 9}, {0x0d9, 9}, {0x0da, 9}, {0x0db, 9}, {0x098, 9}, {0x099, 9},
+    {0x09a, 9}, {0x018, 6}, {0x09b, 9}
+};
+
+// 黑色游程组合码 64-1728（步长64）
+const G4Code BlackMakeup[] = {
+    {0x00f, 10}, {0x0c8, 12}, {0x0c9, 12}, {0x05b, 12}, {0x033, 12}, {0x034, 12}, {0x035, 12}, {0x06c, 13},
+    {0x06d, 13}, {0x04a, 13}, {0x04b, 13}, {0x04c, 13}, {0x04d, 13}, {0x072, 13}, {0x073, 13}, {0x074, 13},
+    {0x075, 13}, {0x076, 13}, {0x077, 13}, {0x052, 13}, {0x053, 13}, {0x054, 13}, {0x055, 13}, {0x05a, 13},
+    {0x05b, 13}, {0x064, 13}, {0x065, 13}
+};
+
+// 黑白共用的扩展组合码 1792-2560
+const G4Code ExtendedMakeup[] = {
+    {0x008, 11}, {0x00c, 11}, {0x00d, 11}, {0x012, 12}, {0x013, 12}, {0x014, 12}, {0x015, 12}, {0x016, 12},
+    {0x017, 12}, {0x01c, 12}, {0x01d, 12}, {0x01e, 12}, {0x01f, 12}
+};
+
+
+// 垂直模式码，下标为 a1 - b1 + 3（VL3 ... V0 ... VR3）
+const G4Code VerticalCodes[] = {
+    {0x02, 7}, {0x02, 6}, {0x02, 3}, {0x01, 1}, {0x03, 3}, {0x03, 6}, {0x03, 7}
+};
+const G4Code PassCode = {0x1, 4};
+const G4Code HorizontalCode = {0x1, 3};
+const G4Code EolCode = {0x001, 12};
+
+void appendLe16(QByteArray *data, quint16 value)
+{
+    data->append(char(value & 0xff));
+    data->append(char(value >> 8));
+}
+
+void appendLe32(QByteArray *data, quint32 value)
+{
+    appendLe16(data, quint16(value & 0xffff));
+    appendLe16(data, quint16(value >> 16));
+}
+
+// IFD 条目：SHORT(3) 和 LONG(4) 的单个值直接放在值字段，RATIONAL(5) 放偏移
+void appendTiffEntry(QByteArray *data, quint16 tag, quint16 type, quint32 value)
+{
+    appendLe16(data, tag);
+    appendLe16(data, type);
+    appendLe32(data, 1);
+    appendLe32(data, value);
+}
+}
+
+// ===== BitonalOps =====
+
+void BitonalOps::addHistogram(const uchar *gray, int pixels, int step, quint32 *histogram)
+{
+    for (int i = 0; i < pixels; i += step) {
+        ++histogram[gray[i]];
+    }
+}
+
+int BitonalOps::otsuThreshold(const quint32 *histogram)
+{
+    double total = 0;
+    double sum = 0;
+    for (int i = 0; i < 256; ++i) {
+        total += histogram[i];
+        sum += double(i) * histogram[i];
+    }
+    if (total <= 0) {
+        return 127;
+    }
+    
+    double weightBack = 0;
+    double sumBack = 0;
+    double bestVariance = -1;
+    int best = 127;
+    for (int t = 0; t < 255; ++t) {
+        weightBack += histogram[t];
+        sumBack += double(t) * histogram[t];
+        double weightFore = total - weightBack;
+        if (weightBack == 0 || weightFore == 0) {
+            continue;
+        }
+        double meanBack = sumBack / weightBack;
+        double meanFore = (sum - sumBack) / weightFore;
+        double variance = weightBack * weightFore * (meanBack - meanFore) * (meanBack - meanFore);
+        if (variance > bestVariance) {
+            bestVariance = variance;
+            best = t;
+        }
+    }
+    return best;
+}
+
+void BitonalOps::threshold(const uchar *gray, uchar *bits, int width, int threshold)
+{
+    // 无分支写法，编译器可自动向量化
+    for (int x = 0; x < width; ++x) {
+        bits[x] = uchar(gray[x] <= threshold);
+    }
+}
+
+// ===== SauvolaBinarizer =====
+
+SauvolaBinarizer::SauvolaBinarizer(int width, int radius, double k)
+    : m_width(width),
+      m_radius(qMax(1, radius)),
+      m_k(k),
+      m_ringRows(2 * qMax(1, radius) + 2),
+      m_rows(m_ringRows * width),
+      m_columnSum(width, 0),
+      m_columnSq(width, 0),
+      m_pushed(0),
+      m_output(0),
+      m_windowTop(0),
+      m_finished(false)
+{
+}
+
+void SauvolaBinarizer::pushRow(const uchar *gray)
+{
+    // 调用方每输入一行都取完可输出的行，环形缓冲区不会覆盖窗口内的行
+    uchar *target = m_rows.data() + qint64(m_pushed % m_ringRows) * m_width;
+    memcpy(target, gray, m_width);
+    
+    quint32 *sum = m_columnSum.data();
+    quint32 *sq = m_columnSq.data();
+    for (int x = 0; x < m_width; ++x) {
+        quint32 value = gray[x];
+        sum[x] += value;
+        sq[x] += value * value;
+    }
+    ++m_pushed;
+}
+
+void SauvolaBinarizer::removeRow(int index)
+{
+    const uchar *gray = row(index);
+    quint32 *sum = m_columnSum.data();
+    quint32 *sq = m_columnSq.data();
+    for (int x = 0; x < m_width; ++x) {
+        quint32 value = gray[x];
+        sum[x] -= value;
+        sq[x] -= value * value;
+    }
+}
+
+void SauvolaBinarizer::finish()
+{
+    m_finished = true;
+}
+
+bool SauvolaBinarizer::takeRow(uchar *bits)
+{
+    const int y = m_output;
+    if (y >= m_pushed || (!m_finished && y + m_radius >= m_pushed)) {
+        return false;
+    }
+    
+    // 窗口上边界下移，移出的行从列累加中减去
+    const int top = qMax(0, y - m_radius);
+    while (m_windowTop < top) {
+        removeRow(m_windowTop++);
+    }
+    const int windowRows = m_pushed - m_windowTop;
+    
+    // 沿行方向滑动窗口累加列和，每个像素 O(1)
+    const quint32 *sum = m_columnSum.constData();
+    const quint32 *sq = m_columnSq.constData();
+    const uchar *gray = row(y);
+    quint64 windowSum = 0;
+    quint64 windowSq = 0;
+    for (int x = 0; x < qMin(m_radius, m_width); ++x) {
+        windowSum += sum[x];
+        windowSq += sq[x];
+    }
+    for (int x = 0; x < m_width; ++x) {
+        int add = x + m_radius;
+        int remove = x - m_radius - 1;
+        if (add < m_width) {
+            windowSum += sum[add];
+            windowSq += sq[add];
+        }
+        if (remove >= 0) {
+            windowSum -= sum[remove];
+            windowSq -= sq[remove];
+        }
+        
+        // 8位灰度的标准差不超过128，阈值不会高于均值：高于均值的像素直接判为白色，省去开方
+        int columns = qMin(add, m_width - 1) - qMax(0, x - m_radius) + 1;
+        float inverse = 1.0f / (float(columns) * windowRows);
+        float mean = float(windowSum) * inverse;
+        if (gray[x] > mean) {
+            bits[x] = 0;
+            continue;
+        }
+        float variance = float(windowSq) * inverse - mean * mean;
+        float deviation = variance > 0 ? std::sqrt(variance) : 0;
+        float threshold = mean * (1 + float(m_k) * (deviation * (1.0f / 128) - 1));
+        bits[x] = uchar(gray[x] <= threshold);
+    }
+    
+    ++m_output;
+    return true;
+}
+
+// ===== G4Encoder =====
+
+G4Encoder::G4Encoder(int width)
+    : m_width(width),
+      m_bitBuffer(0),
+      m_bitCount(0)
+{
+    // 第一行的参考行是假想的全白行
+    m_reference << width << width << width;
+}
+
+void G4Encoder::findChanges(const uchar *bits, QVector<int> *changes) const
+{
+    // 变化点：与左侧像素颜色不同的位置（行首左侧视为白色），偶数下标变黑、奇数下标变白
+    changes->clear();
+    uchar color = 0;
+    for (int x = 0; x < m_width; ++x) {
+        uchar pixel = bits[x] ? 1 : 0;
+        if (pixel != color) {
+            changes->append(x);
+            color = pixel;
+        }
+    }
+    *changes << m_width << m_width << m_width;
+}
+
+void G4Encoder::encodeRow(const uchar *bits)
+{
+    findChanges(bits, &m_coding);
+    const int *a = m_coding.constData();
+    const int *b = m_reference.constData();
+    
+    int a0 = -1;
+    bool black = false;
+    int ai = 0;
+    int bi = 0;
+    while (a0 < m_width) {
+        while (a[ai] <= a0) {
+            ++ai;
+        }
+        const int a1 = a[ai];
+        
+        // b1：参考行上 a0 右侧第一个与 a0 颜色相反的变化点
+        if (bi > 0) {
+            --bi;
+        }
+        while (b[bi] <= a0 || (bi & 1) != (black ? 1 : 0)) {
+            ++bi;
+        }
+        const int b1 = b[bi];
+        const int b2 = b[bi + 1];
+        
+        if (b2 < a1) {
+            // 通过模式
+            putBits(PassCode.code, PassCode.length);
+            a0 = b2;
+        } else if (qAbs(a1 - b1) <= 3) {
+            // 垂直模式
+            const G4Code &code = VerticalCodes[a1 - b1 + 3];
+            putBits(code.code, code.length);
+            a0 = a1;
+            black = !black;
+        } else {
+            // 水平模式：两段游程
+            const int a2 = a[ai + 1];
+            putBits(HorizontalCode.code, HorizontalCode.length);
+            putRun(a1 - qMax(a0, 0), black);
+            putRun(a2 - a1, !black);
+            a0 = a2;
+        }
+    }
+    
+    m_reference.swap(m_coding);
+}
+
+void G4Encoder::finish()
+{
+    putBits(EolCode.code, EolCode.length);
+    putBits(EolCode.code, EolCode.length);
+    if (m_bitCount > 0) {
+        putBits(0, 8 - m_bitCount);
+    }
+}
+
+void G4Encoder::putBits(quint32 code, int length)
+{
+    m_bitBuffer = (m_bitBuffer << length) | code;
+    m_bitCount += length;
+    while (m_bitCount >= 8) {
+        m_bitCount -= 8;
+        m_data.append(char((m_bitBuffer >> m_bitCount) & 0xff));
+    }
+}
+
+void G4Encoder::putRun(int run, bool black)
+{
+    const G4Code *terminating = black ? BlackTerminating : WhiteTerminating;
+    const G4Code *makeup = black ? BlackMakeup : WhiteMakeup;
+    
+    while (run >= 2560 + 64) {
+        putBits(ExtendedMakeup[12].code, ExtendedMakeup[12].length);
+        run -= 2560;
+    }
+    if (run >= 64) {
+        int units = run / 64;
+        const G4Code &code = units <= 27 ? makeup[units - 1] : ExtendedMakeup[units - 28];
+        putBits(code.code, code.length);
+        run -= units * 64;
+    }
+    putBits(terminating[run].code, terminating[run].length);
+}
+
+// ===== TiffG4Writer =====
+
+TiffG4Writer::TiffG4Writer()
+    : m_encoder(nullptr),
+      m_width(0),
+      m_height(0),
+      m_dpi(0),
+      m_rowsWritten(0),
+      m_dataBytes(0)
+{
+}
+
+TiffG4Writer::~TiffG4Writer()
+{
+    delete m_encoder;
+}
+
+bool TiffG4Writer::open(const QString &filePath, int width, int height, int dpi)
+{
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    
+    // 文件头：小端序，IFD 偏移在 finish() 时回填
+    QByteArray header("II", 2);
+    appendLe16(&header, 42);
+    appendLe32(&header, 0);
+    if (m_file.write(header) != header.size()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    
+    delete m_encoder;
+    m_encoder = new G4Encoder(width);
+    m_width = width;
+    m_height = height;
+    m_dpi = dpi > 0 ? dpi : 300;
+    m_rowsWritten = 0;
+    m_dataBytes = 0;
+    return true;
+}
+
+bool TiffG4Writer::writeRows(const uchar *bits, int rows, int stride)
+{
+    for (int row = 0; row < rows; ++row) {
+        m_encoder->encodeRow(bits + qint64(row) * stride);
+    }
+    m_rowsWritten += rows;
+    return m_encoder->data().size() < TiffFlushBytes || flush();
+}
+
+bool TiffG4Writer::flush()
+{
+    QByteArray &data = m_encoder->data();
+    if (m_file.write(data) != data.size()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_dataBytes += data.size();
+    data.clear();
+    return true;
+}
+
+bool TiffG4Writer::finish()
+{
+    if (m_rowsWritten != m_height) {
+        m_error = QString("Expected %1 rows, got %2").arg(m_height).arg(m_rowsWritten);
+        return false;
+    }
+    m_encoder->finish();
+    if (!flush()) {
+        return false;
+    }
+    
+    // IFD 须从字边界开始
+    const quint32 dataOffset = 8;
+    quint32 ifdOffset = dataOffset + quint32(m_dataBytes);
+    QByteArray ifd;
+    if (ifdOffset % 2) {
+        ifd.append('\0');
+        ++ifdOffset;
+    }
+    
+    const int entries = 13;
+    const quint32 rationalOffset = ifdOffset + 2 + entries * 12 + 4;
+    appendLe16(&ifd, entries);
+    appendTiffEntry(&ifd, 256, 4, m_width);                 // ImageWidth
+    appendTiffEntry(&ifd, 257, 4, m_height);                // ImageLength
+    appendTiffEntry(&ifd, 258, 3, 1);                       // BitsPerSample
+    appendTiffEntry(&ifd, 259, 3, 4);                       // Compression = CCITT T.6
+    appendTiffEntry(&ifd, 262, 3, 0);                       // Photometric = WhiteIsZero
+    appendTiffEntry(&ifd, 273, 4, dataOffset);              // StripOffsets
+    appendTiffEntry(&ifd, 277, 3, 1);                       // SamplesPerPixel
+    appendTiffEntry(&ifd, 278, 4, m_height);                // RowsPerStrip
+    appendTiffEntry(&ifd, 279, 4, quint32(m_dataBytes));    // StripByteCounts
+    appendTiffEntry(&ifd, 282, 5, rationalOffset);          // XResolution
+    appendTiffEntry(&ifd, 283, 5, rationalOffset + 8);      // YResolution
+    appendTiffEntry(&ifd, 293, 4, 0);                       // T6Options
+    appendTiffEntry(&ifd, 296, 3, 2);                       // ResolutionUnit = inch
+    appendLe32(&ifd, 0);
+    appendLe32(&ifd, m_dpi);
+    appendLe32(&ifd, 1);
+    appendLe32(&ifd, m_dpi);
+    appendLe32(&ifd, 1);
+    
+    QByteArray offset;
+    appendLe32(&offset, ifdOffset);
+    if (m_file.write(ifd) != ifd.size() || !m_file.seek(4) || m_file.write(offset) != offset.size()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_file.close();
+    return true;
+}
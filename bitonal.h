@@ -0,0 +1,105 @@
+#ifndef BITONAL_H
+#define BITONAL_H
+
+#include <QString>
+#include <QFile>
+#include <QByteArray>
+#include <QVector>
+
+// 二值化与 CCITT G4 编码：答题卡以黑白页面保存，比彩色 JPEG 小一个数量级
+// 行数据统一为每像素1字节：灰度 0-255，二值结果非0表示黑色
+
+namespace BitonalOps
+{
+    // 累加灰度直方图（每 step 个像素采样一次）
+    void addHistogram(const uchar *gray, int pixels, int step, quint32 *histogram);
+
+    // Otsu 全局阈值：类间方差最大的灰度，灰度不大于阈值为黑
+    int otsuThreshold(const quint32 *histogram);
+
+    // 按固定阈值二值化一行
+    void threshold(const uchar *gray, uchar *bits, int width, int threshold);
+}
+
+// Sauvola 局部自适应阈值：T = m * (1 + k * (s / R - 1))，m、s 为窗口内均值和标准差
+// 按行输入、按行输出，只保留窗口高度的灰度行，输出比输入滞后 radius 行
+class SauvolaBinarizer
+{
+public:
+    SauvolaBinarizer(int width, int radius, double k = 0.34);
+
+    void pushRow(const uchar *gray);
+    // 输入结束，剩余的行在下边界按实际窗口计算
+    void finish();
+    // 取出下一行结果，没有可输出的行时返回 false
+    bool takeRow(uchar *bits);
+
+private:
+    int m_width;
+    int m_radius;
+    double m_k;
+    int m_ringRows;                 // 环形缓冲区行数：窗口高度 + 1（待移出的行）
+    QVector<uchar> m_rows;
+    QVector<quint32> m_columnSum;   // 窗口内各列灰度和
+    QVector<quint32> m_columnSq;    // 窗口内各列灰度平方和
+    int m_pushed;                   // 已输入行数
+    int m_output;                   // 下一输出行
+    int m_windowTop;                // 列累加中包含的第一行
+    bool m_finished;
+
+    const uchar *row(int index) const { return m_rows.constData() + qint64(index % m_ringRows) * m_width; }
+    void removeRow(int index);
+};
+
+// CCITT T.6 (G4) 二维编码：以上一行为参考行，只编码变化点位置
+class G4Encoder
+{
+public:
+    explicit G4Encoder(int width);
+
+    void encodeRow(const uchar *bits);
+    // 写入 EOFB 并补齐到字节边界
+    void finish();
+
+    // 已编码的字节，调用方写出后可清空
+    QByteArray &data() { return m_data; }
+
+private:
+    int m_width;
+    QVector<int> m_reference;       // 参考行的变化点（末尾以 width 填充）
+    QVector<int> m_coding;
+    QByteArray m_data;
+    quint32 m_bitBuffer;
+    int m_bitCount;
+
+    void findChanges(const uchar *bits, QVector<int> *changes) const;
+    void putBits(quint32 code, int length);
+    void putRun(int run, bool black);
+};
+
+// 单条带 G4 压缩的二值 TIFF：逐行写入，IFD 在图像数据之后，写完再回填偏移
+class TiffG4Writer
+{
+public:
+    TiffG4Writer();
+    ~TiffG4Writer();
+
+    bool open(const QString &filePath, int width, int height, int dpi = 0);
+    bool writeRows(const uchar *bits, int rows, int stride);
+    bool finish();
+    QString errorString() const { return m_error; }
+
+private:
+    QFile m_file;
+    G4Encoder *m_encoder;
+    int m_width;
+    int m_height;
+    int m_dpi;
+    int m_rowsWritten;
+    qint64 m_dataBytes;
+    QString m_error;
+
+    bool flush();
+};
+
+#endif // BITONAL_H
@@ -0,0 +1,370 @@
+#include "deskew.h"
+#include "pagebufferpool.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+const int StripRows = 64;
+const int AnalysisDpi = 75;             // 分析用缩略图分辨率
+const int InkThreshold = 160;           // 灰度低于该值视为有墨迹
+const int BandWidth = 16;               // 投影时按16列一组平移，组内视为同一偏移
+const double MaxSkewDegrees = 5.0;      // 进纸歪斜超过5度的页面不自动纠正
+const double CoarseStep = 0.25;
+const double FineStep = 0.05;
+const double MinSkewDegrees = 0.1;      // 小于该角度不旋转（300dpi A3 宽度上不到6像素）
+const double MinInkRatio = 0.0005;      // 墨迹太少（空白页）时不估计角度
+const float SolidInkRatio = 0.9f;       // 整块全黑（深色底板、大面积涂黑）不参与投影
+const int BackingContrast = 40;         // 纸张与扫描仪底板的亮度差超过该值时按纸张边缘裁剪
+const double PaperLineRatio = 0.25;     // 一行（列）中超过1/4是纸张即视为在纸张范围内（横放A4只占A3扫描高度的一半）
+const double ContentMarginMm = 10.0;    // 按内容裁剪时四周保留的边距
+const double MinCropRatio = 0.25;       // 裁剪后小于原尺寸1/4视为误判，不裁剪
+const qint64 MaxRingBytes = 8 * 1024 * 1024;    // 纠偏读取器环形缓冲上限（300dpi A3 彩色5度约3MB）
+
+double toRadians(double degrees)
+{
+    return degrees * M_PI / 180.0;
+}
+
+// 直方图百分位
+int percentile(const QVector<uchar> &values, double ratio)
+{
+    qint64 histogram[256] = {0};
+    for (uchar value : values) {
+        ++histogram[value];
+    }
+    qint64 target = qint64(values.size() * ratio);
+    qint64 count = 0;
+    for (int i = 0; i < 256; ++i) {
+        count += histogram[i];
+        if (count > target) {
+            return i;
+        }
+    }
+    return 255;
+}
+
+// 倾斜角为 angle 时的投影轮廓能量：文字行对齐时行间的空白与文字行差异最大，平方和也最大
+double profileScore(const QVector<float> &bandRows, int bands, int rows, int thumbWidth, double angle,
+                    int margin, QVector<float> *profile)
+{
+    profile->fill(0);
+    float *bins = profile->data();
+    const double slope = std::tan(toRadians(angle));
+    for (int band = 0; band < bands; ++band) {
+        double center = band * BandWidth + BandWidth / 2.0 - thumbWidth / 2.0;
+        double shift = -slope * center;
+        int base = int(std::floor(shift));
+        float fraction = float(shift - base);
+        const float *values = bandRows.constData() + qint64(band) * rows;
+        float *target = bins + margin + base;
+        for (int row = 0; row < rows; ++row) {
+            target[row] += values[row] * (1 - fraction);
+            target[row + 1] += values[row] * fraction;
+        }
+    }
+    double score = 0;
+    for (int i = 0; i < profile->size(); ++i) {
+        score += double(bins[i]) * bins[i];
+    }
+    return score;
+}
+
+double estimateSkew(const QVector<float> &ink, int thumbWidth, int thumbHeight)
+{
+    const int bands = (thumbWidth + BandWidth - 1) / BandWidth;
+    QVector<float> bandRows(bands * thumbHeight, 0);
+    double total = 0;
+    for (int y = 0; y < thumbHeight; ++y) {
+        const float *row = ink.constData() + qint64(y) * thumbWidth;
+        for (int x = 0; x < thumbWidth; ++x) {
+            float value = row[x] < SolidInkRatio ? row[x] : 0;
+            bandRows[(x / BandWidth) * thumbHeight + y] += value;
+            total += value;
+        }
+    }
+    if (total < MinInkRatio * thumbWidth * thumbHeight) {
+        return 0;
+    }
+
+    const int margin = int(std::ceil(std::tan(toRadians(MaxSkewDegrees)) * thumbWidth / 2)) + 2;
+    QVector<float> profile(thumbHeight + 2 * margin + 2, 0);
+
+    // 先粗后细搜索
+    double best = 0;
+    double bestScore = profileScore(bandRows, bands, thumbHeight, thumbWidth, 0, margin, &profile);
+    for (double angle = -MaxSkewDegrees; angle <= MaxSkewDegrees + 1e-9; angle += CoarseStep) {
+        double score = profileScore(bandRows, bands, thumbHeight, thumbWidth, angle, margin, &profile);
+        if (score > bestScore) {
+            bestScore = score;
+            best = angle;
+        }
+    }
+    const double coarse = best;
+    for (double angle = coarse - CoarseStep; angle <= coarse + CoarseStep + 1e-9; angle += FineStep) {
+        if (qAbs(angle) > MaxSkewDegrees) {
+            continue;
+        }
+        double score = profileScore(bandRows, bands, thumbHeight, thumbWidth, angle, margin, &profile);
+        if (score > bestScore) {
+            bestScore = score;
+            best = angle;
+        }
+    }
+    return qAbs(best) < MinSkewDegrees ? 0 : best;
+}
+
+// 行（列）中满足条件的像素数达到 threshold 的第一个和最后一个位置
+bool findRange(const QVector<int> &counts, int threshold, int *first, int *last)
+{
+    *first = -1;
+    for (int i = 0; i < counts.size(); ++i) {
+        if (counts[i] >= threshold) {
+            if (*first < 0) *first = i;
+            *last = i;
+        }
+    }
+    return *first >= 0;
+}
+}
+
+// ===== Deskew =====
+
+DeskewParams Deskew::analyze(StripReader *reader, int dpi, bool deskew, bool autoCrop, PageBufferPool *pool)
+{
+    DeskewParams params;
+    const int width = reader->width();
+    const int height = reader->height();
+    const int channels = reader->channels();
+    const int factor = qMax(1, (dpi > 0 ? dpi : 300) / AnalysisDpi);
+    const int thumbWidth = (width + factor - 1) / factor;
+    const int thumbHeight = (height + factor - 1) / factor;
+    params.crop = QRect(0, 0, width, height);
+
+    PageBuffer strip(pool, qint64(StripRows) * reader->rowBytes());
+    if (strip.isNull() || width <= 0 || height <= 0) {
+        return params;
+    }
+
+    // 缩略图：每个 factor×factor 块的平均灰度和墨迹比例
+    QVector<uchar> gray(thumbWidth * thumbHeight, 255);
+    QVector<float> ink(thumbWidth * thumbHeight, 0);
+    QVector<quint32> graySum(thumbWidth, 0);
+    QVector<quint32> inkCount(thumbWidth, 0);
+    int y = 0;
+    while (y < height) {
+        int rows = reader->readRows(strip.data(), StripRows);
+        if (rows <= 0) {
+            return params;
+        }
+        if (channels == 3) {
+            StripOps::rgbToGray(strip.data(), strip.data(), rows * width);
+        }
+        for (int row = 0; row < rows; ++row) {
+            const uchar *line = strip.data() + qint64(row) * width;
+            for (int x = 0; x < width; ++x) {
+                graySum[x / factor] += line[x];
+                inkCount[x / factor] += line[x] < InkThreshold;
+            }
+
+            int imageRow = y + row;
+            if ((imageRow + 1) % factor != 0 && imageRow != height - 1) {
+                continue;
+            }
+            int thumbRow = imageRow / factor;
+            int blockRows = imageRow - thumbRow * factor + 1;
+            for (int tx = 0; tx < thumbWidth; ++tx) {
+                int blockColumns = qMin(factor, width - tx * factor);
+                float pixels = float(blockRows * blockColumns);
+                gray[thumbRow * thumbWidth + tx] = uchar(graySum[tx] / pixels);
+                ink[thumbRow * thumbWidth + tx] = inkCount[tx] / pixels;
+            }
+            graySum.fill(0);
+            inkCount.fill(0);
+        }
+        y += rows;
+    }
+
+    if (deskew) {
+        params.angle = estimateSkew(ink, thumbWidth, thumbHeight);
+        // 纠偏读取器缓存 2·reach+1 行，reach ≈ sin(θ)·宽度/2：600dpi A3 彩色5度时约13MB，
+        // 超出上限的角度不纠正（仍裁边），600dpi 彩色约可纠正3度以内
+        const double reach = std::abs(std::sin(toRadians(params.angle))) * width / 2 + 1;
+        if ((2 * reach + 1) * reader->rowBytes() > MaxRingBytes) {
+            params.angle = 0;
+        }
+    }
+
+    // 纸张底色取亮部百分位，底板亮度取缩略图最外一圈的中位数
+    QVector<uchar> border;
+    for (int tx = 0; tx < thumbWidth; ++tx) {
+        border << gray[tx] << gray[(thumbHeight - 1) * thumbWidth + tx];
+    }
+    for (int ty = 0; ty < thumbHeight; ++ty) {
+        border << gray[ty * thumbWidth] << gray[ty * thumbWidth + thumbWidth - 1];
+    }
+    const int backingLevel = percentile(border, 0.5);
+    const int paperLevel = percentile(gray, 0.9);
+    params.background = uchar(paperLevel);
+
+    if (autoCrop) {
+        // 缩略图按估计角度旋转到纠偏后的坐标（最近邻），在其上找纸张边缘
+        const double radians = toRadians(params.angle);
+        const double cosine = std::cos(radians);
+        const double sine = std::sin(radians);
+        const double cx = thumbWidth / 2.0;
+        const double cy = thumbHeight / 2.0;
+        const bool paperEdges = paperLevel - backingLevel >= BackingContrast;
+        const int paperThreshold = (paperLevel + backingLevel) / 2;
+        QVector<int> rowCounts(thumbHeight, 0);
+        QVector<int> columnCounts(thumbWidth, 0);
+        for (int ty = 0; ty < thumbHeight; ++ty) {
+            for (int tx = 0; tx < thumbWidth; ++tx) {
+                int sx = int(std::floor(cx + (tx + 0.5 - cx) * cosine - (ty + 0.5 - cy) * sine));
+                int sy = int(std::floor(cy + (tx + 0.5 - cx) * sine + (ty + 0.5 - cy) * cosine));
+                if (sx < 0 || sy < 0 || sx >= thumbWidth || sy >= thumbHeight) {
+                    continue;
+                }
+                int index = sy * thumbWidth + sx;
+                bool hit = paperEdges ? gray[index] > paperThreshold : ink[index] > 0.1f;
+                if (hit) {
+                    ++rowCounts[ty];
+                    ++columnCounts[tx];
+                }
+            }
+        }
+
+        // 底板与纸张可区分时按纸张边缘裁剪；白色底板时按内容范围加边距裁剪
+        int left = 0, right = 0, top = 0, bottom = 0;
+        bool found = paperEdges
+            ? findRange(columnCounts, int(thumbHeight * PaperLineRatio), &left, &right)
+              && findRange(rowCounts, int(thumbWidth * PaperLineRatio), &top, &bottom)
+            : findRange(columnCounts, 2, &left, &right) && findRange(rowCounts, 2, &top, &bottom);
+        if (found) {
+            QRect crop(left * factor, top * factor, (right - left + 1) * factor, (bottom - top + 1) * factor);
+            if (paperEdges) {
+                // 向内收一个缩略图像素，去掉纸边阴影
+                crop.adjust(factor, factor, -factor, -factor);
+            } else {
+                int margin = int(ContentMarginMm / 25.4 * (dpi > 0 ? dpi : 300));
+                crop.adjust(-margin, -margin, margin, margin);
+            }
+            crop &= QRect(0, 0, width, height);
+            if (crop.width() >= width * MinCropRatio && crop.height() >= height * MinCropRatio) {
+                params.crop = crop;
+            }
+        }
+    }
+
+    params.valid = params.angle != 0 || params.crop != QRect(0, 0, width, height);
+    return params;
+}
+
+// ===== DeskewStripReader =====
+
+DeskewStripReader::DeskewStripReader(StripReader *source, const DeskewParams &params, PageBufferPool *pool)
+    : m_source(source),
+      m_params(params),
+      m_sourceWidth(source->width()),
+      m_sourceHeight(source->height()),
+      m_stripRows(0),
+      m_stripPos(0),
+      m_sheared(0),
+      m_nextRow(params.crop.top())
+{
+    m_width = params.crop.width();
+    m_height = params.crop.height();
+    m_channels = source->channels();
+
+    // 旋转 θ 分解为三次错切：水平 -tan(θ/2)、垂直 sin(θ)、水平 -tan(θ/2)，每次只整像素平移
+    const double radians = toRadians(params.angle);
+    const double beta = std::sin(radians);
+    m_alpha = -std::tan(radians / 2);
+    m_columnShift.resize(m_sourceWidth);
+    m_reach = 0;
+    for (int x = 0; x < m_sourceWidth; ++x) {
+        m_columnShift[x] = qRound(beta * (x - m_sourceWidth / 2.0));
+        m_reach = qMax(m_reach, qAbs(m_columnShift[x]));
+    }
+    m_ringRows = 2 * m_reach + 1;
+
+    const qint64 rowBytes = qint64(m_sourceWidth) * m_channels;
+    m_ring.reset(new PageBuffer(pool, m_ringRows * rowBytes));
+    m_strip.reset(new PageBuffer(pool, StripRows * rowBytes));
+}
+
+DeskewStripReader::~DeskewStripReader()
+{
+}
+
+bool DeskewStripReader::pullSourceRow()
+{
+    if (m_stripPos >= m_stripRows) {
+        m_stripRows = m_source->readRows(m_strip->data(), StripRows);
+        m_stripPos = 0;
+        if (m_stripRows <= 0) {
+            m_error = m_stripRows < 0 ? m_source->errorString() : QString("Image data ended early");
+            return false;
+        }
+    }
+
+    // 第一次错切：整行水平平移，移出的部分填充纸张底色
+    const int rowBytes = m_sourceWidth * m_channels;
+    const uchar *source = m_strip->data() + qint64(m_stripPos) * rowBytes;
+    uchar *target = m_ring->data() + qint64(m_sheared % m_ringRows) * rowBytes;
+    const int shift = qRound(m_alpha * (m_sheared - m_sourceHeight / 2.0));
+    const int x0 = qMax(0, -shift);
+    const int x1 = qMin(m_sourceWidth, m_sourceWidth - shift);
+    memset(target, m_params.background, rowBytes);
+    if (x1 > x0) {
+        memcpy(target + x0 * m_channels, source + (x0 + shift) * m_channels, (x1 - x0) * m_channels);
+    }
+
+    ++m_stripPos;
+    ++m_sheared;
+    return true;
+}
+
+int DeskewStripReader::readRows(uchar *buffer, int maxRows)
+{
+    if (m_ring->isNull() || m_strip->isNull()) {
+        m_error = "Out of memory for deskew buffer";
+        return -1;
+    }
+
+    const int left = m_params.crop.left();
+    const int rowBytes = m_sourceWidth * m_channels;
+    const uchar background = m_params.background;
+    int rows = 0;
+    while (rows < maxRows && m_nextRow <= m_params.crop.bottom()) {
+        const int y = m_nextRow;
+        const int needed = qMin(m_sourceHeight, y + m_reach + 1);
+        while (m_sheared < needed) {
+            if (!pullSourceRow()) {
+                return -1;
+            }
+        }
+
+        // 第二次错切按列取不同的源行，第三次错切整行平移
+        uchar *out = buffer + qint64(rows) * this->rowBytes();
+        const int shift = qRound(m_alpha * (y - m_sourceHeight / 2.0));
+        const int oldest = qMax(0, m_sheared - m_ringRows);
+        for (int x = 0; x < m_width; ++x) {
+            int sx = left + x + shift;
+            int sy = sx >= 0 && sx < m_sourceWidth ? y + m_columnShift[sx] : -1;
+            uchar *pixel = out + x * m_channels;
+            if (sy < oldest || sy >= m_sheared) {
+                memset(pixel, background, m_channels);
+                continue;
+            }
+            const uchar *source = m_ring->data() + qint64(sy % m_ringRows) * rowBytes + sx * m_channels;
+            pixel[0] = source[0];
+            if (m_channels == 3) {
+                pixel[1] = source[1];
+                pixel[2] = source[2];
+            }
+        }
+        ++m_nextRow;
+        ++rows;
+    }
+    return rows;
+}
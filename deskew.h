@@ -0,0 +1,56 @@
+#ifndef DESKEW_H
+#define DESKEW_H
+
+#include "stripimage.h"
+#include <QRect>
+#include <QScopedPointer>
+#include <QVector>
+
+class PageBufferPool;
+class PageBuffer;
+
+// 纠偏与裁边参数：由缩略图分析得到，裁剪区域为纠偏后的整页坐标
+struct DeskewParams
+{
+    bool valid = false;
+    double angle = 0;           // 倾斜角（度），正值表示内容向右下倾斜
+    QRect crop;                 // 纠偏后保留的区域
+    uchar background = 255;     // 旋转后空出部分的填充灰度（纸张底色）
+};
+
+namespace Deskew
+{
+    // 读取一遍页面，缩小到约75dpi：用投影轮廓估计倾斜角，再按纸张边缘（或内容范围）确定裁剪区域
+    DeskewParams analyze(StripReader *reader, int dpi, bool deskew, bool autoCrop, PageBufferPool *pool);
+}
+
+// 纠偏裁边读取器：包装源读取器（取得所有权），三次错切旋转后按行输出裁剪区域。
+// 只缓存第二次错切跨越的行数（倾斜5度时约为宽度的9%，analyze 限制在8MB以内），整页不进入内存
+class DeskewStripReader : public StripReader
+{
+public:
+    DeskewStripReader(StripReader *source, const DeskewParams &params, PageBufferPool *pool);
+    ~DeskewStripReader();
+
+    int readRows(uchar *buffer, int maxRows) override;
+
+private:
+    QScopedPointer<StripReader> m_source;
+    DeskewParams m_params;
+    int m_sourceWidth;
+    int m_sourceHeight;
+    double m_alpha;                     // 第一、三次水平错切系数 -tan(θ/2)
+    int m_reach;                        // 第二次垂直错切的最大行偏移
+    int m_ringRows;
+    QScopedPointer<PageBuffer> m_ring;  // 完成第一次错切的源行（环形）
+    QScopedPointer<PageBuffer> m_strip; // 源图像条带
+    int m_stripRows;
+    int m_stripPos;
+    QVector<int> m_columnShift;         // 第二次错切：各列的行偏移
+    int m_sheared;                      // 已完成第一次错切的源行数
+    int m_nextRow;                      // 下一输出行（纠偏后坐标）
+
+    bool pullSourceRow();
+};
+
+#endif // DESKEW_H
@@ -0,0 +1,218 @@
+#include "devicediscoveryworker.h"
+#include <QDebug>
+
+namespace {
+const int KillWaitTimeout = 3000;   // 取消时等待被终止的探测进程退出
+}
+
+DeviceDiscoveryWorker::DeviceDiscoveryWorker(QObject *parent)
+    : QObject(parent),
+      m_scanProcess(nullptr),
+      m_printProcess(nullptr),
+      m_timeoutTimer(nullptr)
+{
+}
+
+DeviceDiscoveryWorker::~DeviceDiscoveryWorker()
+{
+    cancel();
+}
+
+bool DeviceDiscoveryWorker::isBrotherMFCJ3940DW(const QString &text)
+{
+    // 扫描设备名为 "Brother MFC-J3940DW"，CUPS队列名为 "Brother_MFC_J3940DW"，忽略分隔符比较
+    QString normalized;
+    for (const QChar &ch : text) {
+        if (ch.isLetterOrNumber()) {
+            normalized.append(ch.toLower());
+        }
+    }
+    return normalized.contains("brothermfcj3940dw");
+}
+
+void DeviceDiscoveryWorker::discover()
+{
+    if (m_scanProcess || m_printProcess) {
+        qDebug() << "设备发现正在进行中";
+        return;
+    }
+    
+    m_foundDevices.clear();
+    
+    // 进程在工作线程中创建，输出按行增量解析
+    m_printProcess = new QProcess(this);
+    connect(m_printProcess, &QProcess::readyReadStandardOutput,
+            this, &DeviceDiscoveryWorker::onPrintOutput);
+    connect(m_printProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &DeviceDiscoveryWorker::onProcessFinished);
+    connect(m_printProcess, &QProcess::errorOccurred,
+            this, &DeviceDiscoveryWorker::onProcessFinished);
+    
+    m_scanProcess = new QProcess(this);
+    connect(m_scanProcess, &QProcess::readyReadStandardOutput,
+            this, &DeviceDiscoveryWorker::onScanOutput);
+    connect(m_scanProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &DeviceDiscoveryWorker::onProcessFinished);
+    connect(m_scanProcess, &QProcess::errorOccurred,
+            this, &DeviceDiscoveryWorker::onProcessFinished);
+    
+    // airscan探测较慢，设置总超时避免一直等待
+    if (!m_timeoutTimer) {
+        m_timeoutTimer = new QTimer(this);
+        m_timeoutTimer->setSingleShot(true);
+        connect(m_timeoutTimer, &QTimer::timeout, this, &DeviceDiscoveryWorker::onDiscoveryTimeout);
+    }
+    m_timeoutTimer->start(30000);
+    
+    // lpstat 很快返回，扫描设备探测同时进行
+    m_printProcess->start("lpstat", QStringList() << "-p");
+    m_scanProcess->start("scanimage", QStringList() << "-L");
+}
+
+void DeviceDiscoveryWorker::cancel()
+{
+    if (m_timeoutTimer) {
+        m_timeoutTimer->stop();
+    }
+    
+    QList<QProcess*> processes;
+    processes << m_scanProcess << m_printProcess;
+    m_scanProcess = nullptr;
+    m_printProcess = nullptr;
+    
+    // 在工作线程中等待进程真正退出后再释放，不释放仍在运行的 QProcess；
+    // 线程结束时 deleteLater 可能来不及执行，进程会随工作对象一起被析构
+    for (QProcess *process : processes) {
+        if (process) {
+            process->disconnect(this);
+            if (process->state() != QProcess::NotRunning) {
+                process->kill();
+                if (!process->waitForFinished(KillWaitTimeout)) {
+                    qDebug() << "探测进程未能及时退出:" << process->program();
+                }
+            }
+            process->deleteLater();
+        }
+    }
+}
+
+void DeviceDiscoveryWorker::onScanOutput()
+{
+    if (!m_scanProcess) return;
+    
+    while (m_scanProcess->canReadLine()) {
+        parseScanLine(QString::fromLocal8Bit(m_scanProcess->readLine()).trimmed());
+    }
+}
+
+void DeviceDiscoveryWorker::onPrintOutput()
+{
+    if (!m_printProcess) return;
+    
+    while (m_printProcess->canReadLine()) {
+        parsePrintLine(QString::fromLocal8Bit(m_printProcess->readLine()).trimmed());
+    }
+}
+
+void DeviceDiscoveryWorker::parseScanLine(const QString &line)
+{
+    // 格式：device `airscan:e1:Brother MFC-J3940DW' is a eSCL Brother MFC-J3940DW ...
+    if (!line.contains("device")) {
+        return;
+    }
+    
+    int start = line.indexOf("`") + 1;
+    int end = line.indexOf("'", start);
+    if (start <= 0 || end <= start) {
+        return;
+    }
+    
+    QString deviceName = line.mid(start, end - start);
+    if (isBrotherMFCJ3940DW(line)) {
+        // 一体机的扫描条目只能扫描，打印走同一台设备的 CUPS 队列；
+        // 否则会被当作打印队列交给 lpstat 查询，扫描连通性检测也会跳过它
+        reportDevice(deviceName, "Multifunction", "Brother MFC-J3940DW", QStringList() << "Scan");
+    } else {
+        reportDevice(deviceName, "Scanner", "Unknown", QStringList() << "Scan");
+    }
+}
+
+void DeviceDiscoveryWorker::parsePrintLine(const QString &line)
+{
+    // 格式：printer Brother_MFC_J3940DW is idle.  enabled since ...
+    if (!line.startsWith("printer")) {
+        return;
+    }
+    
+    QStringList parts = line.split(' ');
+    if (parts.size() < 2) {
+        return;
+    }
+    
+    QString printerName = parts[1];
+    if (isBrotherMFCJ3940DW(printerName)) {
+        reportDevice(printerName, "Multifunction", "Brother MFC-J3940DW",
+                     QStringList() << "Scan" << "Print" << "Copy" << "Fax");
+    } else {
+        reportDevice(printerName, "Printer", "Unknown", QStringList() << "Print");
+    }
+}
+
+void DeviceDiscoveryWorker::reportDevice(const QString &deviceName, const QString &deviceType,
+                                         const QString &deviceModel, const QStringList &capabilities)
+{
+    if (m_foundDevices.contains(deviceName)) {
+        return;
+    }
+    
+    m_foundDevices.append(deviceName);
+    qDebug() << "发现设备:" << deviceName << "类型:" << deviceType;
+    emit deviceFound(deviceName, deviceType, deviceModel, capabilities);
+}
+
+void DeviceDiscoveryWorker::onProcessFinished()
+{
+    QProcess *process = qobject_cast<QProcess*>(sender());
+    if (!process) return;
+    
+    // 处理最后一行（可能没有换行符）
+    QString rest = QString::fromLocal8Bit(process->readAllStandardOutput()).trimmed();
+    for (const QString &line : rest.split('\n', QString::SkipEmptyParts)) {
+        if (process == m_scanProcess) {
+            parseScanLine(line.trimmed());
+        } else if (process == m_printProcess) {
+            parsePrintLine(line.trimmed());
+        }
+    }
+    
+    if (process == m_scanProcess) {
+        m_scanProcess = nullptr;
+    } else if (process == m_printProcess) {
+        m_printProcess = nullptr;
+    } else {
+        return;
+    }
+    
+    process->disconnect(this);
+    process->deleteLater();
+    finishIfDone();
+}
+
+void DeviceDiscoveryWorker::onDiscoveryTimeout()
+{
+    qDebug() << "设备发现超时，停止未完成的探测";
+    cancel();
+    emit discoveryFinished(m_foundDevices, false);
+}
+
+void DeviceDiscoveryWorker::finishIfDone()
+{
+    if (m_scanProcess || m_printProcess) {
+        return;
+    }
+    
+    if (m_timeoutTimer) {
+        m_timeoutTimer->stop();
+    }
+    emit discoveryFinished(m_foundDevices, true);
+}
@@ -0,0 +1,49 @@
+#ifndef DEVICEDISCOVERYWORKER_H
+#define DEVICEDISCOVERYWORKER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include <QTimer>
+
+// 设备发现工作对象：运行在后台线程中，逐个上报发现的设备
+class DeviceDiscoveryWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DeviceDiscoveryWorker(QObject *parent = nullptr);
+    ~DeviceDiscoveryWorker();
+
+    static bool isBrotherMFCJ3940DW(const QString &text);
+
+public slots:
+    void discover();
+    void cancel();
+
+signals:
+    void deviceFound(const QString &deviceName, const QString &deviceType,
+                     const QString &deviceModel, const QStringList &capabilities);
+    void discoveryFinished(const QStringList &devices, bool complete);
+
+private slots:
+    void onScanOutput();
+    void onPrintOutput();
+    void onProcessFinished();
+    void onDiscoveryTimeout();
+
+private:
+    QProcess *m_scanProcess;
+    QProcess *m_printProcess;
+    QTimer *m_timeoutTimer;
+    QStringList m_foundDevices;
+    
+    // 辅助方法
+    void parseScanLine(const QString &line);
+    void parsePrintLine(const QString &line);
+    void reportDevice(const QString &deviceName, const QString &deviceType,
+                      const QString &deviceModel, const QStringList &capabilities);
+    void finishIfDone();
+};
+
+#endif // DEVICEDISCOVERYWORKER_H
@@ -1,114 +1,286 @@
 #include "devicemanager.h"
-#include <QProcess>
+#include "devicediscoveryworker.h"
+#include "processwatchdog.h"
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QTcpSocket>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QXmlStreamReader>
+#include <QUrl>
 #include <QRegularExpression>
+#include <algorithm>
+
+namespace {
+const quint32 RegistryMagic = 0x41524456;   // "ARDV"
+const quint16 RegistryVersion = 1;
+const int RegistryMaxAgeSecs = 300;         // 注册表超过5分钟未验证时重新发现
+const int FastPollInterval = 2000;          // 有任务或故障时的状态轮询间隔
+const int SlowPollInterval = 15000;         // 空闲时的状态轮询间隔
+const int ReachabilityTimeout = 2000;       // 扫描设备连通性检测超时
+const int LeaseAgingSecs = 60;              // 每等待60秒优先级加1
+const int StatusQueryTimeout = 15000;       // lpstat 查询期限
+const int FeederPollInterval = 1000;        // 进纸器状态轮询间隔
+const int FeederQueryTimeout = 3000;        // ScannerStatus 查询期限
+const int MissedRoundsBeforeRemoval = 3;    // 连续这么多轮完整发现都没有找到才移除设备
+}
 
 DeviceManager::DeviceManager(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_simulationMode(false),
+      m_discoveryThread(new QThread(this)),
+      m_discoveryWorker(new DeviceDiscoveryWorker),
+      m_discovering(false),
+      m_monitorTimer(new QTimer(this)),
+      m_statusProcess(nullptr),
+      m_monitoring(false),
+      m_watchdog(new ProcessWatchdog(this)),
+      m_nextLeaseId(1),
+      m_dispatchPending(false),
+      m_network(new QNetworkAccessManager(this)),
+      m_feederTimer(new QTimer(this))
 {
+    // 进纸器一次只能走一批纸；打印任务由CUPS排队，可同时持有
+    m_maxConcurrentLeases["scan"] = 1;
+    m_maxConcurrentLeases["print"] = 0;
+    
+    m_monitorTimer->setSingleShot(true);
+    connect(m_monitorTimer, &QTimer::timeout, this, &DeviceManager::refreshDeviceStatus);
+    
+    m_feederTimer->setInterval(FeederPollInterval);
+    connect(m_feederTimer, &QTimer::timeout, this, &DeviceManager::pollScannerFeeders);
+    
+    // 设备探测（scanimage -L 可能需要数十秒）放到后台线程，不阻塞界面
+    m_discoveryWorker->moveToThread(m_discoveryThread);
+    connect(m_discoveryThread, &QThread::finished,
+            m_discoveryWorker, &QObject::deleteLater);
+    connect(m_discoveryWorker, &DeviceDiscoveryWorker::deviceFound,
+            this, &DeviceManager::onDeviceFound);
+    connect(m_discoveryWorker, &DeviceDiscoveryWorker::discoveryFinished,
+            this, &DeviceManager::onDiscoveryFinished);
+    m_discoveryThread->start();
+    
     initializeDeviceDatabase();
 }
 
 DeviceManager::~DeviceManager()
 {
+    QMetaObject::invokeMethod(m_discoveryWorker, "cancel", Qt::BlockingQueuedConnection);
+    m_discoveryThread->quit();
+    m_discoveryThread->wait();
 }
 
 void DeviceManager::initializeDeviceDatabase()
 {
     qDebug() << "初始化设备数据库...";
     
-    // 检测Brother MFC-J3940DW多功能一体机
-    detectBrotherMFCJ3940DW();
-}
-
-void DeviceManager::detectBrotherMFCJ3940DW()
-{
-    // 检查扫描设备
-    QProcess scanProcess;
-    scanProcess.start("scanimage", QStringList() << "-L");
-    scanProcess.waitForFinished();
-    
-    QString scanOutput = scanProcess.readAllStandardOutput();
-    QStringList scanLines = scanOutput.split('\n', QString::SkipEmptyParts);
-    
-    // 检查打印设备
-    QProcess printProcess;
-    printProcess.start("lpstat", QStringList() << "-p");
-    printProcess.waitForFinished();
-    
-    QString printOutput = printProcess.readAllStandardOutput();
-    QStringList printLines = printOutput.split('\n', QString::SkipEmptyParts);
-    
-    // 查找Brother MFC-J3940DW设备
-    QStringList brotherDevices;
-    
-    // 从扫描设备中查找
-    for (const QString &line : scanLines) {
-        if (line.contains("Brother MFC-J3940DW", Qt::CaseInsensitive)) {
-            int start = line.indexOf("`") + 1;
-            int end = line.indexOf("'", start);
-            if (start > 0 && end > start) {
-                QString deviceName = line.mid(start, end - start);
-                brotherDevices.append(deviceName);
-                m_deviceTypes[deviceName] = "Multifunction";
-                m_deviceModels[deviceName] = "Brother MFC-J3940DW";
-                m_deviceCapabilities[deviceName] = QStringList() << "Scan" << "Print" << "Copy" << "Fax";
-                
-                qDebug() << "发现多功能一体机:" << deviceName;
-                emit deviceDiscovered(deviceName, "Multifunction");
+    // 先加载上次保存的设备，界面可以立即使用
+    if (loadRegistry()) {
+        // 等待信号连接完成后再上报缓存中的设备
+        QTimer::singleShot(0, this, [this]() {
+            for (auto it = m_deviceTypes.constBegin(); it != m_deviceTypes.constEnd(); ++it) {
+                emit deviceDiscovered(it.key(), it.value());
             }
-        }
+        });
     }
     
-    // 从打印设备中查找
-    for (const QString &line : printLines) {
-        if (line.contains("Brother MFC-J3940DW", Qt::CaseInsensitive)) {
-            QStringList parts = line.split(' ');
-            if (parts.size() >= 2) {
-                QString printerName = parts[1];
-                if (!brotherDevices.contains(printerName)) {
-                    brotherDevices.append(printerName);
-                    m_deviceTypes[printerName] = "Multifunction";
-                    m_deviceModels[printerName] = "Brother MFC-J3940DW";
-                    m_deviceCapabilities[printerName] = QStringList() << "Scan" << "Print" << "Copy" << "Fax";
-                    
-                    qDebug() << "发现多功能一体机:" << printerName;
-                    emit deviceDiscovered(printerName, "Multifunction");
-                }
-            }
-        }
+    // 检测Brother MFC-J3940DW多功能一体机（后台重新验证）
+    startDiscovery();
+}
+
+QString DeviceManager::registryPath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/devices.dat";
+}
+
+bool DeviceManager::loadRegistry()
+{
+    QFile file(registryPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+    
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != RegistryMagic || version != RegistryVersion) {
+        qDebug() << "设备注册表格式不匹配，忽略:" << registryPath();
+        return false;
     }
     
-    // 设置默认配置
-    for (const QString &device : brotherDevices) {
-        QMap<QString, QString> config;
-        config["scan_resolution"] = "300";
-        config["scan_mode"] = "Color";
-        config["scan_format"] = "jpeg";
-        config["scan_source"] = "ADF";
-        config["print_media"] = "A4";
-        config["print_sides"] = "two-sided-long-edge";
-        config["print_copies"] = "1";
-        m_deviceConfigs[device] = config;
+    QMap<QString, QString> types;
+    QMap<QString, QString> models;
+    QMap<QString, QStringList> capabilities;
+    QMap<QString, QMap<QString, QString>> configs;
+    QString currentDevice;
+    in >> types >> models >> capabilities >> configs >> currentDevice;
+    
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "设备注册表已损坏，忽略:" << registryPath();
+        return false;
     }
+    
+    m_deviceTypes = types;
+    m_deviceModels = models;
+    m_deviceCapabilities = capabilities;
+    m_deviceConfigs = configs;
+    m_currentDevice = currentDevice;
+    
+    qDebug() << "已加载设备注册表，设备数量:" << m_deviceTypes.size();
+    return !m_deviceTypes.isEmpty();
 }
 
-QStringList DeviceManager::discoverDevices()
+void DeviceManager::saveRegistry()
+{
+    QString path = registryPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    
+    // 先写临时文件再替换，避免中途退出留下损坏的注册表
+    QString tempPath = path + ".tmp";
+    QFile file(tempPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "无法保存设备注册表:" << path;
+        return;
+    }
+    
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << RegistryMagic << RegistryVersion;
+    out << m_deviceTypes << m_deviceModels << m_deviceCapabilities << m_deviceConfigs << m_currentDevice;
+    file.close();
+    
+    QFile::remove(path);
+    QFile::rename(tempPath, path);
+}
+
+QMap<QString, QString> DeviceManager::defaultConfiguration() const
 {
-    QStringList allDevices;
+    QMap<QString, QString> config;
+    config["scan_resolution"] = "300";
+    config["scan_mode"] = "Color";
+    config["scan_format"] = "jpeg";
+    config["scan_source"] = "ADF";
+    config["scan_escl"] = "false";          // true 时 AirScan 设备直接通过 eSCL 扫描
+    config["print_media"] = "A4";
+    config["print_ipp"] = "false";          // true 时通过发现的 IPP 地址直接提交给打印机，不经过 CUPS
+    config["print_sides"] = "two-sided-long-edge";
+    config["print_copies"] = "1";
+    return config;
+}
+
+void DeviceManager::startDiscovery()
+{
+    if (m_discovering) {
+        return;
+    }
+    
+    m_discovering = true;
+    m_seenDevices.clear();
+    m_addedDevices.clear();
+    m_changedDevices.clear();
+    QMetaObject::invokeMethod(m_discoveryWorker, "discover", Qt::QueuedConnection);
+}
+
+void DeviceManager::onDeviceFound(const QString &deviceName, const QString &deviceType,
+                                  const QString &deviceModel, const QStringList &capabilities)
+{
+    m_seenDevices.insert(deviceName);
+    m_missedRounds.remove(deviceName);
+    
+    // 多功能一体机的信息优先，不被单独的扫描/打印条目覆盖
+    if (m_deviceTypes.value(deviceName) == "Multifunction" && deviceType != "Multifunction") {
+        return;
+    }
+    
+    bool isNew = !m_deviceTypes.contains(deviceName);
+    bool changed = !isNew && (m_deviceTypes.value(deviceName) != deviceType
+                              || m_deviceModels.value(deviceName) != deviceModel
+                              || m_deviceCapabilities.value(deviceName) != capabilities);
+    if (isNew) {
+        m_addedDevices.append(deviceName);
+    } else if (changed && !m_changedDevices.contains(deviceName)) {
+        m_changedDevices.append(deviceName);
+    }
+    
+    m_deviceTypes[deviceName] = deviceType;
+    m_deviceModels[deviceName] = deviceModel;
+    m_deviceCapabilities[deviceName] = capabilities;
+    
+    if (deviceType == "Multifunction" && !m_deviceConfigs.contains(deviceName)) {
+        m_deviceConfigs[deviceName] = defaultConfiguration();
+    }
     
-    // 获取扫描设备
-    QStringList scanDevices = getScanDevices();
-    allDevices.append(scanDevices);
+    if (isNew) {
+        qDebug() << "发现设备:" << deviceName << "类型:" << deviceType;
+        emit deviceDiscovered(deviceName, deviceType);
+    } else if (changed) {
+        qDebug() << "设备信息已更新:" << deviceName << "类型:" << deviceType;
+        emit deviceStatusChanged(deviceName, "Updated");
+    }
+}
+
+void DeviceManager::onDiscoveryFinished(const QStringList &devices, bool complete)
+{
+    m_discovering = false;
     
-    // 获取打印设备
-    QStringList printDevices = getPrintDevices();
-    allDevices.append(printDevices);
+    // 只有完整的一轮发现才能确认设备已不存在；超时的结果只做增量添加。
+    // 设备休眠或网络抖动时可能漏掉一轮，连续多轮都没有找到才移除
+    QStringList removed;
+    if (complete) {
+        m_lastDiscovery = QDateTime::currentDateTime();
+        for (const QString &deviceName : m_deviceTypes.keys()) {
+            if (!m_seenDevices.contains(deviceName)
+                    && ++m_missedRounds[deviceName] >= MissedRoundsBeforeRemoval) {
+                removed.append(deviceName);
+            }
+        }
+        
+        // 设备配置保留，设备重新出现时沿用
+        for (const QString &deviceName : removed) {
+            m_missedRounds.remove(deviceName);
+            m_deviceTypes.remove(deviceName);
+            m_deviceModels.remove(deviceName);
+            m_deviceCapabilities.remove(deviceName);
+            if (m_currentDevice == deviceName) {
+                m_currentDevice.clear();
+            }
+            qDebug() << "设备已移除:" << deviceName;
+            emit deviceDisconnected(deviceName);
+        }
+    }
     
-    // 去重
-    allDevices.removeDuplicates();
+    if (!m_addedDevices.isEmpty() || !m_changedDevices.isEmpty() || !removed.isEmpty()) {
+        saveRegistry();
+        emit registryChanged(m_addedDevices, removed, m_changedDevices);
+    }
     
-    return allDevices;
+    qDebug() << "设备发现完成，设备数量:" << devices.size()
+             << "新增:" << m_addedDevices.size() << "移除:" << removed.size()
+             << "变化:" << m_changedDevices.size();
+    emit discoveryFinished(getKnownDevices());
+}
+
+QStringList DeviceManager::discoverDevices()
+{
+    // 注册表较新时直接从内存返回，过期时在后台重新验证
+    if (!m_lastDiscovery.isValid()
+        || m_lastDiscovery.secsTo(QDateTime::currentDateTime()) > RegistryMaxAgeSecs) {
+        startDiscovery();
+    }
+    return getKnownDevices();
+}
+
+QStringList DeviceManager::getKnownDevices() const
+{
+    return m_deviceTypes.keys();
 }
 
 QStringList DeviceManager::getMultifunctionDevices()
@@ -128,27 +300,9 @@ QStringList DeviceManager::getScanDevices()
 {
     QStringList scanDevices;
     
-    QProcess process;
-    process.start("scanimage", QStringList() << "-L");
-    process.waitForFinished();
-    
-    QString output = process.readAllStandardOutput();
-    QStringList lines = output.split('\n', QString::SkipEmptyParts);
-    
-    for (const QString &line : lines) {
-        if (line.contains("device")) {
-            int start = line.indexOf("`") + 1;
-            int end = line.indexOf("'", start);
-            if (start > 0 && end > start) {
-                QString deviceName = line.mid(start, end - start);
-                scanDevices.append(deviceName);
-                
-                // 如果还没有类型信息，设置为扫描设备
-                if (!m_deviceTypes.contains(deviceName)) {
-                    m_deviceTypes[deviceName] = "Scanner";
-                    m_deviceCapabilities[deviceName] = QStringList() << "Scan";
-                }
-            }
+    for (auto it = m_deviceCapabilities.begin(); it != m_deviceCapabilities.end(); ++it) {
+        if (it.value().contains("Scan")) {
+            scanDevices.append(it.key());
         }
     }
     
@@ -159,26 +313,9 @@ QStringList DeviceManager::getPrintDevices()
 {
     QStringList printDevices;
     
-    QProcess process;
-    process.start("lpstat", QStringList() << "-p");
-    process.waitForFinished();
-    
-    QString output = process.readAllStandardOutput();
-    QStringList lines = output.split('\n', QString::SkipEmptyParts);
-    
-    for (const QString &line : lines) {
-        if (line.startsWith("printer")) {
-            QStringList parts = line.split(' ');
-            if (parts.size() >= 2) {
-                QString printerName = parts[1];
-                printDevices.append(printerName);
-                
-                // 如果还没有类型信息，设置为打印设备
-                if (!m_deviceTypes.contains(printerName)) {
-                    m_deviceTypes[printerName] = "Printer";
-                    m_deviceCapabilities[printerName] = QStringList() << "Print";
-                }
-            }
+    for (auto it = m_deviceCapabilities.begin(); it != m_deviceCapabilities.end(); ++it) {
+        if (it.value().contains("Print")) {
+            printDevices.append(it.key());
         }
     }
     
@@ -205,6 +342,7 @@ bool DeviceManager::selectDevice(const QString &deviceName)
 {
     if (m_deviceTypes.contains(deviceName)) {
         m_currentDevice = deviceName;
+        saveRegistry();
         emit deviceSelected(deviceName);
         qDebug() << "选择设备:" << deviceName << "类型:" << getDeviceType(deviceName);
         return true;
@@ -220,9 +358,8 @@ bool DeviceManager::isDeviceAvailable(const QString &deviceName)
 
 bool DeviceManager::isDeviceBusy(const QString &deviceName)
 {
-    // 这里可以实现更复杂的设备状态检查
-    // 目前简单返回false
-    return false;
+    // 本程序正在使用，或监控到设备正在打印
+    return m_activeDevices.contains(deviceName) || m_deviceStates.value(deviceName) == "Busy";
 }
 
 QString DeviceManager::getDeviceStatus(const QString &deviceName)
@@ -235,7 +372,436 @@ QString DeviceManager::getDeviceStatus(const QString &deviceName)
         return "Busy";
     }
     
-    return "Ready";
+    return m_deviceStates.value(deviceName, "Ready");
+}
+
+QStringList DeviceManager::getDeviceStateReasons(const QString &deviceName) const
+{
+    return m_deviceReasons.value(deviceName);
+}
+
+void DeviceManager::startDeviceMonitoring()
+{
+    if (m_monitoring) {
+        return;
+    }
+    
+    m_monitoring = true;
+    qDebug() << "启动设备状态监控";
+    
+    // 读取打印机URI，得到一体机的网络地址用于检测扫描部分的连通性
+    QProcess *uriProcess = new QProcess(this);
+    connect(uriProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &DeviceManager::onPrinterUriFinished);
+    connect(uriProcess, &QProcess::errorOccurred, uriProcess, &QObject::deleteLater);
+    m_watchdog->watch(uriProcess, "lpstat -v", StatusQueryTimeout, StatusQueryTimeout);
+    uriProcess->start("lpstat", QStringList() << "-v");
+    
+    refreshDeviceStatus();
+}
+
+void DeviceManager::stopDeviceMonitoring()
+{
+    m_monitoring = false;
+    m_monitorTimer->stop();
+    qDebug() << "停止设备状态监控";
+}
+
+void DeviceManager::setDeviceActive(const QString &deviceName, bool active)
+{
+    if (active) {
+        m_activeDevices.insert(deviceName);
+        if (m_deviceStates.value(deviceName) != "Busy") {
+            updateDeviceState(deviceName, "Busy", m_deviceReasons.value(deviceName));
+        }
+        
+        // 有任务时切换到快速轮询
+        if (m_monitoring && m_monitorTimer->remainingTime() > FastPollInterval) {
+            m_monitorTimer->start(FastPollInterval);
+        }
+    } else {
+        m_activeDevices.remove(deviceName);
+    }
+}
+
+void DeviceManager::refreshDeviceStatus()
+{
+    checkScannerReachability();
+    
+    // 上一次查询尚未返回时不重复启动
+    if (m_statusProcess) {
+        return;
+    }
+    
+    QStringList printers = getPrintDevices();
+    if (printers.isEmpty()) {
+        scheduleNextPoll();
+        return;
+    }
+    
+    // lpstat -l -p 给出 printer-state 以及 Alerts（printer-state-reasons）
+    m_statusProcess = new QProcess(this);
+    m_statusProcess->setProperty("printers", printers);
+    connect(m_statusProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &DeviceManager::onPrinterStatusFinished);
+    connect(m_statusProcess, &QProcess::errorOccurred,
+            this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart && m_statusProcess) {
+            m_statusProcess->deleteLater();
+            m_statusProcess = nullptr;
+            scheduleNextPoll();
+        }
+    });
+    // CUPS无响应时由看门狗终止查询，避免监控永远停在这一轮
+    m_watchdog->watch(m_statusProcess, "lpstat -p", StatusQueryTimeout, StatusQueryTimeout);
+    m_statusProcess->start("lpstat", QStringList() << "-l" << "-p" << printers.join(","));
+}
+
+void DeviceManager::onPrinterStatusFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitCode);
+    
+    QProcess *process = m_statusProcess;
+    m_statusProcess = nullptr;
+    if (!process) return;
+    
+    // 查询被看门狗终止时输出不完整，保留上一轮的状态
+    if (exitStatus != QProcess::NormalExit) {
+        process->deleteLater();
+        scheduleNextPoll();
+        return;
+    }
+    
+    QStringList printers = process->property("printers").toStringList();
+    QString output = process->readAllStandardOutput();
+    process->deleteLater();
+    
+    // 输出格式：
+    // printer Brother_MFC_J3940DW now printing Brother_MFC_J3940DW-12.  enabled since ...
+    //         Alerts: media-empty-error
+    QMap<QString, QString> states;
+    QMap<QString, QStringList> reasons;
+    QString current;
+    for (const QString &line : output.split('\n', QString::SkipEmptyParts)) {
+        QString trimmed = line.trimmed();
+        if (line.startsWith("printer ")) {
+            current = line.section(' ', 1, 1);
+            if (line.contains(" now printing ")) {
+                states[current] = "Busy";
+            } else if (line.contains(" disabled")) {
+                states[current] = "Stopped";
+            } else {
+                states[current] = "Ready";
+            }
+            reasons[current] = QStringList();
+        } else if (!current.isEmpty() && trimmed.startsWith("Alerts:")) {
+            QStringList alerts = trimmed.mid(7).split(' ', QString::SkipEmptyParts);
+            alerts.removeAll("none");
+            reasons[current] = alerts;
+            
+            for (const QString &alert : alerts) {
+                if (alert.startsWith("offline")) {
+                    states[current] = "Offline";
+                }
+            }
+        }
+    }
+    
+    for (const QString &printer : printers) {
+        // lpstat 没有返回的打印机视为离线
+        QString state = states.value(printer, "Offline");
+        if (state == "Ready" && m_activeDevices.contains(printer)) {
+            state = "Busy";
+        }
+        updateDeviceState(printer, state, reasons.value(printer));
+    }
+    
+    scheduleNextPoll();
+}
+
+void DeviceManager::onPrinterUriFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitStatus);
+    
+    QProcess *process = qobject_cast<QProcess*>(sender());
+    if (!process) return;
+    process->deleteLater();
+    if (exitCode != 0) return;
+    
+    // 格式：device for Brother_MFC_J3940DW: ipp://192.168.1.20/ipp/print
+    QStringList changed;
+    QString output = process->readAllStandardOutput();
+    for (const QString &line : output.split('\n', QString::SkipEmptyParts)) {
+        if (!line.startsWith("device for ")) continue;
+        
+        int colon = line.indexOf(':');
+        QString printerName = line.mid(11, colon - 11).trimmed();
+        QUrl uri(line.mid(colon + 1).trimmed());
+        QString host = uri.host();
+        
+        // dnssd:// 等服务名无法直接连接，跳过
+        if (host.isEmpty() || host.contains("._") || !m_deviceTypes.contains(printerName)) {
+            continue;
+        }
+        
+        // IPP 地址同时记下，设备配置 print_ipp 启用时可绕过 CUPS 直接提交
+        QString ippUri = (uri.scheme() == "ipp" || uri.scheme() == "ipps") ? uri.toString() : QString();
+        QMap<QString, QString> &config = m_deviceConfigs[printerName];
+        if (config.value("host") != host || config.value("printer_uri") != ippUri) {
+            config["host"] = host;
+            config["printer_uri"] = ippUri;
+            changed.append(printerName);
+        }
+    }
+    
+    if (!changed.isEmpty()) {
+        saveRegistry();
+        for (const QString &printerName : changed) {
+            emit deviceConfigurationChanged(printerName);
+        }
+    }
+}
+
+void DeviceManager::checkScannerReachability()
+{
+    for (const QString &deviceName : getScanDevices()) {
+        // CUPS 打印队列的状态由 lpstat 判断
+        if (getPrintDevices().contains(deviceName)) {
+            continue;
+        }
+        
+        QString host = deviceHost(deviceName);
+        if (host.isEmpty() || m_pendingReachability.contains(deviceName)) {
+            continue;
+        }
+        
+        // eSCL 通过HTTP端口提供服务，能建立TCP连接即认为可达
+        QTcpSocket *socket = new QTcpSocket(this);
+        m_pendingReachability.insert(deviceName);
+        
+        auto finish = [this, socket, deviceName](bool reachable) {
+            if (!m_pendingReachability.remove(deviceName)) {
+                return;
+            }
+            socket->disconnect(this);
+            socket->abort();
+            socket->deleteLater();
+            
+            QString state = "Offline";
+            if (reachable) {
+                state = m_activeDevices.contains(deviceName) ? "Busy" : "Ready";
+            }
+            updateDeviceState(deviceName, state, QStringList());
+        };
+        
+        connect(socket, &QTcpSocket::connected, this, [finish]() { finish(true); });
+        connect(socket, &QAbstractSocket::errorOccurred, this,
+                [finish](QAbstractSocket::SocketError) { finish(false); });
+        QTimer::singleShot(ReachabilityTimeout, socket, [finish]() { finish(false); });
+        
+        socket->connectToHost(host, 80);
+    }
+}
+
+void DeviceManager::watchScannerFeeder(const QString &deviceName, const QUrl &esclBaseUrl)
+{
+    if (m_feederWatches.value(deviceName) == esclBaseUrl) {
+        return;
+    }
+    
+    // 当前状态未知，第一次查询只记录状态，之后从无纸变为有纸才发出事件
+    m_feederWatches[deviceName] = esclBaseUrl;
+    m_adfStates.remove(deviceName);
+    qDebug() << "开始监视进纸器:" << deviceName << esclBaseUrl;
+    
+    if (!m_feederTimer->isActive()) {
+        m_feederTimer->start();
+    }
+}
+
+void DeviceManager::unwatchScannerFeeder(const QString &deviceName)
+{
+    if (!m_feederWatches.remove(deviceName)) {
+        return;
+    }
+    m_adfStates.remove(deviceName);
+    if (QNetworkReply *reply = m_feederReplies.take(deviceName)) {
+        reply->abort();
+    }
+    if (m_feederWatches.isEmpty()) {
+        m_feederTimer->stop();
+    }
+    qDebug() << "停止监视进纸器:" << deviceName;
+}
+
+void DeviceManager::pollScannerFeeders()
+{
+    for (auto it = m_feederWatches.constBegin(); it != m_feederWatches.constEnd(); ++it) {
+        // 上一次查询还没返回时跳过，避免设备响应慢时请求堆积
+        if (m_feederReplies.contains(it.key())) {
+            continue;
+        }
+        
+        QUrl url = it.value();
+        url.setPath(url.path() + "/ScannerStatus");
+        QNetworkReply *reply = m_network->get(QNetworkRequest(url));
+        reply->setProperty("deviceName", it.key());
+        m_feederReplies[it.key()] = reply;
+        connect(reply, &QNetworkReply::finished, this, &DeviceManager::onScannerStatusFinished);
+        QTimer::singleShot(FeederQueryTimeout, reply, &QNetworkReply::abort);
+    }
+}
+
+void DeviceManager::onScannerStatusFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+    reply->deleteLater();
+    
+    QString deviceName = reply->property("deviceName").toString();
+    if (m_feederReplies.value(deviceName) == reply) {
+        m_feederReplies.remove(deviceName);
+    }
+    if (reply->error() != QNetworkReply::NoError || !m_feederWatches.contains(deviceName)) {
+        return;
+    }
+    
+    // <pwg:State>Idle</pwg:State> ... <scan:AdfState>ScannerAdfLoaded</scan:AdfState>
+    QString scannerState;
+    QString adfState;
+    QXmlStreamReader xml(reply->readAll());
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) continue;
+        if (xml.name() == QLatin1String("State") && scannerState.isEmpty()) {
+            scannerState = xml.readElementText();
+        } else if (xml.name() == QLatin1String("AdfState")) {
+            adfState = xml.readElementText();
+        }
+    }
+    if (adfState.isEmpty()) {
+        return;   // 没有进纸器的设备
+    }
+    
+    QString previous = m_adfStates.value(deviceName);
+    if (adfState == previous) {
+        return;
+    }
+    
+    // 扫描过程中进纸器状态会来回变化，设备空闲后再上报放纸（暂不记录，下次轮询重新判断）
+    bool idle = scannerState == "Idle" && !m_activeDevices.contains(deviceName);
+    if (adfState == "ScannerAdfLoaded" && !idle) {
+        return;
+    }
+    m_adfStates[deviceName] = adfState;
+    
+    if (adfState == "ScannerAdfJam") {
+        emit deviceError(deviceName, "进纸器卡纸");
+    } else if (adfState == "ScannerAdfLoaded") {
+        // 开始监视时进纸器里已有的纸张不算放纸，可能是上一批剩下的
+        if (previous != "ScannerAdfEmpty") {
+            qDebug() << "进纸器有纸，等待操作员重新放纸:" << deviceName << "之前:" << previous;
+            return;
+        }
+        qDebug() << "进纸器已放纸:" << deviceName;
+        emit scannerAdfLoaded(deviceName);
+    }
+}
+
+QString DeviceManager::deviceHost(const QString &deviceName) const
+{
+    QString host = m_deviceConfigs.value(deviceName).value("host");
+    if (!host.isEmpty()) {
+        return host;
+    }
+    
+    // 一体机的扫描和打印条目名称不同，按型号共用打印队列的地址
+    QString model = m_deviceModels.value(deviceName);
+    if (model.isEmpty() || model == "Unknown") {
+        return QString();
+    }
+    for (auto it = m_deviceConfigs.constBegin(); it != m_deviceConfigs.constEnd(); ++it) {
+        if (m_deviceModels.value(it.key()) == model && !it.value().value("host").isEmpty()) {
+            return it.value().value("host");
+        }
+    }
+    return QString();
+}
+
+void DeviceManager::updateDeviceState(const QString &deviceName, const QString &state, const QStringList &reasons)
+{
+    QString previous = m_deviceStates.value(deviceName);
+    QStringList previousReasons = m_deviceReasons.value(deviceName);
+    m_deviceStates[deviceName] = state;
+    m_deviceReasons[deviceName] = reasons;
+    
+    // 只上报变化
+    if (state != previous) {
+        qDebug() << "设备状态变化:" << deviceName << previous << "->" << state;
+        emit deviceStatusChanged(deviceName, state);
+        
+        if (state == "Offline") {
+            emit deviceDisconnected(deviceName);
+        } else if (previous.isEmpty() || previous == "Offline") {
+            emit deviceConnected(deviceName);
+        }
+        
+        if (state == "Busy") {
+            emit deviceBusy(deviceName);
+        } else if (state == "Ready") {
+            emit deviceReady(deviceName);
+        }
+    }
+    
+    for (const QString &reason : reasons) {
+        if (!previousReasons.contains(reason) && !reason.endsWith("-report")) {
+            emit deviceError(deviceName, describeStateReason(reason));
+        }
+    }
+    for (const QString &reason : previousReasons) {
+        if (!reasons.contains(reason)) {
+            qDebug() << "设备告警已解除:" << deviceName << reason;
+        }
+    }
+}
+
+QString DeviceManager::describeStateReason(const QString &reason) const
+{
+    // printer-state-reasons 关键字带 -error/-warning/-report 后缀
+    QString description = reason;
+    if (reason.startsWith("media-empty") || reason.startsWith("media-needed")) {
+        description = "缺纸";
+    } else if (reason.startsWith("media-jam")) {
+        description = "卡纸";
+    } else if (reason.startsWith("marker-supply-empty")) {
+        description = "墨水用尽";
+    } else if (reason.startsWith("marker-supply-low")) {
+        description = "墨水不足";
+    } else if (reason.startsWith("door-open") || reason.startsWith("cover-open")) {
+        description = "机盖打开";
+    } else if (reason.startsWith("input-tray-missing")) {
+        description = "纸盒未装好";
+    } else if (reason.startsWith("offline")) {
+        description = "设备离线";
+    }
+    
+    return description == reason ? reason : QString("%1 (%2)").arg(description, reason);
+}
+
+void DeviceManager::scheduleNextPoll()
+{
+    if (!m_monitoring) {
+        return;
+    }
+    
+    // 有任务进行或有故障时快速轮询，空闲时慢速轮询
+    bool fast = !m_activeDevices.isEmpty();
+    for (auto it = m_deviceStates.constBegin(); it != m_deviceStates.constEnd() && !fast; ++it) {
+        if (it.value() == "Busy" || !m_deviceReasons.value(it.key()).isEmpty()) {
+            fast = true;
+        }
+    }
+    
+    m_monitorTimer->start(fast ? FastPollInterval : SlowPollInterval);
 }
 
 bool DeviceManager::isMultifunctionDevice(const QString &deviceName)
@@ -270,10 +836,138 @@ bool DeviceManager::canFax(const QString &deviceName)
 void DeviceManager::setDeviceConfiguration(const QString &deviceName, const QMap<QString, QString> &config)
 {
     m_deviceConfigs[deviceName] = config;
+    saveRegistry();
     qDebug() << "设置设备配置:" << deviceName << config;
+    emit deviceConfigurationChanged(deviceName);
 }
 
 QMap<QString, QString> DeviceManager::getDeviceConfiguration(const QString &deviceName)
 {
     return m_deviceConfigs.value(deviceName, QMap<QString, QString>());
-} 
\ No newline at end of file
+} 
+
+int DeviceManager::requestLease(const QString &deviceName, const QString &kind, int priority)
+{
+    DeviceLease lease;
+    lease.id = m_nextLeaseId++;
+    lease.deviceName = deviceName;
+    lease.unit = physicalUnit(deviceName);
+    lease.kind = kind;
+    lease.priority = priority;
+    lease.requested = QDateTime::currentDateTime();
+    m_leases.insert(lease.id, lease);
+    
+    qDebug() << "申请设备租约:" << lease.id << deviceName << kind << "优先级:" << priority;
+    
+    // 授予结果异步通知，调用方可以先保存租约ID
+    if (!m_dispatchPending) {
+        m_dispatchPending = true;
+        QMetaObject::invokeMethod(this, "dispatchLeases", Qt::QueuedConnection);
+    }
+    return lease.id;
+}
+
+void DeviceManager::releaseLease(int leaseId)
+{
+    if (!m_leases.contains(leaseId)) {
+        return;
+    }
+    
+    DeviceLease lease = m_leases.take(leaseId);
+    qDebug() << "释放设备租约:" << leaseId << lease.deviceName << lease.kind
+             << (lease.granted ? "" : "(未授予)");
+    
+    if (!m_dispatchPending) {
+        m_dispatchPending = true;
+        QMetaObject::invokeMethod(this, "dispatchLeases", Qt::QueuedConnection);
+    }
+}
+
+bool DeviceManager::isLeaseGranted(int leaseId) const
+{
+    return m_leases.value(leaseId).granted;
+}
+
+void DeviceManager::setMaxConcurrentLeases(const QString &kind, int count)
+{
+    m_maxConcurrentLeases[kind] = qMax(count, 0);
+}
+
+void DeviceManager::dispatchLeases()
+{
+    m_dispatchPending = false;
+    
+    // 按物理设备分组：已授予的租约和等待中的租约
+    QMap<QString, QList<DeviceLease>> waiting;
+    QMap<QString, QString> activeKind;
+    QMap<QString, int> activeCount;
+    for (const DeviceLease &lease : m_leases) {
+        if (lease.granted) {
+            activeKind[lease.unit] = lease.kind;
+            activeCount[lease.unit]++;
+        } else {
+            waiting[lease.unit].append(lease);
+        }
+    }
+    
+    for (auto it = waiting.begin(); it != waiting.end(); ++it) {
+        const QString &unit = it.key();
+        QList<DeviceLease> &queue = it.value();
+        
+        // 有效优先级高的在前；相同时与上一次授予类型不同的在前，实现扫描和打印交替；再按申请顺序
+        QString lastKind = m_lastLeaseKind.value(unit);
+        std::stable_sort(queue.begin(), queue.end(),
+                         [this, &lastKind](const DeviceLease &a, const DeviceLease &b) {
+            int pa = effectivePriority(a);
+            int pb = effectivePriority(b);
+            if (pa != pb) {
+                return pa > pb;
+            }
+            if ((a.kind != lastKind) != (b.kind != lastKind)) {
+                return a.kind != lastKind;
+            }
+            return a.id < b.id;
+        });
+        
+        // 依次授予队首；队首类型与正在进行的类型不同时等待其完成，后面的同类工作也不再插队
+        for (const DeviceLease &head : queue) {
+            QString kind = activeKind.value(unit);
+            int count = activeCount.value(unit);
+            int limit = m_maxConcurrentLeases.value(head.kind, 1);
+            
+            if (count > 0 && (kind != head.kind || (limit > 0 && count >= limit))) {
+                break;
+            }
+            
+            m_leases[head.id].granted = true;
+            activeKind[unit] = head.kind;
+            activeCount[unit] = count + 1;
+            m_lastLeaseKind[unit] = head.kind;
+            
+            qDebug() << "授予设备租约:" << head.id << head.deviceName << head.kind
+                     << "等待(秒):" << head.requested.secsTo(QDateTime::currentDateTime());
+            emit leaseGranted(head.id, head.deviceName, head.kind);
+        }
+    }
+}
+
+QString DeviceManager::physicalUnit(const QString &deviceName) const
+{
+    // 一体机的扫描条目（airscan:...）和打印队列名称不同，按网络地址或型号归为同一台设备
+    QString host = deviceHost(deviceName);
+    if (!host.isEmpty()) {
+        return host;
+    }
+    
+    QString model = m_deviceModels.value(deviceName);
+    if (!model.isEmpty() && model != "Unknown") {
+        return model;
+    }
+    return deviceName;
+}
+
+int DeviceManager::effectivePriority(const DeviceLease &lease) const
+{
+    // 等待时间越长优先级越高，低优先级的工作不会一直被插队
+    return lease.priority + lease.requested.secsTo(QDateTime::currentDateTime()) / LeaseAgingSecs;
+}
@@ -4,6 +4,29 @@
 #include <QObject>
 #include <QStringList>
 #include <QMap>
+#include <QThread>
+#include <QSet>
+#include <QDateTime>
+#include <QTimer>
+#include <QProcess>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class DeviceDiscoveryWorker;
+class ProcessWatchdog;
+
+// 设备租约：扫描和打印在同一台一体机上轮流进行
+struct DeviceLease
+{
+    int id = 0;
+    QString deviceName;
+    QString unit;            // 物理设备（一体机的扫描和打印条目共用）
+    QString kind;            // "scan" / "print"
+    int priority = 0;        // 越大越优先
+    QDateTime requested;
+    bool granted = false;
+};
 
 class DeviceManager : public QObject
 {
@@ -13,8 +36,12 @@ public:
     explicit DeviceManager(QObject *parent = nullptr);
     ~DeviceManager();
 
-    // 设备发现和管理
+    // 设备发现和管理（发现在后台线程进行，结果通过 deviceDiscovered 逐个上报）
+    // 已知设备保存在本地注册表中，启动时立即加载，再在后台重新验证
     QStringList discoverDevices();
+    void startDiscovery();
+    bool isDiscovering() const { return m_discovering; }
+    QStringList getKnownDevices() const;
     QStringList getMultifunctionDevices();
     QStringList getScanDevices();
     QStringList getPrintDevices();
@@ -23,6 +50,7 @@ public:
     QString getDeviceType(const QString &deviceName);
     QString getDeviceModel(const QString &deviceName);
     QString getDeviceCapabilities(const QString &deviceName);
+    QString getDeviceHost(const QString &deviceName) const { return deviceHost(deviceName); }
     
     // 设备选择
     bool selectDevice(const QString &deviceName);
@@ -44,22 +72,56 @@ public:
     void setDeviceConfiguration(const QString &deviceName, const QMap<QString, QString> &config);
     QMap<QString, QString> getDeviceConfiguration(const QString &deviceName);
     
-    // 新增：设备状态监控
+    // 新增：设备状态监控（有任务时快速轮询，空闲时慢速轮询，只上报状态变化）
     void startDeviceMonitoring();
     void stopDeviceMonitoring();
     void refreshDeviceStatus();
+    void setDeviceActive(const QString &deviceName, bool active);
+    QStringList getDeviceStateReasons(const QString &deviceName) const;
+    
+    // 设备租约：同类工作可同时进行，扫描和打印互斥；按优先级排队，等待越久优先级越高，
+    // 优先级相同时扫描和打印交替获得设备。结果通过 leaseGranted 异步通知
+    enum LeasePriority { BackgroundPriority = 0, NormalPriority = 50, UrgentPriority = 100 };
+    int requestLease(const QString &deviceName, const QString &kind, int priority = NormalPriority);
+    void releaseLease(int leaseId);
+    bool isLeaseGranted(int leaseId) const;
+    void setMaxConcurrentLeases(const QString &kind, int count);
+    
+    // 进纸器监视：轮询 eSCL ScannerStatus，放入纸张后发出 scannerAdfLoaded
+    void watchScannerFeeder(const QString &deviceName, const QUrl &esclBaseUrl);
+    void unwatchScannerFeeder(const QString &deviceName);
+    bool isWatchingScannerFeeder(const QString &deviceName) const { return m_feederWatches.contains(deviceName); }
 
 signals:
     void deviceDiscovered(const QString &deviceName, const QString &deviceType);
     void deviceSelected(const QString &deviceName);
     void deviceStatusChanged(const QString &deviceName, const QString &status);
     void deviceError(const QString &deviceName, const QString &error);
+    void discoveryFinished(const QStringList &devices);
+    void registryChanged(const QStringList &added, const QStringList &removed, const QStringList &changed);
+    void deviceConfigurationChanged(const QString &deviceName);
     
     // 新增：设备监控信号
     void deviceConnected(const QString &deviceName);
     void deviceDisconnected(const QString &deviceName);
     void deviceBusy(const QString &deviceName);
     void deviceReady(const QString &deviceName);
+    
+    // 设备租约
+    void leaseGranted(int leaseId, const QString &deviceName, const QString &kind);
+    
+    // 进纸器事件
+    void scannerAdfLoaded(const QString &deviceName);
+
+private slots:
+    void onDeviceFound(const QString &deviceName, const QString &deviceType,
+                       const QString &deviceModel, const QStringList &capabilities);
+    void onDiscoveryFinished(const QStringList &devices, bool complete);
+    void onPrinterStatusFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onPrinterUriFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void dispatchLeases();
+    void pollScannerFeeders();
+    void onScannerStatusFinished();
 
 private:
     QString m_currentDevice;
@@ -70,10 +132,60 @@ private:
     
     // 辅助方法
     void initializeDeviceDatabase();
-    void detectBrotherMFCJ3940DW();
+    QMap<QString, QString> defaultConfiguration() const;
     QStringList parseDeviceCapabilities(const QString &deviceName);
     
+    // 设备注册表持久化
+    QString registryPath() const;
+    bool loadRegistry();
+    void saveRegistry();
+    
+    // 状态监控辅助方法
+    void updateDeviceState(const QString &deviceName, const QString &state, const QStringList &reasons);
+    void checkScannerReachability();
+    QString deviceHost(const QString &deviceName) const;
+    QString describeStateReason(const QString &reason) const;
+    void scheduleNextPoll();
+    
+    // 租约辅助方法
+    QString physicalUnit(const QString &deviceName) const;
+    int effectivePriority(const DeviceLease &lease) const;
+    
     bool m_simulationMode; // 新增：模拟模式标志
+    
+    // 后台设备发现
+    QThread *m_discoveryThread;
+    DeviceDiscoveryWorker *m_discoveryWorker;
+    bool m_discovering;
+    QDateTime m_lastDiscovery;
+    QSet<QString> m_seenDevices;       // 本轮发现中确认存在的设备
+    QMap<QString, int> m_missedRounds; // 设备 -> 连续未被发现的轮数
+    QStringList m_addedDevices;        // 本轮新增的设备
+    QStringList m_changedDevices;      // 本轮信息有变化的设备
+    
+    // 状态监控
+    QTimer *m_monitorTimer;
+    QProcess *m_statusProcess;
+    bool m_monitoring;
+    ProcessWatchdog *m_watchdog;
+    QSet<QString> m_activeDevices;                 // 本程序正在使用的设备（扫描/打印中）
+    QMap<QString, QString> m_deviceStates;         // 设备 -> Ready/Busy/Stopped/Offline
+    QMap<QString, QStringList> m_deviceReasons;    // 设备 -> printer-state-reasons
+    QSet<QString> m_pendingReachability;           // 正在检测连通性的扫描设备
+    
+    // 设备租约
+    QMap<int, DeviceLease> m_leases;               // 租约ID -> 租约（等待中和已授予）
+    QMap<QString, QString> m_lastLeaseKind;        // 物理设备 -> 最近授予的工作类型
+    QMap<QString, int> m_maxConcurrentLeases;      // 工作类型 -> 同时授予上限
+    int m_nextLeaseId;
+    bool m_dispatchPending;
+    
+    // 进纸器监视
+    QNetworkAccessManager *m_network;
+    QTimer *m_feederTimer;
+    QMap<QString, QUrl> m_feederWatches;           // 设备 -> eSCL 地址
+    QMap<QString, QString> m_adfStates;            // 设备 -> 最近的 AdfState
+    QMap<QString, QNetworkReply*> m_feederReplies; // 正在进行的状态查询
 };
 
 #endif // DEVICEMANAGER_H 
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include "esclclient.h"
+#include <QDebug>
+#include <QTimer>
+#include <QDateTime>
+#include <QXmlStreamWriter>
+
+namespace {
+const int BusyRetryDelay = 1000;       // 扫描仪返回 503 时的重试间隔
+const int DefaultRequestTimeout = 10000;
+const int DefaultPageTimeout = 180000;
+}
+
+EsclClient::EsclClient(QObject *parent)
+    : QObject(parent),
+      m_network(new QNetworkAccessManager(this)),
+      m_busy(false),
+      m_noMorePages(false),
+      m_maxPages(0),
+      m_receivedPages(0),
+      m_requestTimeout(DefaultRequestTimeout),
+      m_pageTimeout(DefaultPageTimeout),
+      m_createReply(nullptr),
+      m_pageReply(nullptr)
+{
+}
+
+EsclClient::~EsclClient()
+{
+    if (m_createReply) {
+        m_createReply->disconnect(this);
+        m_createReply->abort();
+    }
+    if (m_pageReply) {
+        m_pageReply->disconnect(this);
+        m_pageReply->abort();
+    }
+}
+
+void EsclClient::setBaseUrl(const QUrl &baseUrl)
+{
+    m_baseUrl = baseUrl;
+}
+
+void EsclClient::setTimeouts(int requestTimeoutMs, int pageTimeoutMs)
+{
+    m_requestTimeout = requestTimeoutMs;
+    m_pageTimeout = pageTimeoutMs;
+}
+
+void EsclClient::armTimeout(QNetworkReply *reply, int timeoutMs)
+{
+    // 计时器随请求一起释放；扫描仪无响应时中止请求，finished 中按超时处理
+    QTimer::singleShot(timeoutMs, reply, [this, reply]() {
+        reply->setProperty("timedOut", true);
+        emit requestTimedOut(reply->url().path().section('/', -1));
+        reply->abort();
+    });
+}
+
+QString EsclClient::replyError(QNetworkReply *reply, const QString &request) const
+{
+    if (reply->property("timedOut").toBool()) {
+        return request + " timed out";
+    }
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return QString("%1 failed: HTTP %2 %3").arg(request).arg(status).arg(reply->errorString());
+}
+
+QByteArray EsclClient::buildScanSettings(const EsclScanSettings &settings)
+{
+    // 扫描区域以 1/300 英寸为单位
+    int width = qRound(settings.widthMm / 25.4 * 300);
+    int height = qRound(settings.heightMm / 25.4 * 300);
+    
+    QByteArray xml;
+    QXmlStreamWriter writer(&xml);
+    writer.writeStartDocument();
+    writer.writeNamespace("http://schemas.hp.com/imaging/escl/2011/05/03", "scan");
+    writer.writeNamespace("http://www.pwg.org/schemas/2010/12/sm", "pwg");
+    writer.writeStartElement("http://schemas.hp.com/imaging/escl/2011/05/03", "ScanSettings");
+    
+    const QString pwg = "http://www.pwg.org/schemas/2010/12/sm";
+    const QString scan = "http://schemas.hp.com/imaging/escl/2011/05/03";
+    writer.writeTextElement(pwg, "Version", "2.63");
+    writer.writeStartElement(pwg, "ScanRegions");
+    writer.writeStartElement(pwg, "ScanRegion");
+    writer.writeTextElement(pwg, "ContentRegionUnits", "escl:ThreeHundredthsOfInches");
+    writer.writeTextElement(pwg, "XOffset", "0");
+    writer.writeTextElement(pwg, "YOffset", "0");
+    writer.writeTextElement(pwg, "Width", QString::number(width));
+    writer.writeTextElement(pwg, "Height", QString::number(height));
+    writer.writeEndElement();
+    writer.writeEndElement();
+    writer.writeTextElement(scan, "DocumentFormatExt", settings.documentFormat);
+    writer.writeTextElement(pwg, "InputSource", settings.inputSource);
+    writer.writeTextElement(scan, "ColorMode", settings.colorMode);
+    writer.writeTextElement(scan, "XResolution", QString::number(settings.resolution));
+    writer.writeTextElement(scan, "YResolution", QString::number(settings.resolution));
+    if (settings.inputSource == "Feeder") {
+        writer.writeTextElement(scan, "Duplex", settings.duplex ? "true" : "false");
+    }
+    
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    return xml;
+}
+
+bool EsclClient::startJob(const EsclScanSettings &settings, int maxPages)
+{
+    if (m_busy) {
+        qDebug() << "eSCL 扫描任务正在进行:" << m_jobUrl;
+        return false;
+    }
+    if (!m_baseUrl.isValid()) {
+        emit jobFailed("eSCL base URL not set");
+        return false;
+    }
+    
+    m_busy = true;
+    m_noMorePages = false;
+    m_maxPages = maxPages;
+    m_receivedPages = 0;
+    m_jobUrl.clear();
+    m_jobTimer.start();
+    
+    QNetworkRequest request(QUrl(m_baseUrl.toString() + "/ScanJobs"));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "text/xml");
+    m_createReply = m_network->post(request, buildScanSettings(settings));
+    connect(m_createReply, &QNetworkReply::finished, this, &EsclClient::onJobCreated);
+    armTimeout(m_createReply, m_requestTimeout);
+    return true;
+}
+
+void EsclClient::cancelJob()
+{
+    if (!m_busy) return;
+    
+    if (m_createReply) {
+        m_createReply->disconnect(this);
+        m_createReply->abort();
+        m_createReply->deleteLater();
+        m_createReply = nullptr;
+    }
+    if (m_pageReply) {
+        m_pageReply->disconnect(this);
+        m_pageReply->abort();
+        m_pageReply->deleteLater();
+        m_pageReply = nullptr;
+    }
+    
+    // 通知扫描仪取消任务，剩余纸张停止进纸
+    if (m_jobUrl.isValid()) {
+        QNetworkReply *reply = m_network->deleteResource(QNetworkRequest(m_jobUrl));
+        connect(reply, &QNetworkReply::finished, reply, &QObject::deleteLater);
+        armTimeout(reply, m_requestTimeout);
+    }
+    finishJob("Scan job cancelled");
+}
+
+void EsclClient::onJobCreated()
+{
+    // 只处理当前任务的创建响应；已取消或已结束的任务的响应直接丢弃
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+    reply->deleteLater();
+    if (reply != m_createReply || !m_busy) return;
+    m_createReply = nullptr;
+    
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    QUrl location = reply->header(QNetworkRequest::LocationHeader).toUrl();
+    
+    // 201 Created，Location 为任务地址（可能是相对路径）
+    if (status != 201 || !location.isValid()) {
+        finishJob(replyError(reply, "ScanJobs"));
+        return;
+    }
+    
+    m_jobUrl = reply->url().resolved(location);
+    qDebug() << "eSCL 扫描任务已创建:" << m_jobUrl << "耗时(ms):" << m_jobTimer.elapsed();
+    emit jobStarted(m_jobUrl);
+    
+    requestNextPage();
+}
+
+void EsclClient::requestNextPage()
+{
+    // NextDocument 按顺序返回页面，上一页收完后再请求下一页；
+    // 同时发出多个请求时扫描仪的响应顺序没有保证
+    QNetworkRequest request(QUrl(m_jobUrl.toString() + "/NextDocument"));
+    request.setAttribute(QNetworkRequest::User, QDateTime::currentMSecsSinceEpoch());
+    
+    m_pageReply = m_network->get(request);
+    connect(m_pageReply, &QNetworkReply::finished, this, &EsclClient::onPageFinished);
+    armTimeout(m_pageReply, m_pageTimeout);
+}
+
+void EsclClient::onPageFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || reply != m_pageReply) return;
+    
+    m_pageReply = nullptr;
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    reply->deleteLater();
+    
+    if (status == 200) {
+        QByteArray data = reply->readAll();
+        qint64 requested = reply->request().attribute(QNetworkRequest::User).toLongLong();
+        int page = ++m_receivedPages;
+        qDebug() << "eSCL 页面:" << page << "字节:" << data.size()
+                 << "耗时(ms):" << QDateTime::currentMSecsSinceEpoch() - requested;
+        emit pageReceived(page, data);
+    } else if (status == 404) {
+        // 进纸器中已没有纸张，任务结束
+        m_noMorePages = true;
+    } else if (status == 503) {
+        // 扫描仪忙（仍在进纸），稍后重新请求；期间任务被取消或换成新任务时不再请求
+        QUrl jobUrl = m_jobUrl;
+        QTimer::singleShot(BusyRetryDelay, this, [this, jobUrl]() {
+            if (m_busy && m_jobUrl == jobUrl && !m_noMorePages && !m_pageReply) requestNextPage();
+        });
+        return;
+    } else {
+        finishJob(replyError(reply, "NextDocument"));
+        return;
+    }
+    
+    bool limitReached = m_maxPages > 0 && m_receivedPages >= m_maxPages;
+    if (!m_noMorePages && !limitReached) {
+        requestNextPage();
+        return;
+    }
+    
+    // 达到页数上限但进纸器里还有纸时结束扫描仪上的任务
+    if (!m_noMorePages) {
+        QNetworkReply *cancel = m_network->deleteResource(QNetworkRequest(m_jobUrl));
+        connect(cancel, &QNetworkReply::finished, cancel, &QObject::deleteLater);
+        armTimeout(cancel, m_requestTimeout);
+    }
+    finishJob();
+}
+
+void EsclClient::finishJob(const QString &error)
+{
+    if (!m_busy) return;
+    m_busy = false;
+    
+    if (!error.isEmpty()) {
+        qDebug() << "eSCL 扫描失败:" << error;
+        emit jobFailed(error);
+        return;
+    }
+    
+    qint64 elapsed = m_jobTimer.elapsed();
+    qDebug() << "eSCL 扫描完成，页数:" << m_receivedPages << "总耗时(ms):" << elapsed
+             << "平均每页(ms):" << (m_receivedPages > 0 ? elapsed / m_receivedPages : 0);
+    emit jobCompleted(m_receivedPages);
+}
@@ -0,0 +1,75 @@
+#ifndef ESCLCLIENT_H
+#define ESCLCLIENT_H
+
+#include <QObject>
+#include <QUrl>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+// eSCL 扫描参数
+struct EsclScanSettings
+{
+    int resolution = 300;
+    QString colorMode = "RGB24";        // RGB24 / Grayscale8 / BlackAndWhite1
+    QString inputSource = "Feeder";     // Feeder / Platen
+    bool duplex = false;
+    double widthMm = 297.0;
+    double heightMm = 420.0;
+    QString documentFormat = "image/jpeg";
+};
+
+// eSCL（AirScan）客户端：直接通过HTTP向扫描仪提交 ScanJobs 并拉取页面，不经过SANE。
+// 基础地址可指向本地的 eSCL 模拟服务器进行测试
+class EsclClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EsclClient(QObject *parent = nullptr);
+    ~EsclClient();
+
+    void setBaseUrl(const QUrl &baseUrl);      // 如 http://192.168.1.20/eSCL
+    QUrl baseUrl() const { return m_baseUrl; }
+    
+    // 创建任务的期限和单页期限，超时后中止请求，任务以失败结束
+    void setTimeouts(int requestTimeoutMs, int pageTimeoutMs);
+    
+    bool startJob(const EsclScanSettings &settings, int maxPages = 0);
+    void cancelJob();
+    bool isBusy() const { return m_busy; }
+    
+    static QByteArray buildScanSettings(const EsclScanSettings &settings);
+
+signals:
+    void jobStarted(const QUrl &jobUrl);
+    void pageReceived(int page, const QByteArray &data);
+    void jobCompleted(int pages);
+    void jobFailed(const QString &error);
+    void requestTimedOut(const QString &request);   // ScanJobs / NextDocument
+
+private slots:
+    void onJobCreated();
+    void onPageFinished();
+
+private:
+    QNetworkAccessManager *m_network;
+    QUrl m_baseUrl;
+    QUrl m_jobUrl;
+    bool m_busy;
+    bool m_noMorePages;         // 已收到 404，没有更多页面
+    int m_maxPages;
+    int m_receivedPages;        // 页码在收到页面时按顺序分配
+    int m_requestTimeout;
+    int m_pageTimeout;
+    QNetworkReply *m_createReply; // 进行中的 ScanJobs 请求，取消或重新开始后旧的响应不再处理
+    QNetworkReply *m_pageReply; // 进行中的 NextDocument 请求，同一时间只有一个
+    QElapsedTimer m_jobTimer;
+    
+    void requestNextPage();
+    void armTimeout(QNetworkReply *reply, int timeoutMs);
+    QString replyError(QNetworkReply *reply, const QString &request) const;
+    void finishJob(const QString &error = QString());
+};
+
+#endif // ESCLCLIENT_H
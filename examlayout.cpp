@@ -0,0 +1,71 @@
+#include "examlayout.h"
+#include <QJsonArray>
+
+namespace {
+QPointF pointFromJson(const QJsonValue &value)
+{
+    QJsonArray array = value.toArray();
+    return QPointF(array.at(0).toDouble(), array.at(1).toDouble());
+}
+
+QRectF rectFromJson(const QJsonValue &value)
+{
+    QJsonArray array = value.toArray();
+    return QRectF(array.at(0).toDouble(), array.at(1).toDouble(), array.at(2).toDouble(), array.at(3).toDouble());
+}
+}
+
+SheetLayout ExamLayout::side(int pageIndex) const
+{
+    if (sides.isEmpty()) {
+        return SheetLayout();
+    }
+    return sides.at(qMax(0, pageIndex) % sides.size());
+}
+
+ExamLayout ExamLayout::fromJson(const QJsonObject &json)
+{
+    ExamLayout layout;
+    const QJsonArray sides = json.value("sides").toArray();
+    for (const QJsonValue &sideValue : sides) {
+        // 各面未指定的尺寸和标记大小沿用整张答题卡的设置
+        QJsonObject object = sideValue.toObject();
+        SheetLayout side;
+        side.widthMm = object.value("width").toDouble(json.value("width").toDouble());
+        side.heightMm = object.value("height").toDouble(json.value("height").toDouble());
+        side.markSizeMm = object.value("markSize").toDouble(json.value("markSize").toDouble(side.markSizeMm));
+        for (const QJsonValue &mark : object.value("marks").toArray()) {
+            side.marks.append(pointFromJson(mark));
+        }
+        for (const QJsonValue &regionValue : object.value("regions").toArray()) {
+            QJsonObject regionObject = regionValue.toObject();
+            LayoutRegion region;
+            region.id = regionObject.value("id").toString();
+            region.rect = rectFromJson(regionObject.value("rect"));
+            if (!region.rect.isEmpty()) {
+                side.regions.append(region);
+            }
+        }
+        for (const QJsonValue &questionValue : object.value("questions").toArray()) {
+            QJsonObject questionObject = questionValue.toObject();
+            OmrQuestion question;
+            question.id = questionObject.value("id").toString();
+            question.multiple = questionObject.value("multiple").toBool();
+            for (const QJsonValue &bubble : questionObject.value("bubbles").toArray()) {
+                question.bubbles.append(rectFromJson(bubble));
+            }
+            // 未给出选项字母时按 A、B、C… 顺序命名
+            question.options = questionObject.value("options").toString();
+            for (int i = question.options.size(); i < question.bubbles.size(); ++i) {
+                question.options.append(QChar('A' + i));
+            }
+            if (!question.bubbles.isEmpty()) {
+                side.questions.append(question);
+            }
+        }
+        if (side.isValid()) {
+            layout.sides.append(side);
+        }
+    }
+    return layout;
+}
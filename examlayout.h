@@ -0,0 +1,54 @@
+#ifndef EXAMLAYOUT_H
+#define EXAMLAYOUT_H
+
+#include <QString>
+#include <QVector>
+#include <QPointF>
+#include <QRectF>
+#include <QJsonObject>
+
+// 答题区域：版面坐标（毫米，原点为纸张左上角）
+struct LayoutRegion
+{
+    QString id;                     // 题号或区域名，如 "17"、"作文"
+    QRectF rect;
+};
+
+// 客观题：各选项的填涂框（版面坐标，毫米）
+struct OmrQuestion
+{
+    QString id;                     // 题号
+    QString options;                // 选项字母，与 bubbles 一一对应，如 "ABCD"
+    QVector<QRectF> bubbles;
+    bool multiple = false;          // 多选题
+};
+
+// 答题卡一面的版面：定位标记、答题区域和客观题
+struct SheetLayout
+{
+    double widthMm = 0;             // 纸张尺寸，用于估计定位标记的初始位置
+    double heightMm = 0;
+    QVector<QPointF> marks;         // 定位标记（实心方块）中心，一般在四角
+    double markSizeMm = 5;          // 定位标记边长
+    QVector<LayoutRegion> regions;
+    QVector<OmrQuestion> questions; // 在本机识别，只上传答案
+
+    // 至少三个定位标记才能确定仿射变换
+    bool isValid() const { return widthMm > 0 && heightMm > 0 && marks.size() >= 3; }
+};
+
+// 按考试下发的答题卡版面模板，随班级信息一起获取
+struct ExamLayout
+{
+    QVector<SheetLayout> sides;     // 双面答题卡按正面、反面排列
+
+    bool isValid() const { return !sides.isEmpty(); }
+    // 批次中第 pageIndex 页（从0开始）的版面，双面时正反面交替
+    SheetLayout side(int pageIndex) const;
+
+    // {"width":297,"height":420,"markSize":5,"sides":[{"marks":[[x,y],...],"regions":[{"id":"1","rect":[x,y,w,h]}],
+    //  "questions":[{"id":"1","options":"ABCD","multiple":false,"bubbles":[[x,y,w,h],...]}]}]}
+    static ExamLayout fromJson(const QJsonObject &json);
+};
+
+#endif // EXAMLAYOUT_H
@@ -2,14 +2,20 @@
 #include "networkmanager.h"
 #include "scanmanager.h"
 #include "printmanager.h"
+#include "devicemanager.h"
 #include <QDebug>
 #include <QJsonDocument>
+#include <algorithm>
 
 ExamManager::ExamManager(QObject *parent)
     : QObject(parent)
     , m_networkManager(nullptr)
     , m_scanManager(nullptr)
     , m_printManager(nullptr)
+    , m_deviceManager(nullptr)
+    , m_streamPrinting(true)
+    , m_maxActivePrintGroups(2)
+    , m_printerPagesPerMinute(20)
     , m_pollTimer(new QTimer(this))
 {
     // 设置定时器用于轮询任务状态
@@ -23,17 +29,29 @@ ExamManager::~ExamManager()
 
 void ExamManager::initialize(NetworkManager *networkManager, 
                            ScanManager *scanManager, 
-                           PrintManager *printManager)
+                           PrintManager *printManager,
+                           DeviceManager *deviceManager)
 {
     m_networkManager = networkManager;
     m_scanManager = scanManager;
     m_printManager = printManager;
+    m_deviceManager = deviceManager;
+    
+    // 打印组在获得设备租约后才开始下载打印
+    if (m_deviceManager) {
+        connect(m_deviceManager, &DeviceManager::leaseGranted,
+                this, &ExamManager::onLeaseGranted);
+    }
     
     // 连接网络管理器信号
     connect(m_networkManager, &NetworkManager::examTypesReceived,
             this, &ExamManager::onExamTypesReceived);
     connect(m_networkManager, &NetworkManager::classInfoReceived,
             this, &ExamManager::onClassInfoReceived);
+    connect(m_networkManager, &NetworkManager::examLayoutReceived,
+            this, &ExamManager::onExamLayoutReceived);
+    connect(m_networkManager, &NetworkManager::examScanSettingsReceived,
+            this, &ExamManager::onExamScanSettingsReceived);
     connect(m_networkManager, &NetworkManager::scanTasksReceived,
             this, &ExamManager::onScanTasksReceived);
     connect(m_networkManager, &NetworkManager::printTasksReceived,
@@ -45,6 +63,14 @@ void ExamManager::initialize(NetworkManager *networkManager,
     connect(m_networkManager, &NetworkManager::networkError,
             this, &ExamManager::onNetworkError);
     
+    // 流式打印：下载数据直接转发给打印管理器
+    connect(m_networkManager, &NetworkManager::printStreamData,
+            m_printManager, &PrintManager::writePrintStream);
+    connect(m_networkManager, &NetworkManager::printStreamFinished,
+            this, &ExamManager::onPrintStreamFinished);
+    connect(m_printManager, &PrintManager::printStreamBackpressure,
+            m_networkManager, &NetworkManager::setPrintStreamPaused);
+    
     // 连接扫描管理器信号
     connect(m_scanManager, &ScanManager::scanError,
             this, &ExamManager::onScanError);
@@ -52,6 +78,18 @@ void ExamManager::initialize(NetworkManager *networkManager,
     // 连接打印管理器信号
     connect(m_printManager, &PrintManager::printError,
             this, &ExamManager::onPrintError);
+    // 提交失败可能在提交调用中同步发出，排队处理，避免在下发打印组的过程中重入调度
+    connect(m_printManager, &PrintManager::printJobFailed,
+            this, &ExamManager::onPrintJobFailed, Qt::QueuedConnection);
+    connect(m_printManager, &PrintManager::printCompleted,
+            this, &ExamManager::onPrintCompleted);
+    connect(m_printManager, &PrintManager::printJobSplit,
+            this, &ExamManager::onPrintJobSplit);
+    // 打印队列由 PrintManager 统一跟踪，任务离开队列时通知
+    connect(m_printManager, &PrintManager::printJobFinished,
+            this, &ExamManager::onPrintJobFinished);
+    connect(m_printManager, &PrintManager::pdfPreflighted,
+            this, &ExamManager::onPdfPreflighted);
     
     // 启动定时器
     m_pollTimer->start();
@@ -132,7 +170,7 @@ void ExamManager::startPrintTask(const QString &taskId, const QString &filePath)
     }
     
     // 开始打印
-    if (m_printManager->printFile("default-printer", filePath, "Task_" + taskId)) {
+    if (m_printManager->printFile(printDevice(), filePath, "Task_" + taskId)) {
         updateTaskStatus(taskId, "打印中");
         qDebug() << "Started print task" << taskId;
     } else {
@@ -141,6 +179,24 @@ void ExamManager::startPrintTask(const QString &taskId, const QString &filePath)
     }
 }
 
+void ExamManager::setStreamPrinting(bool enable)
+{
+    m_streamPrinting = enable;
+    qDebug() << "流式打印:" << (enable ? "启用" : "禁用");
+}
+
+void ExamManager::setPrinterThroughput(int pagesPerMinute)
+{
+    m_printerPagesPerMinute = qMax(pagesPerMinute, 1);
+    checkPrintDeadlines();
+}
+
+void ExamManager::setMaxActivePrintGroups(int count)
+{
+    m_maxActivePrintGroups = qMax(count, 1);
+    schedulePrintWork();
+}
+
 void ExamManager::onExamTypesReceived(const QJsonArray &examTypes)
 {
     m_examTypes.clear();
@@ -161,8 +217,37 @@ void ExamManager::onClassInfoReceived(const QString &examType, const QJsonArray
     qDebug() << "Received class info for" << examType << ":" << classes.size() << "classes";
 }
 
+void ExamManager::onExamLayoutReceived(const QString &examType, const QJsonObject &layout)
+{
+    // 版面模板只随班级信息获取一次，之后每页扫描都按它裁出答题区域
+    ExamLayout examLayout = ExamLayout::fromJson(layout);
+    if (m_scanManager) {
+        m_scanManager->setExamLayout(examType, examLayout);
+    }
+    qDebug() << "Received answer sheet layout for" << examType << ":" << examLayout.sides.size() << "sides";
+}
+
+void ExamManager::onExamScanSettingsReceived(const QString &examType, const QJsonObject &settings)
+{
+    // {"bytesPerPage":409600,"binarization":"sauvola"}：每页上传的字节预算，0 或缺省表示按固定质量编码；
+    // 二值化方法（otsu/sauvola）非空时该考试输出黑白 TIFF，缺省为彩色/灰度 JPEG
+    if (m_scanManager) {
+        m_scanManager->setExamByteBudget(examType, qint64(settings.value("bytesPerPage").toDouble()));
+        m_scanManager->setExamBinarization(examType, settings.value("binarization").toString());
+    }
+    qDebug() << "Received scan settings for" << examType << ":" << settings;
+}
+
 void ExamManager::onScanTasksReceived(const QJsonArray &tasks)
 {
+    // 任务所属考试的班级信息（含答题卡版面和扫描要求）还没有获取时先获取，开始扫描前生效
+    for (const QJsonValue &value : tasks) {
+        QString examType = value.toObject().value("examType").toString();
+        if (!examType.isEmpty() && !m_classInfo.contains(examType)) {
+            refreshClassInfo(examType);
+        }
+    }
+    
     m_scanTasks = tasks;
     emit scanTasksUpdated(tasks);
     qDebug() << "Received" << tasks.size() << "scan tasks";
@@ -173,6 +258,9 @@ void ExamManager::onPrintTasksReceived(const QJsonArray &tasks)
     m_printTasks = tasks;
     emit printTasksUpdated(tasks);
     qDebug() << "Received" << tasks.size() << "print tasks";
+    
+    // 收到任务后立即处理，不必等待下一次轮询
+    checkPrintTaskStatus();
 }
 
 void ExamManager::onUploadCompleted(const QString &taskId, bool success)
@@ -191,19 +279,107 @@ void ExamManager::onUploadCompleted(const QString &taskId, bool success)
 
 void ExamManager::onDownloadCompleted(const QString &taskId, const QString &filePath, bool success)
 {
+    if (m_activePrintGroups.contains(taskId)) {
+        if (success) {
+            qDebug() << "Download completed for print group" << m_activePrintGroups.value(taskId).taskIds;
+            printCoalescedGroup(taskId, filePath);
+        } else {
+            // 下载失败：组内任务全部回到待处理状态，下次轮询重试
+            for (const QString &memberId : m_activePrintGroups.value(taskId).taskIds) {
+                finishPrintTask(memberId, "下载失败", true);
+            }
+            qDebug() << "Download failed for print group" << taskId;
+        }
+        schedulePrintWork();
+        return;
+    }
+    
     if (success) {
         updateTaskStatus(taskId, "可打印");
         qDebug() << "Download completed for task" << taskId << ":" << filePath;
     } else {
+        m_dispatchedPrintTasks.remove(taskId);
         updateTaskStatus(taskId, "下载失败");
         qDebug() << "Download failed for task" << taskId;
     }
 }
 
+void ExamManager::onPrintStreamFinished(const QString &taskId, bool success)
+{
+    if (success) {
+        m_printManager->endPrintStream(taskId);
+        updateTaskStatus(taskId, "打印中");
+        qDebug() << "Print stream completed for task" << taskId;
+    } else {
+        // 下载失败由这里结束任务，不再按打印失败处理
+        m_printJobTasks.remove("Task_" + taskId);
+        m_printManager->abortPrintStream(taskId);
+        finishPrintTask(taskId, "下载失败", true);
+        schedulePrintWork();
+        qDebug() << "Print stream failed for task" << taskId;
+    }
+}
+
 void ExamManager::onPrintCompleted(const QString &deviceName, const QString &jobName, int jobId)
 {
-    updateTaskStatus(jobName, "打印完成");
-    qDebug() << "Print completed:" << deviceName << jobName << "Job ID:" << jobId;
+    // lp 退出表示任务已提交到CUPS；按提交时记录的完整任务名称找到对应的任务
+    qDebug() << "Print submitted:" << deviceName << jobName << "Job ID:" << jobId;
+    QString taskId = m_printJobTasks.take(jobName);
+    if (taskId.isEmpty()) {
+        return;
+    }
+    if (!m_taskGroups.contains(taskId)) {
+        // 任务的其他页段已失败、任务将整份重新打印，晚到的页段取消
+        if (jobId > 0) {
+            m_printManager->cancelPrintJob(deviceName, jobId);
+        }
+        return;
+    }
+    
+    if (jobId > 0) {
+        m_cupsJobs[qMakePair(deviceName, jobId)] = taskId;
+        updateTaskStatus(taskId, "排队打印");
+        
+        // 新提交的任务可能比已在队列中的任务更紧急
+        preemptForUrgentGroup();
+    } else if (!hasOutstandingPrintJobs(taskId)) {
+        // 无法跟踪的任务按已提交处理；拆分提交的其他页段都结束后才释放调度名额
+        finishPrintTask(taskId, "打印中");
+        schedulePrintWork();
+    }
+}
+
+void ExamManager::onPrintJobSplit(const QString &deviceName, const QString &jobName, const QStringList &partNames)
+{
+    Q_UNUSED(deviceName);
+    
+    // 大文档按页段提交，之后按页段名称上报结果
+    QString taskId = m_printJobTasks.take(jobName);
+    if (taskId.isEmpty()) {
+        return;
+    }
+    for (const QString &partName : partNames) {
+        m_printJobTasks[partName] = taskId;
+    }
+}
+
+void ExamManager::onPrintJobFinished(const QString &deviceName, int jobId)
+{
+    PrintJobKey job = qMakePair(deviceName, jobId);
+    if (!m_cupsJobs.contains(job)) {
+        return;
+    }
+    
+    // 大文档可能被拆分成多个CUPS任务，全部提交并离开队列后任务才算完成
+    QString taskId = m_cupsJobs.take(job);
+    m_heldJobs.remove(job);
+    if (!hasOutstandingPrintJobs(taskId)) {
+        finishPrintTask(taskId, "打印完成");
+        qDebug() << "Print finished:" << taskId;
+    }
+    
+    releaseHeldJobs();
+    schedulePrintWork();
 }
 
 void ExamManager::onNetworkError(const QString &error)
@@ -219,9 +395,29 @@ void ExamManager::onScanError(const QString &error)
     qDebug() << "Scan error:" << error;
 }
 
-void ExamManager::onPrintError(const QString &error)
+void ExamManager::onPrintError(const QString &deviceName, const QString &error)
+{
+    qDebug() << "Print error:" << deviceName << error;
+}
+
+void ExamManager::onPrintJobFailed(const QString &deviceName, const QString &jobName, const QString &error)
 {
-    qDebug() << "Print error:" << error;
+    // 未能进入打印队列的任务释放调度名额（组内任务全部结束后归还设备租约），下次轮询时重试
+    QString taskId = m_printJobTasks.take(jobName);
+    if (taskId.isEmpty() || !m_taskGroups.contains(taskId)) {
+        return;
+    }
+    
+    qDebug() << "Print failed for task" << taskId << deviceName << error;
+    
+    // 拆分提交的任务：已进入队列的其他页段取消，重试时整份重新打印
+    for (const PrintJobKey &job : m_cupsJobs.keys(taskId)) {
+        m_printManager->cancelPrintJob(job.first, job.second);
+        m_cupsJobs.remove(job);
+        m_heldJobs.remove(job);
+    }
+    finishPrintTask(taskId, "打印失败", true);
+    schedulePrintWork();
 }
 
 void ExamManager::updateTaskStatus(const QString &taskId, const QString &status)
@@ -238,17 +434,384 @@ void ExamManager::moveTaskFromScanToPrint(const QString &taskId)
 
 void ExamManager::checkPrintTaskStatus()
 {
-    // 检查打印任务状态，如果处理完成则下载文件
+    // 检查打印任务状态，按源文件（哈希或URL）对处理完成的任务分组
     for (const QJsonValue &value : m_printTasks) {
         if (value.isObject()) {
             QJsonObject task = value.toObject();
             QString status = task["status"].toString();
             QString taskId = task["id"].toString();
             
-            if (status == "completed" && !task["fileUrl"].toString().isEmpty()) {
-                // 下载处理完成的文件
-                m_networkManager->downloadPrintFile(taskId, task["fileUrl"].toString());
+            if (status != "completed" || task["fileUrl"].toString().isEmpty()) {
+                continue;
+            }
+            if (m_dispatchedPrintTasks.contains(taskId)) {
+                continue;
             }
+            
+            m_dispatchedPrintTasks.insert(taskId);
+            m_printTaskInfo[taskId] = task;
+            
+            QDateTime deadline = printDeadline(task);
+            int seconds = estimatePrintSeconds(task);
+            QString key = printSourceKey(task);
+            
+            // 同一源文件且尚未下发的组直接合并
+            bool merged = false;
+            for (PrintGroup &group : m_pendingPrintGroups) {
+                if (group.sourceKey == key) {
+                    group.taskIds.append(taskId);
+                    group.estimatedSeconds += seconds;
+                    if (deadline.isValid() && (!group.deadline.isValid() || deadline < group.deadline)) {
+                        group.deadline = deadline;
+                    }
+                    merged = true;
+                    break;
+                }
+            }
+            
+            if (!merged) {
+                PrintGroup group;
+                group.leadId = taskId;
+                group.sourceKey = key;
+                group.fileUrl = task["fileUrl"].toString();
+                group.taskIds.append(taskId);
+                group.deadline = deadline;
+                group.estimatedSeconds = seconds;
+                m_pendingPrintGroups.append(group);
+            }
+            updateTaskStatus(taskId, "等待打印");
+        }
+    }
+    
+    schedulePrintWork();
+}
+
+void ExamManager::schedulePrintWork()
+{
+    // 考试开始早的优先；同一时间的考试，预计耗时短的优先
+    std::stable_sort(m_pendingPrintGroups.begin(), m_pendingPrintGroups.end(),
+                     [](const PrintGroup &a, const PrintGroup &b) {
+        if (a.deadline.isValid() != b.deadline.isValid()) {
+            return a.deadline.isValid();
+        }
+        if (a.deadline != b.deadline) {
+            return a.deadline < b.deadline;
+        }
+        return a.estimatedSeconds < b.estimatedSeconds;
+    });
+    
+    // 比已排队任务更紧急的组直接下发，并挂起较晚的任务
+    preemptForUrgentGroup();
+    
+    while (!m_pendingPrintGroups.isEmpty() && runningPrintGroupCount() < m_maxActivePrintGroups) {
+        startPrintGroup(m_pendingPrintGroups.takeFirst());
+    }
+    
+    checkPrintDeadlines();
+}
+
+void ExamManager::startPrintGroup(const PrintGroup &pending)
+{
+    PrintGroup group = pending;
+    group.deviceName = printDevice();
+    m_activePrintGroups[group.leadId] = group;
+    for (const QString &taskId : group.taskIds) {
+        m_taskGroups[taskId] = group.leadId;
+    }
+    
+    qDebug() << "下发打印任务组:" << group.taskIds << "截止时间:" << group.deadline
+             << "预计耗时(秒):" << group.estimatedSeconds;
+    
+    // 一体机正在扫描时等待租约，避免扫描和打印同时占用设备；临近考试的组优先
+    if (m_deviceManager) {
+        int priority = DeviceManager::NormalPriority;
+        if (group.deadline.isValid() && QDateTime::currentDateTime().secsTo(group.deadline) < 3600) {
+            priority = DeviceManager::UrgentPriority;
+        }
+        // 租约按实际的 CUPS 队列申请，DeviceManager 据此找到与扫描条目共用的一体机
+        m_groupLeases[group.leadId] = m_deviceManager->requestLease(group.deviceName, "print", priority);
+        for (const QString &taskId : group.taskIds) {
+            updateTaskStatus(taskId, "等待设备");
+        }
+        return;
+    }
+    
+    runPrintGroup(group.leadId);
+}
+
+void ExamManager::onLeaseGranted(int leaseId, const QString &deviceName, const QString &kind)
+{
+    Q_UNUSED(deviceName);
+    if (kind != "print") {
+        return;
+    }
+    
+    QString leadId = m_groupLeases.key(leaseId);
+    if (!leadId.isEmpty() && m_activePrintGroups.contains(leadId)) {
+        runPrintGroup(leadId);
+    }
+}
+
+void ExamManager::runPrintGroup(const QString &leadId)
+{
+    const PrintGroup group = m_activePrintGroups.value(leadId);
+    
+    if (group.taskIds.size() == 1 && m_streamPrinting) {
+        // 单个任务：边下载边打印，不落盘
+        QString taskId = group.leadId;
+        QString jobName = "Task_" + taskId;
+        m_printJobTasks[jobName] = taskId;
+        if (m_printManager->beginPrintStream(group.deviceName, taskId, jobName,
+                                             printCopies(m_printTaskInfo.value(taskId)))) {
+            m_networkManager->streamPrintFile(taskId, group.fileUrl);
+            updateTaskStatus(taskId, "下载打印中");
+        }
+        // 打开失败时 printJobFailed 结束该任务
+        return;
+    }
+    
+    // 多个任务共用同一文件：只下载一次，下载完成后按班级提交多份打印
+    for (const QString &taskId : group.taskIds) {
+        updateTaskStatus(taskId, "下载中");
+    }
+    qDebug() << "合并打印任务:" << group.taskIds << "源文件:" << group.fileUrl;
+    m_networkManager->downloadPrintFile(group.leadId, group.fileUrl);
+}
+
+void ExamManager::preemptForUrgentGroup()
+{
+    if (m_pendingPrintGroups.isEmpty()) {
+        return;
+    }
+    
+    const PrintGroup &urgent = m_pendingPrintGroups.first();
+    if (!urgent.deadline.isValid()) {
+        return;
+    }
+    
+    // 挂起已在CUPS队列中、但考试时间更晚的任务
+    bool preempted = false;
+    for (auto it = m_cupsJobs.constBegin(); it != m_cupsJobs.constEnd(); ++it) {
+        if (m_heldJobs.contains(it.key())) {
+            continue;
+        }
+        QDateTime jobDeadline = printDeadline(m_printTaskInfo.value(it.value()));
+        if (!jobDeadline.isValid() || jobDeadline > urgent.deadline) {
+            m_printManager->holdPrintJob(it.key().first, it.key().second);
+            m_heldJobs.insert(it.key());
+            preempted = true;
+        }
+    }
+    
+    // 挂起的组不占并发名额；名额仍已占满时紧急组留在队首，有组完成后最先下发
+    if (preempted && runningPrintGroupCount() < m_maxActivePrintGroups) {
+        qDebug() << "紧急打印任务插队:" << urgent.taskIds;
+        startPrintGroup(m_pendingPrintGroups.takeFirst());
+    }
+}
+
+int ExamManager::runningPrintGroupCount() const
+{
+    // 所有任务都已进入CUPS队列且全部被挂起的组视为暂停，不计入并发数量
+    int running = 0;
+    for (const PrintGroup &group : m_activePrintGroups) {
+        bool suspended = true;
+        for (const QString &taskId : group.taskIds) {
+            const QList<PrintJobKey> jobs = m_cupsJobs.keys(taskId);
+            bool held = !jobs.isEmpty();
+            for (const PrintJobKey &job : jobs) {
+                held = held && m_heldJobs.contains(job);
+            }
+            if (!held) {
+                suspended = false;
+                break;
+            }
+        }
+        if (!suspended) {
+            ++running;
+        }
+    }
+    return running;
+}
+
+void ExamManager::releaseHeldJobs()
+{
+    for (const PrintJobKey &job : m_heldJobs.values()) {
+        QDateTime heldDeadline = printDeadline(m_printTaskInfo.value(m_cupsJobs.value(job)));
+        
+        // 仍有更紧急的组在下载、打印或排在队首等待名额时继续挂起
+        bool blocked = false;
+        for (const PrintGroup &group : m_activePrintGroups.values() + m_pendingPrintGroups) {
+            if (group.deadline.isValid() && (!heldDeadline.isValid() || group.deadline < heldDeadline)) {
+                blocked = true;
+                break;
+            }
+        }
+        
+        if (!blocked) {
+            m_printManager->releasePrintJob(job.first, job.second);
+            m_heldJobs.remove(job);
+        }
+    }
+}
+
+void ExamManager::checkPrintDeadlines()
+{
+    // 按当前调度顺序模拟打印进度，预计完成时间晚于考试开始时间时提前预警
+    QDateTime cursor = QDateTime::currentDateTime();
+    QList<PrintGroup> ordered = m_activePrintGroups.values();
+    ordered.append(m_pendingPrintGroups);
+    
+    for (const PrintGroup &group : ordered) {
+        cursor = cursor.addSecs(group.estimatedSeconds);
+        if (!group.deadline.isValid() || cursor <= group.deadline) {
+            continue;
+        }
+        
+        for (const QString &taskId : group.taskIds) {
+            if (!m_deadlineWarnings.contains(taskId)) {
+                m_deadlineWarnings.insert(taskId);
+                qDebug() << "打印任务可能无法按时完成:" << taskId
+                         << "预计完成:" << cursor << "考试开始:" << group.deadline;
+                emit deadlineAtRisk(taskId, cursor, group.deadline);
+            }
+        }
+    }
+}
+
+void ExamManager::finishPrintTask(const QString &taskId, const QString &status, bool retry)
+{
+    updateTaskStatus(taskId, status);
+    
+    QString leadId = m_taskGroups.take(taskId);
+    if (m_activePrintGroups.contains(leadId)) {
+        PrintGroup &group = m_activePrintGroups[leadId];
+        group.taskIds.removeAll(taskId);
+        group.estimatedSeconds = qMax(0, group.estimatedSeconds - estimatePrintSeconds(m_printTaskInfo.value(taskId)));
+        if (group.taskIds.isEmpty()) {
+            m_activePrintGroups.remove(leadId);
+            if (m_deviceManager && m_groupLeases.contains(leadId)) {
+                m_deviceManager->releaseLease(m_groupLeases.take(leadId));
+            }
+        }
+    }
+    
+    m_printTaskInfo.remove(taskId);
+    m_deadlineWarnings.remove(taskId);
+    
+    // 失败的任务允许下次轮询时重新调度
+    if (retry) {
+        m_dispatchedPrintTasks.remove(taskId);
+    }
+}
+
+bool ExamManager::hasOutstandingPrintJobs(const QString &taskId) const
+{
+    // 还有尚未提交完成的页段，或已提交、仍在打印队列中的任务
+    return m_printJobTasks.values().contains(taskId) || !m_cupsJobs.keys(taskId).isEmpty();
+}
+
+QString ExamManager::printDevice() const
+{
+    // 当前选择的设备能打印时使用它，否则优先使用一体机的 CUPS 队列，再退回任意打印队列
+    if (m_deviceManager) {
+        QString current = m_deviceManager->getCurrentDevice();
+        if (!current.isEmpty() && m_deviceManager->canPrint(current)) {
+            return current;
+        }
+        QStringList printers = m_deviceManager->getPrintDevices();
+        for (const QString &printer : printers) {
+            if (m_deviceManager->isMultifunctionDevice(printer)) {
+                return printer;
+            }
+        }
+        if (!printers.isEmpty()) {
+            return printers.first();
+        }
+    }
+    return "default-printer";
+}
+
+QDateTime ExamManager::printDeadline(const QJsonObject &task) const
+{
+    // time 字段为考试开始时间，格式如 "2025/8/2 8:07:25"
+    return QDateTime::fromString(task["time"].toString(), "yyyy/M/d H:mm:ss");
+}
+
+int ExamManager::estimatePrintSeconds(const QJsonObject &task) const
+{
+    // 服务器未提供页数时按一份试卷4面估算
+    QJsonValue pagesValue = task["pages"];
+    int pages = pagesValue.isString() ? pagesValue.toString().toInt() : pagesValue.toInt();
+    if (pages <= 0) {
+        pages = 4;
+    }
+    
+    return pages * printCopies(task) * 60 / m_printerPagesPerMinute;
+}
+
+QString ExamManager::printSourceKey(const QJsonObject &task) const
+{
+    // 服务器提供文件哈希时优先使用，否则按文件URL判断是否为同一试卷
+    QString hash = task["fileHash"].toString();
+    return hash.isEmpty() ? task["fileUrl"].toString() : hash;
+}
+
+int ExamManager::printCopies(const QJsonObject &task) const
+{
+    // quantity 字段可能是字符串也可能是数字
+    QJsonValue quantity = task["quantity"];
+    int copies = quantity.isString() ? quantity.toString().toInt() : quantity.toInt();
+    return qMax(copies, 1);
+}
+
+void ExamManager::printCoalescedGroup(const QString &downloadId, const QString &filePath)
+{
+    // 预检要读取整个文件，在工作线程完成后再提交
+    m_preflightGroups[filePath] = downloadId;
+    m_printManager->preflightPdfAsync(filePath);
+}
+
+void ExamManager::onPdfPreflighted(const QString &filePath, const PdfPreflight &preflight)
+{
+    QString downloadId = m_preflightGroups.take(filePath);
+    if (!downloadId.isEmpty() && m_activePrintGroups.contains(downloadId)) {
+        submitCoalescedGroup(downloadId, filePath, preflight);
+    }
+}
+
+void ExamManager::submitCoalescedGroup(const QString &downloadId, const QString &filePath,
+                                       const PdfPreflight &preflight)
+{
+    QStringList taskIds = m_activePrintGroups.value(downloadId).taskIds;
+    QString deviceName = m_activePrintGroups.value(downloadId).deviceName;
+    
+    // 预检得到实际页数后更新预计打印时长，重新评估截止时间
+    if (preflight.valid && preflight.pageCount > 0 && m_activePrintGroups.contains(downloadId)) {
+        PrintGroup &group = m_activePrintGroups[downloadId];
+        group.estimatedSeconds = 0;
+        for (const QString &taskId : taskIds) {
+            m_printTaskInfo[taskId]["pages"] = preflight.pageCount;
+            group.estimatedSeconds += estimatePrintSeconds(m_printTaskInfo.value(taskId));
+        }
+        checkPrintDeadlines();
+    }
+    
+    // 多个班级共用一个文件时，只在班级之间插入分隔页（第一个班级之前不插入）
+    for (int i = 0; i < taskIds.size(); ++i) {
+        const QString &taskId = taskIds.at(i);
+        bool separator = i > 0;
+        QJsonObject task = m_printTaskInfo.value(taskId);
+        int copies = printCopies(task);
+        QString jobName = QString("Task_%1_%2").arg(taskId, task["className"].toString());
+        m_printJobTasks[jobName] = taskId;
+        
+        // 预检结果已缓存，printCollated 不再读取文件；提交失败时 printJobFailed 结束该任务
+        if (m_printManager->printCollated(deviceName, filePath, copies, jobName, separator)) {
+            updateTaskStatus(taskId, "打印中");
+            qDebug() << "Started print task" << taskId << "copies:" << copies;
+        } else {
+            qDebug() << "Failed to start print task" << taskId;
         }
     }
 }
@@ -5,11 +5,30 @@
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QMap>
+#include <QPair>
+#include <QSet>
 #include <QTimer>
+#include <QDateTime>
+#include "printmanager.h"
 
 class NetworkManager;
 class ScanManager;
-class PrintManager;
+class DeviceManager;
+
+// 打印调度单元：共享同一源文件的一组任务，只下载一次
+struct PrintGroup
+{
+    QString leadId;              // 下载ID（组内第一个任务）
+    QString sourceKey;           // 文件哈希或URL
+    QString fileUrl;
+    QString deviceName;          // 下发时选定的打印队列，组内任务都提交到这里
+    QStringList taskIds;
+    QDateTime deadline;          // 组内最早的考试开始时间
+    int estimatedSeconds = 0;    // 预计打印时长
+};
+
+// 打印队列中的一个任务：(打印队列, 任务ID)；任务ID只在同一队列内唯一
+typedef QPair<QString, int> PrintJobKey;
 
 class ExamManager : public QObject
 {
@@ -22,12 +41,14 @@ public:
     // 初始化
     void initialize(NetworkManager *networkManager, 
                    ScanManager *scanManager, 
-                   PrintManager *printManager);
+                   PrintManager *printManager,
+                   DeviceManager *deviceManager = nullptr);
 
     // 考试类型管理
     void refreshExamTypes();
     QStringList getExamTypes() const;
     void selectExamType(const QString &examType);
+    QString currentExamType() const { return m_currentExamType; }
 
     // 班级信息管理
     void refreshClassInfo(const QString &examType);
@@ -39,6 +60,14 @@ public:
     void startScanTask(const QString &examType, const QString &className, 
                       const QString &subject, int pageCount);
     void startPrintTask(const QString &taskId, const QString &filePath);
+    
+    // 流式打印：下载数据直接送入打印队列，不写临时文件
+    void setStreamPrinting(bool enable);
+    bool isStreamPrinting() const { return m_streamPrinting; }
+    
+    // 打印调度：按考试开始时间和预计打印时长安排下载与打印
+    void setPrinterThroughput(int pagesPerMinute);
+    void setMaxActivePrintGroups(int count);
 
 signals:
     void examTypesUpdated(const QStringList &examTypes);
@@ -46,24 +75,34 @@ signals:
     void scanTasksUpdated(const QJsonArray &tasks);
     void printTasksUpdated(const QJsonArray &tasks);
     void taskStatusChanged(const QString &taskId, const QString &status);
+    void deadlineAtRisk(const QString &taskId, const QDateTime &expectedFinish, const QDateTime &deadline);
 
 private slots:
     void onExamTypesReceived(const QJsonArray &examTypes);
     void onClassInfoReceived(const QString &examType, const QJsonArray &classes);
+    void onExamLayoutReceived(const QString &examType, const QJsonObject &layout);
+    void onExamScanSettingsReceived(const QString &examType, const QJsonObject &settings);
     void onScanTasksReceived(const QJsonArray &tasks);
     void onPrintTasksReceived(const QJsonArray &tasks);
     void onUploadCompleted(const QString &taskId, bool success);
     void onBatchScanCompleted(const QStringList &filePaths);
     void onDownloadCompleted(const QString &taskId, const QString &filePath, bool success);
+    void onPrintStreamFinished(const QString &taskId, bool success);
     void onPrintCompleted(const QString &deviceName, const QString &jobName, int jobId);
+    void onPrintJobSplit(const QString &deviceName, const QString &jobName, const QStringList &partNames);
+    void onPrintJobFinished(const QString &deviceName, int jobId);
+    void onPdfPreflighted(const QString &filePath, const PdfPreflight &preflight);
+    void onLeaseGranted(int leaseId, const QString &deviceName, const QString &kind);
     void onNetworkError(const QString &error);
     void onScanError(const QString &error);
-    void onPrintError(const QString &error);
+    void onPrintError(const QString &deviceName, const QString &error);
+    void onPrintJobFailed(const QString &deviceName, const QString &jobName, const QString &error);
 
 private:
     NetworkManager *m_networkManager;
     ScanManager *m_scanManager;
     PrintManager *m_printManager;
+    DeviceManager *m_deviceManager;
     
     // 数据存储
     QStringList m_examTypes;
@@ -74,6 +113,22 @@ private:
     // 当前状态
     QString m_currentExamType;
     QString m_currentScanTask;
+    bool m_streamPrinting;
+    QSet<QString> m_dispatchedPrintTasks;   // 已开始下载/打印的任务，避免重复处理
+    
+    // 合并打印与调度
+    QList<PrintGroup> m_pendingPrintGroups;         // 按优先级排序、尚未下发的组
+    QMap<QString, PrintGroup> m_activePrintGroups;  // 下载ID -> 已下发的组
+    QMap<QString, QString> m_taskGroups;            // 任务ID -> 下载ID
+    QMap<QString, QJsonObject> m_printTaskInfo;     // 任务ID -> 任务信息
+    QMap<QString, QString> m_printJobTasks;         // 提交时的打印任务名称 -> 任务ID（任务ID可能含下划线，不从名称解析）
+    QMap<QString, QString> m_preflightGroups;       // 等待预检的文件路径 -> 下载ID
+    QMap<PrintJobKey, QString> m_cupsJobs;          // 打印队列中的任务 -> 任务ID
+    QSet<PrintJobKey> m_heldJobs;                   // 为紧急任务让路而挂起的任务
+    QSet<QString> m_deadlineWarnings;               // 已发出预警的任务
+    QMap<QString, int> m_groupLeases;               // 下载ID -> 打印租约ID
+    int m_maxActivePrintGroups;
+    int m_printerPagesPerMinute;
     
     // 定时器
     QTimer *m_pollTimer;
@@ -82,6 +137,24 @@ private:
     void updateTaskStatus(const QString &taskId, const QString &status);
     void moveTaskFromScanToPrint(const QString &taskId);
     void checkPrintTaskStatus();
+    QString printSourceKey(const QJsonObject &task) const;
+    int printCopies(const QJsonObject &task) const;
+    void printCoalescedGroup(const QString &downloadId, const QString &filePath);
+    void submitCoalescedGroup(const QString &downloadId, const QString &filePath, const PdfPreflight &preflight);
+    bool hasOutstandingPrintJobs(const QString &taskId) const;
+    
+    // 调度辅助方法
+    QString printDevice() const;
+    QDateTime printDeadline(const QJsonObject &task) const;
+    int estimatePrintSeconds(const QJsonObject &task) const;
+    void schedulePrintWork();
+    void startPrintGroup(const PrintGroup &group);
+    void runPrintGroup(const QString &leadId);
+    void preemptForUrgentGroup();
+    int runningPrintGroupCount() const;
+    void releaseHeldJobs();
+    void checkPrintDeadlines();
+    void finishPrintTask(const QString &taskId, const QString &status, bool retry = false);
 };
 
 #endif // EXAMMANAGER_H 
\ No newline at end of file
@@ -0,0 +1,646 @@
+#include "ippclient.h"
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+const int JobPollInterval = 2000;      // 任务状态查询间隔
+const int RequestTimeout = 15000;      // 属性查询、任务操作的期限
+const int TransferTimeout = 60000;     // 提交文档时上传/响应没有任何进展的期限
+
+// 常用纸张名称转换为 PWG 自描述名称
+QString pwgMediaName(const QString &media)
+{
+    if (media.compare("A4", Qt::CaseInsensitive) == 0) return "iso_a4_210x297mm";
+    if (media.compare("A3", Qt::CaseInsensitive) == 0) return "iso_a3_297x420mm";
+    if (media.compare("Letter", Qt::CaseInsensitive) == 0) return "na_letter_8.5x11in";
+    return media;
+}
+
+// 请求体：IPP 属性编码之后接文档文件，上传时按需读取文件，不把整个文档放进内存
+class IppBodyDevice : public QIODevice
+{
+public:
+    IppBodyDevice(const QByteArray &header, const QString &filePath, QObject *parent)
+        : QIODevice(parent), m_header(header), m_headerPos(0), m_file(filePath)
+    {
+    }
+    
+    bool open()
+    {
+        return m_file.open(QIODevice::ReadOnly) && QIODevice::open(QIODevice::ReadOnly);
+    }
+    
+    qint64 totalSize() const
+    {
+        return m_header.size() + m_file.size();
+    }
+    
+    bool isSequential() const override
+    {
+        return true;
+    }
+    
+    qint64 bytesAvailable() const override
+    {
+        return (m_header.size() - m_headerPos) + m_file.bytesAvailable() + QIODevice::bytesAvailable();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        qint64 copied = qMin<qint64>(maxSize, m_header.size() - m_headerPos);
+        if (copied > 0) {
+            memcpy(data, m_header.constData() + m_headerPos, size_t(copied));
+            m_headerPos += copied;
+        }
+        if (copied < maxSize) {
+            qint64 read = m_file.read(data + copied, maxSize - copied);
+            if (read < 0) {
+                return copied > 0 ? copied : -1;
+            }
+            copied += read;
+        }
+        return copied;
+    }
+    
+    qint64 writeData(const char *, qint64) override
+    {
+        return -1;
+    }
+
+private:
+    QByteArray m_header;
+    qint64 m_headerPos;
+    QFile m_file;
+};
+}
+
+// ===== IppRequest =====
+
+IppRequest::IppRequest(quint16 operation, quint32 requestId)
+{
+    // 版本 2.0，操作码，请求ID
+    m_data.append(char(0x02)).append(char(0x00));
+    m_data.append(char(operation >> 8)).append(char(operation & 0xFF));
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        m_data.append(char((requestId >> shift) & 0xFF));
+    }
+}
+
+void IppRequest::beginGroup(quint8 groupTag)
+{
+    m_data.append(char(groupTag));
+}
+
+void IppRequest::addValue(quint8 valueTag, const QString &name, const QByteArray &value)
+{
+    // 名称为空表示上一个属性的附加值（1setOf）
+    QByteArray nameBytes = name.toUtf8();
+    m_data.append(char(valueTag));
+    m_data.append(char(nameBytes.size() >> 8)).append(char(nameBytes.size() & 0xFF));
+    m_data.append(nameBytes);
+    m_data.append(char(value.size() >> 8)).append(char(value.size() & 0xFF));
+    m_data.append(value);
+}
+
+void IppRequest::addString(quint8 valueTag, const QString &name, const QString &value)
+{
+    addValue(valueTag, name, value.toUtf8());
+}
+
+void IppRequest::addInteger(quint8 valueTag, const QString &name, int value)
+{
+    QByteArray bytes(4, 0);
+    qToBigEndian<qint32>(value, reinterpret_cast<uchar*>(bytes.data()));
+    addValue(valueTag, name, bytes);
+}
+
+void IppRequest::addBoolean(const QString &name, bool value)
+{
+    addValue(IppClient::BooleanTag, name, QByteArray(1, value ? 1 : 0));
+}
+
+void IppRequest::addRange(const QString &name, int lower, int upper)
+{
+    QByteArray bytes(8, 0);
+    qToBigEndian<qint32>(lower, reinterpret_cast<uchar*>(bytes.data()));
+    qToBigEndian<qint32>(upper, reinterpret_cast<uchar*>(bytes.data() + 4));
+    addValue(IppClient::RangeTag, name, bytes);
+}
+
+void IppRequest::addResolution(const QString &name, int x, int y)
+{
+    QByteArray bytes(9, 0);
+    qToBigEndian<qint32>(x, reinterpret_cast<uchar*>(bytes.data()));
+    qToBigEndian<qint32>(y, reinterpret_cast<uchar*>(bytes.data() + 4));
+    bytes[8] = 3;   // dots per inch
+    addValue(IppClient::ResolutionTag, name, bytes);
+}
+
+QByteArray IppRequest::encode() const
+{
+    return m_data + QByteArray(1, char(IppClient::EndOfAttributes));
+}
+
+// ===== IppClient =====
+
+IppClient::IppClient(const QUrl &printerUri, QObject *parent)
+    : QObject(parent),
+      m_network(new QNetworkAccessManager(this)),
+      m_printerUri(printerUri),
+      m_userName("aireview"),
+      m_nextRequestId(1),
+      m_nextSubmissionId(1),
+      m_attributesLoaded(false),
+      m_attributesPending(false),
+      m_pollTimer(new QTimer(this))
+{
+    // ipp://host/path 通过 HTTP 发送到 631 端口，ipps 使用 HTTPS
+    m_httpUrl = printerUri;
+    m_httpUrl.setScheme(printerUri.scheme() == "ipps" ? "https" : "http");
+    if (m_httpUrl.port() < 0) {
+        m_httpUrl.setPort(631);
+    }
+    
+    m_pollTimer->setInterval(JobPollInterval);
+    connect(m_pollTimer, &QTimer::timeout, this, &IppClient::pollJobs);
+}
+
+IppClient::~IppClient()
+{
+}
+
+QByteArray IppClient::rawDeflate(const QByteArray &data)
+{
+    // qCompress 输出为 4字节长度 + zlib流（2字节头 + deflate数据 + 4字节adler32），
+    // IPP 的 deflate 压缩只需要中间的原始 deflate 数据
+    QByteArray compressed = qCompress(data, 6);
+    if (compressed.size() < 10) {
+        return QByteArray();
+    }
+    return compressed.mid(6, compressed.size() - 10);
+}
+
+IppResponse IppClient::decode(const QByteArray &data)
+{
+    IppResponse response;
+    if (data.size() < 9) {
+        return response;
+    }
+    
+    const uchar *bytes = reinterpret_cast<const uchar*>(data.constData());
+    response.status = qFromBigEndian<quint16>(bytes + 2);
+    
+    int pos = 8;
+    QString lastName;
+    while (pos < data.size()) {
+        quint8 tag = bytes[pos++];
+        if (tag == EndOfAttributes) {
+            response.valid = true;
+            break;
+        }
+        if (tag < 0x10) {
+            continue;   // 属性组分隔符
+        }
+        
+        if (pos + 2 > data.size()) break;
+        int nameLength = qFromBigEndian<quint16>(bytes + pos);
+        pos += 2;
+        if (pos + nameLength + 2 > data.size()) break;
+        QString name = QString::fromUtf8(data.constData() + pos, nameLength);
+        pos += nameLength;
+        int valueLength = qFromBigEndian<quint16>(bytes + pos);
+        pos += 2;
+        if (pos + valueLength > data.size()) break;
+        
+        const uchar *value = bytes + pos;
+        QVariant decoded;
+        if ((tag == IntegerTag || tag == EnumTag) && valueLength == 4) {
+            decoded = qFromBigEndian<qint32>(value);
+        } else if (tag == BooleanTag && valueLength == 1) {
+            decoded = value[0] != 0;
+        } else if (tag == RangeTag && valueLength == 8) {
+            decoded = QString("%1-%2").arg(qFromBigEndian<qint32>(value)).arg(qFromBigEndian<qint32>(value + 4));
+        } else if (tag == ResolutionTag && valueLength == 9) {
+            decoded = QString("%1x%2").arg(qFromBigEndian<qint32>(value)).arg(qFromBigEndian<qint32>(value + 4));
+        } else if (tag >= 0x40 && tag <= 0x5F) {
+            decoded = QString::fromUtf8(data.constData() + pos, valueLength);
+        } else {
+            decoded = data.mid(pos, valueLength);
+        }
+        pos += valueLength;
+        
+        // 名称为空的是上一个属性的附加值
+        if (!name.isEmpty()) {
+            lastName = name;
+        }
+        if (!lastName.isEmpty()) {
+            response.attributes[lastName].append(decoded);
+        }
+    }
+    
+    return response;
+}
+
+int IppClient::submitJob(const QString &jobName, const QByteArray &document, const IppJobOptions &options)
+{
+    Submission submission;
+    submission.id = m_nextSubmissionId++;
+    submission.jobName = jobName;
+    submission.document = document;
+    submission.options = options;
+    
+    // 首次提交前查询打印机支持的压缩方式和操作
+    if (!m_attributesLoaded) {
+        m_waitingSubmissions.append(submission);
+        queryPrinter();
+    } else {
+        sendSubmission(submission);
+    }
+    return submission.id;
+}
+
+int IppClient::submitJobFile(const QString &jobName, const QString &filePath, const IppJobOptions &options)
+{
+    Submission submission;
+    submission.id = m_nextSubmissionId++;
+    submission.jobName = jobName;
+    submission.documentPath = filePath;
+    submission.options = options;
+    
+    if (!m_attributesLoaded) {
+        m_waitingSubmissions.append(submission);
+        queryPrinter();
+    } else {
+        sendSubmission(submission);
+    }
+    return submission.id;
+}
+
+void IppClient::cancelJob(int jobId)
+{
+    sendJobOperation(CancelJob, jobId);
+}
+
+void IppClient::holdJob(int jobId)
+{
+    sendJobOperation(HoldJob, jobId);
+}
+
+void IppClient::releaseJob(int jobId)
+{
+    sendJobOperation(ReleaseJob, jobId);
+}
+
+QMap<int, QString> IppClient::activeJobs() const
+{
+    QMap<int, QString> jobs;
+    for (auto it = m_jobStates.constBegin(); it != m_jobStates.constEnd(); ++it) {
+        jobs.insert(it.key(), stateName(it.value()));
+    }
+    return jobs;
+}
+
+QNetworkReply *IppClient::post(const QByteArray &body)
+{
+    QNetworkRequest request(m_httpUrl);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/ipp");
+    return m_network->post(request, body);
+}
+
+void IppClient::armTimeout(QNetworkReply *reply, int timeoutMs, const QString &request)
+{
+    // 计时器随请求一起释放；有数据收发时重新计时，打印机无响应时中止请求，finished 中按超时处理
+    QTimer *timer = new QTimer(reply);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, [this, reply, request]() {
+        reply->setProperty("timedOut", true);
+        emit requestTimedOut(request);
+        reply->abort();
+    });
+    connect(reply, &QNetworkReply::uploadProgress, timer, [timer]() { timer->start(); });
+    connect(reply, &QNetworkReply::downloadProgress, timer, [timer]() { timer->start(); });
+    timer->start(timeoutMs);
+}
+
+QString IppClient::replyError(QNetworkReply *reply, const QString &request) const
+{
+    if (reply->property("timedOut").toBool()) {
+        return request + " timed out";
+    }
+    return reply->errorString();
+}
+
+QNetworkReply *IppClient::postDocument(const QByteArray &header, const Submission &submission, bool deflate)
+{
+    if (submission.documentPath.isEmpty()) {
+        return post(header + (deflate ? rawDeflate(submission.document) : submission.document));
+    }
+    
+    // 文件文档：按长度流式上传，Qt 不再缓存整个请求体
+    IppBodyDevice *body = new IppBodyDevice(header, submission.documentPath, this);
+    if (!body->open()) {
+        delete body;
+        return nullptr;
+    }
+    QNetworkRequest request(m_httpUrl);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/ipp");
+    request.setHeader(QNetworkRequest::ContentLengthHeader, body->totalSize());
+    request.setAttribute(QNetworkRequest::DoNotBufferUploadDataAttribute, true);
+    QNetworkReply *reply = m_network->post(request, body);
+    body->setParent(reply);
+    return reply;
+}
+
+void IppClient::addOperationAttributes(IppRequest *request) const
+{
+    request->beginGroup(OperationGroup);
+    request->addString(CharsetTag, "attributes-charset", "utf-8");
+    request->addString(LanguageTag, "attributes-natural-language", "en");
+    request->addString(UriTag, "printer-uri", m_printerUri.toString());
+    request->addString(NameTag, "requesting-user-name", m_userName);
+}
+
+void IppClient::addJobAttributes(IppRequest *request, const IppJobOptions &options) const
+{
+    request->beginGroup(JobGroup);
+    if (options.copies > 1) {
+        request->addInteger(IntegerTag, "copies", options.copies);
+    }
+    if (!options.media.isEmpty()) {
+        request->addString(KeywordTag, "media", pwgMediaName(options.media));
+    }
+    if (!options.sides.isEmpty()) {
+        request->addString(KeywordTag, "sides", options.sides);
+    }
+    if (options.printQuality > 0) {
+        request->addInteger(EnumTag, "print-quality", options.printQuality);
+    }
+    if (options.resolution > 0) {
+        request->addResolution("printer-resolution", options.resolution, options.resolution);
+    }
+    if (options.firstPage > 0) {
+        request->addRange("page-ranges", options.firstPage, qMax(options.firstPage, options.lastPage));
+    }
+    if (options.collate) {
+        request->addString(KeywordTag, "multiple-document-handling", "separate-documents-collated-copies");
+    }
+    if (!options.jobSheets.isEmpty()) {
+        request->addString(KeywordTag, "job-sheets", options.jobSheets);
+    }
+    if (!options.printScaling.isEmpty()) {
+        request->addString(KeywordTag, "print-scaling", options.printScaling);
+    }
+}
+
+void IppClient::queryPrinter()
+{
+    if (m_attributesPending) return;
+    m_attributesPending = true;
+    
+    IppRequest request(GetPrinterAttributes, m_nextRequestId++);
+    addOperationAttributes(&request);
+    request.addString(KeywordTag, "requested-attributes", "compression-supported");
+    request.addString(KeywordTag, "", "operations-supported");
+    
+    QNetworkReply *reply = post(request.encode());
+    armTimeout(reply, RequestTimeout, "Get-Printer-Attributes");
+    connect(reply, &QNetworkReply::finished, this, &IppClient::onPrinterAttributes);
+}
+
+void IppClient::onPrinterAttributes()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+    reply->deleteLater();
+    m_attributesPending = false;
+    
+    IppResponse response = decode(reply->readAll());
+    if (response.isSuccess()) {
+        for (const QVariant &value : response.attributes.value("compression-supported")) {
+            m_compressionSupported << value.toString();
+        }
+        for (const QVariant &value : response.attributes.value("operations-supported")) {
+            m_operationsSupported << value.toInt();
+        }
+        qDebug() << "IPP 打印机属性:" << m_printerUri << "压缩:" << m_compressionSupported;
+    } else {
+        qDebug() << "IPP 打印机属性查询失败:" << m_printerUri << replyError(reply, "Get-Printer-Attributes");
+    }
+    
+    // 查询失败时按最基本的 Print-Job、不压缩提交
+    m_attributesLoaded = true;
+    QList<Submission> waiting = m_waitingSubmissions;
+    m_waitingSubmissions.clear();
+    for (const Submission &submission : waiting) {
+        sendSubmission(submission);
+    }
+}
+
+void IppClient::sendSubmission(const Submission &submission)
+{
+    // 打印机不支持 Print-Job 时使用 Create-Job + Send-Document
+    bool useCreateJob = !m_operationsSupported.isEmpty() && !m_operationsSupported.contains(PrintJob)
+                        && m_operationsSupported.contains(CreateJob);
+    
+    if (useCreateJob) {
+        IppRequest request(CreateJob, m_nextRequestId++);
+        addOperationAttributes(&request);
+        request.addString(NameTag, "job-name", submission.jobName);
+        addJobAttributes(&request, submission.options);
+        
+        QNetworkReply *reply = post(request.encode());
+        armTimeout(reply, RequestTimeout, "Create-Job");
+        reply->setProperty("operation", int(CreateJob));
+        m_submitReplies.insert(reply, submission);
+        connect(reply, &QNetworkReply::finished, this, &IppClient::onSubmitFinished);
+        return;
+    }
+    
+    // 压缩需要完整的文档，从文件流式发送时不压缩
+    bool deflate = m_compressionSupported.contains("deflate") && submission.documentPath.isEmpty();
+    IppRequest request(PrintJob, m_nextRequestId++);
+    addOperationAttributes(&request);
+    request.addString(NameTag, "job-name", submission.jobName);
+    if (deflate) {
+        request.addString(KeywordTag, "compression", "deflate");
+    }
+    request.addString(MimeTypeTag, "document-format", submission.options.documentFormat);
+    addJobAttributes(&request, submission.options);
+    
+    QNetworkReply *reply = postDocument(request.encode(), submission, deflate);
+    if (!reply) {
+        failSubmission(submission.id, "Cannot read print file: " + submission.documentPath);
+        return;
+    }
+    armTimeout(reply, TransferTimeout, "Print-Job");
+    reply->setProperty("operation", int(PrintJob));
+    m_submitReplies.insert(reply, submission);
+    connect(reply, &QNetworkReply::finished, this, &IppClient::onSubmitFinished);
+}
+
+void IppClient::sendDocument(const Submission &submission)
+{
+    bool deflate = m_compressionSupported.contains("deflate") && submission.documentPath.isEmpty();
+    IppRequest request(SendDocument, m_nextRequestId++);
+    addOperationAttributes(&request);
+    request.addInteger(IntegerTag, "job-id", submission.jobId);
+    if (deflate) {
+        request.addString(KeywordTag, "compression", "deflate");
+    }
+    request.addString(MimeTypeTag, "document-format", submission.options.documentFormat);
+    request.addBoolean("last-document", true);
+    
+    QNetworkReply *reply = postDocument(request.encode(), submission, deflate);
+    if (!reply) {
+        // 已创建的任务不会再收到文档，取消它
+        sendJobOperation(CancelJob, submission.jobId);
+        failSubmission(submission.id, "Cannot read print file: " + submission.documentPath);
+        return;
+    }
+    armTimeout(reply, TransferTimeout, "Send-Document");
+    reply->setProperty("operation", int(SendDocument));
+    m_submitReplies.insert(reply, submission);
+    connect(reply, &QNetworkReply::finished, this, &IppClient::onSubmitFinished);
+}
+
+void IppClient::onSubmitFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || !m_submitReplies.contains(reply)) return;
+    reply->deleteLater();
+    
+    Submission submission = m_submitReplies.take(reply);
+    int operation = reply->property("operation").toInt();
+    IppResponse response = decode(reply->readAll());
+    
+    if (!response.isSuccess()) {
+        // 超时同样按失败上报；Send-Document 失败时已创建的任务不会再收到文档，取消它
+        QString error = response.valid ? QString("IPP status 0x%1").arg(response.status, 4, 16, QChar('0'))
+                                       : replyError(reply, operation == CreateJob ? "Create-Job"
+                                                           : operation == SendDocument ? "Send-Document" : "Print-Job");
+        if (operation == SendDocument && submission.jobId > 0) {
+            sendJobOperation(CancelJob, submission.jobId);
+        }
+        emit jobFailed(submission.id, error);
+        return;
+    }
+    
+    int jobId = response.value("job-id").toInt();
+    if (operation == CreateJob) {
+        submission.jobId = jobId;
+        sendDocument(submission);
+        return;
+    }
+    
+    // 文档已交给打印机，之后在同一连接上查询任务状态
+    int state = response.attributes.contains("job-state") ? response.value("job-state").toInt() : Pending;
+    if (jobId > 0) {
+        m_jobStates[jobId] = state;
+        if (!m_pollTimer->isActive()) {
+            m_pollTimer->start();
+        }
+    }
+    emit jobSubmitted(submission.id, jobId);
+}
+
+void IppClient::failSubmission(int submissionId, const QString &error)
+{
+    // 提交调用中同步失败时，调用方还没有记录提交编号，延后通知
+    QTimer::singleShot(0, this, [this, submissionId, error]() {
+        emit jobFailed(submissionId, error);
+    });
+}
+
+void IppClient::sendJobOperation(quint16 operation, int jobId)
+{
+    IppRequest request(operation, m_nextRequestId++);
+    addOperationAttributes(&request);
+    request.addInteger(IntegerTag, "job-id", jobId);
+    
+    QNetworkReply *reply = post(request.encode());
+    armTimeout(reply, RequestTimeout, QString("operation 0x%1").arg(operation, 4, 16, QChar('0')));
+    connect(reply, &QNetworkReply::finished, reply, &QObject::deleteLater);
+}
+
+void IppClient::pollJobs()
+{
+    if (m_jobStates.isEmpty()) {
+        m_pollTimer->stop();
+        return;
+    }
+    
+    for (int jobId : m_jobStates.keys()) {
+        // 上一次查询还没有返回（打印机响应慢）时跳过，不堆积请求
+        if (m_pollingJobs.contains(jobId)) {
+            continue;
+        }
+        m_pollingJobs.insert(jobId);
+        
+        IppRequest request(GetJobAttributes, m_nextRequestId++);
+        addOperationAttributes(&request);
+        request.addInteger(IntegerTag, "job-id", jobId);
+        request.addString(KeywordTag, "requested-attributes", "job-state");
+        request.addString(KeywordTag, "", "job-state-reasons");
+        
+        QNetworkReply *reply = post(request.encode());
+        armTimeout(reply, RequestTimeout, "Get-Job-Attributes");
+        reply->setProperty("jobId", jobId);
+        connect(reply, &QNetworkReply::finished, this, &IppClient::onJobAttributes);
+    }
+}
+
+void IppClient::onJobAttributes()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+    reply->deleteLater();
+    
+    int jobId = reply->property("jobId").toInt();
+    m_pollingJobs.remove(jobId);
+    if (!m_jobStates.contains(jobId)) return;
+    
+    IppResponse response = decode(reply->readAll());
+    if (!response.isSuccess()) {
+        // 打印机已不认识该任务（如重启后），视为已结束
+        if (response.valid && response.status == 0x0406) {
+            m_jobStates.remove(jobId);
+            emit jobFinished(jobId, Completed);
+        }
+        return;
+    }
+    
+    int state = response.value("job-state").toInt();
+    QStringList reasons;
+    for (const QVariant &value : response.attributes.value("job-state-reasons")) {
+        reasons << value.toString();
+    }
+    
+    if (state != m_jobStates.value(jobId)) {
+        m_jobStates[jobId] = state;
+        emit jobStateChanged(jobId, state, reasons);
+    }
+    
+    if (state >= Canceled) {
+        m_jobStates.remove(jobId);
+        qDebug() << "IPP 任务结束:" << jobId << stateName(state) << reasons;
+        emit jobFinished(jobId, state);
+    }
+}
+
+QString IppClient::stateName(int state)
+{
+    switch (state) {
+        case Pending: return "pending";
+        case Held: return "held";
+        case Processing: return "processing";
+        case Stopped: return "stopped";
+        case Canceled: return "canceled";
+        case Aborted: return "aborted";
+        case Completed: return "completed";
+        default: return "unknown";
+    }
+}
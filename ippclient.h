@@ -0,0 +1,165 @@
+#ifndef IPPCLIENT_H
+#define IPPCLIENT_H
+
+#include <QObject>
+#include <QUrl>
+#include <QMap>
+#include <QSet>
+#include <QList>
+#include <QVariant>
+#include <QStringList>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+class QTimer;
+
+// IPP 请求编码（RFC 8010），按属性组依次追加
+class IppRequest
+{
+public:
+    IppRequest(quint16 operation, quint32 requestId);
+    
+    void beginGroup(quint8 groupTag);
+    void addString(quint8 valueTag, const QString &name, const QString &value);
+    void addInteger(quint8 valueTag, const QString &name, int value);
+    void addBoolean(const QString &name, bool value);
+    void addRange(const QString &name, int lower, int upper);
+    void addResolution(const QString &name, int x, int y);
+    QByteArray encode() const;
+
+private:
+    QByteArray m_data;
+    void addValue(quint8 valueTag, const QString &name, const QByteArray &value);
+};
+
+// IPP 响应解码结果：属性名 -> 取值（多值属性有多个）
+struct IppResponse
+{
+    bool valid = false;
+    quint16 status = 0xFFFF;   // 0x0000-0x00FF 为成功
+    QMap<QString, QVariantList> attributes;
+    
+    bool isSuccess() const { return valid && status < 0x0100; }
+    QVariant value(const QString &name) const { return attributes.value(name).value(0); }
+};
+
+// 打印任务属性
+struct IppJobOptions
+{
+    int copies = 1;
+    QString media;              // 如 iso_a4_210x297mm 或 A4
+    QString sides;
+    int printQuality = 0;       // 3/4/5，0 表示不指定
+    int resolution = 0;         // dpi，0 表示不指定
+    int firstPage = 0;          // 页面范围，0 表示全部
+    int lastPage = 0;
+    bool collate = false;
+    QString jobSheets;
+    QString printScaling;
+    QString documentFormat = "application/pdf";
+};
+
+// IPP Everywhere 客户端：不经过CUPS直接向打印机提交任务并跟踪任务状态
+class IppClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    // IPP 常量
+    enum Operation {
+        PrintJob = 0x0002,
+        CreateJob = 0x0005,
+        SendDocument = 0x0006,
+        CancelJob = 0x0008,
+        GetJobAttributes = 0x0009,
+        GetPrinterAttributes = 0x000B,
+        HoldJob = 0x000C,
+        ReleaseJob = 0x000D
+    };
+    enum Tag {
+        OperationGroup = 0x01, JobGroup = 0x02, EndOfAttributes = 0x03,
+        IntegerTag = 0x21, BooleanTag = 0x22, EnumTag = 0x23,
+        ResolutionTag = 0x32, RangeTag = 0x33,
+        TextTag = 0x41, NameTag = 0x42, KeywordTag = 0x44, UriTag = 0x45,
+        CharsetTag = 0x47, LanguageTag = 0x48, MimeTypeTag = 0x49
+    };
+    enum JobState { Pending = 3, Held = 4, Processing = 5, Stopped = 6, Canceled = 7, Aborted = 8, Completed = 9 };
+
+    explicit IppClient(const QUrl &printerUri, QObject *parent = nullptr);
+    ~IppClient();
+
+    QUrl printerUri() const { return m_printerUri; }
+    void setUserName(const QString &userName) { m_userName = userName; }
+    
+    // 提交文档，返回本地提交编号；结果通过 jobSubmitted / jobFailed 通知
+    int submitJob(const QString &jobName, const QByteArray &document, const IppJobOptions &options);
+    // 从文件提交：发送时边读边发，文档不载入内存（不压缩）；文件在 jobSubmitted / jobFailed 之前须保留
+    int submitJobFile(const QString &jobName, const QString &filePath, const IppJobOptions &options);
+    void cancelJob(int jobId);
+    void holdJob(int jobId);
+    void releaseJob(int jobId);
+    
+    // 尚未结束的任务：任务ID -> 状态
+    QMap<int, QString> activeJobs() const;
+    
+    static IppResponse decode(const QByteArray &data);
+    static QByteArray rawDeflate(const QByteArray &data);
+
+signals:
+    void jobSubmitted(int submissionId, int jobId);
+    void jobFailed(int submissionId, const QString &error);
+    void jobStateChanged(int jobId, int state, const QStringList &reasons);
+    void jobFinished(int jobId, int state);
+    void requestTimedOut(const QString &request);   // Print-Job / Get-Job-Attributes 等
+
+private slots:
+    void onPrinterAttributes();
+    void onSubmitFinished();
+    void onJobAttributes();
+    void pollJobs();
+
+private:
+    struct Submission
+    {
+        int id = 0;
+        QString jobName;
+        QByteArray document;
+        QString documentPath;   // 非空时从文件读取文档
+        IppJobOptions options;
+        int jobId = 0;          // Create-Job 之后发送文档时使用
+    };
+    
+    QNetworkAccessManager *m_network;   // 同一个连接上提交任务和查询状态
+    QUrl m_printerUri;
+    QUrl m_httpUrl;
+    QString m_userName;
+    quint32 m_nextRequestId;
+    int m_nextSubmissionId;
+    
+    // 打印机属性（首次提交前查询一次）
+    bool m_attributesLoaded;
+    bool m_attributesPending;
+    QStringList m_compressionSupported;
+    QList<int> m_operationsSupported;
+    QList<Submission> m_waitingSubmissions;
+    
+    QMap<QNetworkReply*, Submission> m_submitReplies;
+    QMap<int, int> m_jobStates;          // 任务ID -> 最近的状态
+    QSet<int> m_pollingJobs;             // 状态查询尚未返回的任务，不重复查询
+    QTimer *m_pollTimer;
+    
+    void queryPrinter();
+    void sendSubmission(const Submission &submission);
+    void sendDocument(const Submission &submission);
+    void sendJobOperation(quint16 operation, int jobId);
+    void failSubmission(int submissionId, const QString &error);
+    void addOperationAttributes(IppRequest *request) const;
+    void addJobAttributes(IppRequest *request, const IppJobOptions &options) const;
+    QNetworkReply *post(const QByteArray &body);
+    void armTimeout(QNetworkReply *reply, int timeoutMs, const QString &request);
+    QString replyError(QNetworkReply *reply, const QString &request) const;
+    QNetworkReply *postDocument(const QByteArray &header, const Submission &submission, bool deflate);
+    static QString stateName(int state);
+};
+
+#endif // IPPCLIENT_H
@@ -19,9 +19,10 @@ MainWindow::MainWindow(QWidget *parent) :
     m_refreshTimer(new QTimer(this))
 {
     ui->setupUi(this);
+    m_previewBrowser = new PreviewBrowser(ui->graphicsView, this);
     
     // 初始化管理器
-    m_examManager->initialize(m_networkManager, m_scanManager, m_printManager);
+    m_examManager->initialize(m_networkManager, m_scanManager, m_printManager, m_deviceManager);
     
     // 设置连接
     setupConnections();
@@ -178,11 +179,18 @@ void MainWindow::setupConnections()
             this, &MainWindow::onDeviceStatusChanged);
     connect(m_deviceManager, &DeviceManager::deviceError,
             this, &MainWindow::onDeviceError);
+    connect(m_deviceManager, &DeviceManager::leaseGranted,
+            this, &MainWindow::onDeviceLeaseGranted);
+    connect(m_deviceManager, &DeviceManager::scannerAdfLoaded,
+            this, &MainWindow::onScannerAdfLoaded);
+    connect(m_examManager, &ExamManager::scanTasksUpdated,
+            this, &MainWindow::onScanTasksUpdated);
     
     // 扫描相关 - 使用设备名称
     connect(m_scanManager, &ScanManager::scanStarted,
             [this](const QString &deviceName) {
                 qDebug() << "扫描开始，设备:" << deviceName;
+                m_deviceManager->setDeviceActive(deviceName, true);
             });
     connect(m_scanManager, &ScanManager::scanProgress,
             [this](const QString &deviceName, int current, int total) {
@@ -191,11 +199,67 @@ void MainWindow::setupConnections()
     connect(m_scanManager, &ScanManager::scanCompleted,
             [this](const QString &deviceName, const QString &filePath) {
                 qDebug() << "扫描完成，设备:" << deviceName << "文件:" << filePath;
-                // 自动上传扫描文件
-                m_scanManager->uploadFile(deviceName, filePath, "/exam/");
+                // 自动上传扫描文件（启用后处理时等处理完成再上传）
+                if (!m_scanManager->hasPostProcessing(deviceName)) {
+                    m_previewBrowser->addPage(filePath);
+                    m_scanManager->uploadFile(deviceName, filePath, "/exam/");
+                }
+            });
+    connect(m_scanManager, &ScanManager::pageProcessed,
+            [this](const QString &deviceName, const PageResult &result) {
+                if (result.blank) {
+                    qDebug() << "检测到空白页，设备:" << deviceName << "文件:" << result.outputPath;
+                }
+                // 处理失败时上传原始扫描文件；提取了答题区域时只上传拼图和清单（含客观题答案），整页留在本地
+                QString pagePath = result.ok ? result.outputPath : result.sourcePath;
+                m_previewBrowser->addPage(pagePath);
+                if (!result.manifestPath.isEmpty()) {
+                    QStringList files;
+                    if (!result.regionPath.isEmpty()) {
+                        files << result.regionPath;
+                    }
+                    m_scanManager->uploadFiles(deviceName, files << result.manifestPath, "/exam/");
+                } else {
+                    m_scanManager->uploadFile(deviceName, pagePath, "/exam/");
+                }
+            });
+    connect(m_scanManager, &ScanManager::batchScanCompleted,
+            [this](const QString &deviceName, const QStringList &filePaths) {
+                Q_UNUSED(filePaths);
+                m_deviceManager->setDeviceActive(deviceName, false);
+                releaseScanLease(deviceName);
+                finishScanTask(deviceName, false);
+                updateFeederWatches();
+            });
+    connect(m_scanManager, &ScanManager::batchScanInterrupted,
+            [this](const QString &deviceName, ScanManager::ScanError error, int completedPages, int totalPages) {
+                // 已完成的页面保留，排除故障后重新放入剩余的纸张即可继续
+                QString hint;
+                switch (error) {
+                    case ScanManager::ScanJammed: hint = "进纸器卡纸，请取出卡住的纸张"; break;
+                    case ScanManager::ScanNoDocuments: hint = "进纸器无纸"; break;
+                    case ScanManager::ScanCoverOpen: hint = "扫描仪盖板打开，请合上"; break;
+                    default: hint = "扫描中断"; break;
+                }
+                qDebug() << hint << "设备:" << deviceName << "已完成:" << completedPages << "/" << totalPages
+                         << "从第" << (completedPages + 1) << "页继续";
+                // 断点保留，任务不变；续扫时重新申请租约
+                m_deviceManager->setDeviceActive(deviceName, false);
+                releaseScanLease(deviceName);
+                updateFeederWatches();
+            });
+    connect(m_scanManager, &ScanManager::batchScanFailed,
+            [this](const QString &deviceName, const QString &error) {
+                // 不可续扫的故障：批次已结束，任务重新排队
+                qDebug() << "批量扫描失败，设备:" << deviceName << "错误:" << error;
+                m_deviceManager->setDeviceActive(deviceName, false);
+                releaseScanLease(deviceName);
+                finishScanTask(deviceName, true);
+                updateFeederWatches();
             });
     connect(m_scanManager, &ScanManager::scanError,
             [this](const QString &deviceName, const QString &error) {
+                // 单页写入失败等错误不一定结束批次，租约在批次完成、中断或失败时释放
                 qDebug() << "扫描错误，设备:" << deviceName << "错误:" << error;
             });
     
@@ -203,14 +267,34 @@ void MainWindow::setupConnections()
     connect(m_printManager, &PrintManager::printStarted,
             [this](const QString &deviceName, const QString &jobName) {
                 qDebug() << "打印开始，设备:" << deviceName << "任务:" << jobName;
+                m_deviceManager->setDeviceActive(deviceName, true);
             });
     connect(m_printManager, &PrintManager::printCompleted,
             [this](const QString &deviceName, const QString &jobName, int jobId) {
                 qDebug() << "打印完成，设备:" << deviceName << "任务:" << jobName << "ID:" << jobId;
+                releasePrintLease(jobName);
+            });
+    connect(m_printManager, &PrintManager::printJobFinished,
+            [this](const QString &deviceName, int jobId) {
+                // 提交后设备仍在出纸，队列中本程序的任务全部完成后才不再视为使用中
+                qDebug() << "打印任务结束，设备:" << deviceName << "ID:" << jobId;
+                if (!m_printManager->hasOutstandingJobs(deviceName)) {
+                    m_deviceManager->setDeviceActive(deviceName, false);
+                }
             });
     connect(m_printManager, &PrintManager::printError,
             [this](const QString &deviceName, const QString &error) {
                 qDebug() << "打印错误，设备:" << deviceName << "错误:" << error;
+                if (!m_printManager->hasOutstandingJobs(deviceName)) {
+                    m_deviceManager->setDeviceActive(deviceName, false);
+                }
+            });
+    connect(m_printManager, &PrintManager::printJobFailed,
+            [this](const QString &deviceName, const QString &jobName, const QString &error) {
+                // 只释放这次提交的租约；查询队列失败等与提交无关的错误不影响租约
+                Q_UNUSED(deviceName);
+                Q_UNUSED(error);
+                releasePrintLease(jobName);
             });
     
     // 上传相关
@@ -304,6 +388,23 @@ void MainWindow::onFormScanButtonClicked(const QString &taskId, const QString &c
     }
     
     if (!currentDevice.isEmpty()) {
+        // 设备上有中断的批次时先续扫它（不依赖 eSCL 进纸器事件，SANE 扫描仪也由此续扫），
+        // 点击的任务留在队列中
+        if (m_scanManager->hasBatchCheckpoint(currentDevice)) {
+            requestScanResume(currentDevice);
+            return;
+        }
+        
+        // 手动开始的任务不再等待放纸触发
+        m_startedScanTasks.insert(taskId);
+        for (int i = 0; i < m_queuedScanTasks.size(); ++i) {
+            if (m_queuedScanTasks.at(i).value(0) == taskId) {
+                m_queuedScanTasks.removeAt(i);
+                break;
+            }
+        }
+        updateFeederWatches();
+        
         // 调用设备扫描功能
         onDeviceScanRequested(currentDevice, taskId, className, subject);
     } else {
@@ -347,16 +448,10 @@ void MainWindow::onDeviceScanRequested(const QString &deviceName, const QString
     qDebug() << "班级:" << className;
     qDebug() << "学科:" << subject;
     
-    // 设置扫描参数
-    m_scanManager->setScanSettings(deviceName, 300, "jpeg", "Color", true); // 双面扫描
-    
-    // 开始批量扫描
-    bool success = m_scanManager->startBatchScan(deviceName, "2025年上第一次月考", className, subject, 6);
-    if (success) {
-        qDebug() << "✓ 批量扫描启动成功";
-    } else {
-        qDebug() << "✗ 批量扫描启动失败";
-    }
+    // 获得设备租约后再开始扫描，避免与打印同时占用一体机
+    int leaseId = m_deviceManager->requestLease(deviceName, "scan");
+    m_pendingScanRequests[leaseId] = QStringList() << taskId << className << subject << deviceName;
+    qDebug() << "等待设备空闲，租约:" << leaseId;
 }
 
 // 新增：设备打印请求处理
@@ -369,18 +464,206 @@ void MainWindow::onDevicePrintRequested(const QString &deviceName, const QString
     qDebug() << "班级:" << className;
     qDebug() << "学科:" << subject;
     
-    // 设置打印参数
-    m_printManager->setPrintSettings(deviceName, 1, "A3", "two-sided-long-edge");
+    // 获得设备租约后再开始打印
+    int leaseId = m_deviceManager->requestLease(deviceName, "print");
+    m_pendingPrintRequests[leaseId] = QStringList() << taskId << className << subject;
+    qDebug() << "等待设备空闲，租约:" << leaseId;
+}
+
+void MainWindow::onDeviceLeaseGranted(int leaseId, const QString &deviceName, const QString &kind)
+{
+    if (kind == "scan" && m_pendingScanRequests.contains(leaseId)) {
+        QStringList request = m_pendingScanRequests.take(leaseId);
+        m_scanLeases[deviceName] = leaseId;
+        
+        // 设置扫描参数
+        m_scanManager->setScanSettings(deviceName, 300, "jpeg", "Color", true); // 双面扫描
+        PageProcessOptions pageOptions;
+        pageOptions.deskew = true;      // 服务器不必再纠偏
+        pageOptions.autoCrop = true;    // A4 答题卡裁掉 A3 扫描区域的空白
+        pageOptions.previews = true;    // 本地翻看只读预览图
+        m_scanManager->setPostProcessing(deviceName, pageOptions);
+        
+        // 开始批量扫描（中断的批次从断点继续）；页数按答题卡张数计，双面每张两页，
+        // 纸张未注明单双面时按上面的双面设置
+        const QString paper = m_taskPapers.value(request.at(0));
+        const int pageCount = m_taskSheets.value(request.at(0), 1)
+                              * (ScanManager::scanProfileForPaper(paper).duplex == 0 ? 1 : 2);
+        bool success = request.value(4) == "resume"
+                       ? m_scanManager->resumeBatchScan(deviceName)
+                       : m_scanManager->startBatchScan(deviceName, m_taskExams.value(request.at(0)), request.at(1), request.at(2),
+                                                       pageCount, paper);
+        if (success) {
+            qDebug() << "✓ 批量扫描启动成功";
+            if (request.value(4) != "resume") {
+                m_activeScanTasks[deviceName] = request.at(0);
+                m_previewBrowser->clear();
+            }
+        } else {
+            qDebug() << "✗ 批量扫描启动失败";
+            releaseScanLease(deviceName);
+            if (request.value(4) != "resume") {
+                m_startedScanTasks.remove(request.at(0));
+            }
+        }
+    } else if (kind == "print" && m_pendingPrintRequests.contains(leaseId)) {
+        QStringList request = m_pendingPrintRequests.take(leaseId);
+        
+        // 设置打印参数
+        m_printManager->setPrintSettings(deviceName, 1, "A3", "two-sided-long-edge");
+        
+        // 生成打印文件名
+        QString fileName = QString("print_task_%1_%2_%3.pdf").arg(request.at(0), request.at(1), request.at(2));
+        
+        // 租约跟随这次提交：进入打印队列或提交失败（printJobFailed）时释放
+        m_printLeases[fileName].append(leaseId);
+        bool success = m_printManager->printFile(deviceName, fileName, fileName);
+        if (success) {
+            qDebug() << "✓ 打印任务启动成功";
+        } else {
+            qDebug() << "✗ 打印任务启动失败";
+        }
+    }
+}
+
+void MainWindow::onScanTasksUpdated(const QJsonArray &tasks)
+{
+    // 重新整理待扫描队列，保持服务器返回的顺序
+    m_queuedScanTasks.clear();
+    QSet<QString> pending;
+    for (const QJsonValue &value : tasks) {
+        QJsonObject task = value.toObject();
+        QString taskId = task.value("id").toString();
+        m_taskPapers[taskId] = task.value("paper").toString();
+        // quantity 字段可能是字符串也可能是数字，与打印份数的取法一致
+        QJsonValue quantity = task.value("quantity");
+        m_taskSheets[taskId] = qMax(quantity.isString() ? quantity.toString().toInt() : quantity.toInt(), 1);
+        // 字节预算、版面等按考试下发（ExamManager 随班级信息获取），任务没有考试类型时取当前选择的考试
+        QString examType = task.value("examType").toString();
+        m_taskExams[taskId] = examType.isEmpty() ? m_examManager->currentExamType() : examType;
+        if (task.value("status").toString() != "待扫描") {
+            continue;
+        }
+        pending.insert(taskId);
+        if (!m_startedScanTasks.contains(taskId)) {
+            m_queuedScanTasks.append(QStringList() << taskId << task.value("className").toString()
+                                                   << task.value("subject").toString());
+        }
+    }
     
-    // 生成打印文件名
-    QString fileName = QString("print_task_%1_%2_%3.pdf").arg(taskId).arg(className).arg(subject);
+    // 服务器不再列为待扫描的任务已经完成，不必再记录；正在扫描的任务保留
+    const QList<QString> active = m_activeScanTasks.values();
+    for (const QString &taskId : m_startedScanTasks.values()) {
+        if (!pending.contains(taskId) && !active.contains(taskId)) {
+            m_startedScanTasks.remove(taskId);
+        }
+    }
+    updateFeederWatches();
+}
+
+void MainWindow::onScannerAdfLoaded(const QString &deviceName)
+{
+    if (hasScanRequest(deviceName)) {
+        return;
+    }
     
-    // 开始打印
-    bool success = m_printManager->printFile(deviceName, fileName, fileName);
-    if (success) {
-        qDebug() << "✓ 打印任务启动成功";
-    } else {
-        qDebug() << "✗ 打印任务启动失败";
+    // 中断的批次优先：排除故障后放回剩余纸张，从断点的下一页继续
+    if (requestScanResume(deviceName)) {
+        return;
+    }
+    
+    // 操作员放好纸后直接开始下一个任务，不需要再回到界面点击
+    if (m_queuedScanTasks.isEmpty()) {
+        return;
+    }
+    
+    QStringList task = m_queuedScanTasks.takeFirst();
+    m_startedScanTasks.insert(task.at(0));
+    qDebug() << "进纸器放纸，自动开始扫描任务:" << deviceName << task;
+    onDeviceScanRequested(deviceName, task.at(0), task.at(1), task.at(2));
+    updateFeederWatches();
+}
+
+bool MainWindow::requestScanResume(const QString &deviceName)
+{
+    if (hasScanRequest(deviceName) || !m_scanManager->hasBatchCheckpoint(deviceName)) {
+        return false;
+    }
+    
+    BatchCheckpoint checkpoint = m_scanManager->batchCheckpoint(deviceName);
+    int leaseId = m_deviceManager->requestLease(deviceName, "scan");
+    m_pendingScanRequests[leaseId] = QStringList() << QString() << checkpoint.className
+                                                   << checkpoint.subject << deviceName << "resume";
+    qDebug() << "继续中断的批量扫描:" << deviceName << "从第" << (checkpoint.completedPages + 1) << "页开始，租约:" << leaseId;
+    return true;
+}
+
+bool MainWindow::hasScanRequest(const QString &deviceName) const
+{
+    if (m_scanLeases.contains(deviceName)) {
+        return true;
+    }
+    for (const QStringList &request : m_pendingScanRequests) {
+        if (request.value(3) == deviceName) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MainWindow::updateFeederWatches()
+{
+    // 只在有待扫描任务或中断的批次时轮询进纸器
+    for (auto it = m_esclScanners.constBegin(); it != m_esclScanners.constEnd(); ++it) {
+        if (m_queuedScanTasks.isEmpty() && !m_scanManager->hasBatchCheckpoint(it.key())) {
+            m_deviceManager->unwatchScannerFeeder(it.key());
+        } else {
+            m_deviceManager->watchScannerFeeder(it.key(), it.value());
+        }
+    }
+}
+
+void MainWindow::updateIppEndpoint(const QString &deviceName)
+{
+    // 设备配置 print_ipp=true 且已发现打印机的 IPP 地址时直接提交给打印机，否则经过 CUPS
+    QMap<QString, QString> config = m_deviceManager->getDeviceConfiguration(deviceName);
+    QUrl printerUri(config.value("printer_uri"));
+    bool ipp = config.value("print_ipp") == "true" && printerUri.isValid() && !printerUri.isEmpty();
+    if (ipp && !m_printManager->hasIppEndpoint(deviceName)) {
+        m_printManager->setIppEndpoint(deviceName, printerUri);
+    } else if (!ipp && m_printManager->hasIppEndpoint(deviceName)) {
+        m_printManager->setIppEndpoint(deviceName, QUrl());
+    }
+}
+
+void MainWindow::finishScanTask(const QString &deviceName, bool failed)
+{
+    // 完成的任务在服务器更新状态前仍可能列为待扫描，留在 m_startedScanTasks 中避免重复扫描；
+    // 失败的任务移除，下次放纸时重新开始
+    QString taskId = m_activeScanTasks.take(deviceName);
+    if (failed && !taskId.isEmpty()) {
+        m_startedScanTasks.remove(taskId);
+        qDebug() << "扫描任务失败，重新排队:" << taskId;
+    }
+}
+
+void MainWindow::releaseScanLease(const QString &deviceName)
+{
+    if (m_scanLeases.contains(deviceName)) {
+        m_deviceManager->releaseLease(m_scanLeases.take(deviceName));
+    }
+}
+
+void MainWindow::releasePrintLease(const QString &jobName)
+{
+    if (!m_printLeases.contains(jobName)) {
+        return;
+    }
+    // 同名任务提交多次时按提交顺序释放
+    QList<int> &leases = m_printLeases[jobName];
+    m_deviceManager->releaseLease(leases.takeFirst());
+    if (leases.isEmpty()) {
+        m_printLeases.remove(jobName);
     }
 }
 
@@ -389,22 +672,48 @@ void MainWindow::initializeDeviceManager()
 {
     qDebug() << "\n=== 初始化设备管理器 ===";
     
-    // 发现设备
-    QStringList allDevices = m_deviceManager->discoverDevices();
-    qDebug() << "发现设备总数:" << allDevices.size();
+    // 设备在后台发现，完成后再显示设备信息，界面不必等待
+    connect(m_deviceManager, &DeviceManager::discoveryFinished,
+            this, [this](const QStringList &devices) {
+                qDebug() << "发现设备总数:" << devices.size();
+                
+                // AirScan 设备在设备配置中启用 scan_escl 后直接走 eSCL，不经过 SANE；默认仍用 SANE
+                for (const QString &device : m_deviceManager->getScanDevices()) {
+                    QString host = m_deviceManager->getDeviceHost(device);
+                    bool escl = m_deviceManager->getDeviceConfiguration(device).value("scan_escl") == "true";
+                    if (escl && device.startsWith("airscan:") && !host.isEmpty()
+                        && !m_scanManager->hasEsclEndpoint(device)) {
+                        QUrl endpoint(QString("http://%1/eSCL").arg(host));
+                        m_scanManager->setEsclEndpoint(device, endpoint);
+                        m_esclScanners[device] = endpoint;
+                    }
+                }
+                updateFeederWatches();
+                
+                for (const QString &device : m_deviceManager->getPrintDevices()) {
+                    updateIppEndpoint(device);
+                }
+                
+                // 显示设备信息
+                displayDeviceInfo();
+                
+                // 测试多功能一体机
+                testMultifunctionDevice();
+            });
     
-    // 显示设备信息
-    displayDeviceInfo();
+    // 打印机URI由状态监控读取，之后才能启用 IPP 直连
+    connect(m_deviceManager, &DeviceManager::deviceConfigurationChanged,
+            this, &MainWindow::updateIppEndpoint);
     
-    // 测试多功能一体机
-    testMultifunctionDevice();
+    // 持续跟踪设备状态（缺纸、卡纸、离线等）
+    m_deviceManager->startDeviceMonitoring();
 }
 
 void MainWindow::displayDeviceInfo()
 {
     qDebug() << "\n--- 设备信息显示 ---";
     
-    QStringList allDevices = m_deviceManager->discoverDevices();
+    QStringList allDevices = m_deviceManager->getKnownDevices();
     for (const QString &device : allDevices) {
         QString deviceType = m_deviceManager->getDeviceType(device);
         QString deviceModel = m_deviceManager->getDeviceModel(device);
@@ -3,6 +3,7 @@
 
 #include <QMainWindow>
 #include <QList>
+#include <QSet>
 #include <QTimer>
 #include "form.h"
 #include "networkmanager.h"
@@ -10,6 +11,7 @@
 #include "printmanager.h"
 #include "exammanager.h"
 #include "devicemanager.h"
+#include "previewbrowser.h"
 
 namespace Ui {
 class MainWindow;
@@ -49,6 +51,9 @@ private slots:
     void onDeviceSelected(const QString &deviceName);
     void onDeviceStatusChanged(const QString &deviceName, const QString &status);
     void onDeviceError(const QString &deviceName, const QString &error);
+    void onDeviceLeaseGranted(int leaseId, const QString &deviceName, const QString &kind);
+    void onScannerAdfLoaded(const QString &deviceName);
+    void onScanTasksUpdated(const QJsonArray &tasks);
     
     // Form按钮点击处理
     void onFormScanButtonClicked(const QString &taskId, const QString &className, const QString &subject);
@@ -63,10 +68,26 @@ private:
     PrintManager *m_printManager;
     ExamManager *m_examManager;
     DeviceManager *m_deviceManager;  // 设备管理器
+    PreviewBrowser *m_previewBrowser; // 本批扫描页面浏览（graphicsView）
     
     // 定时器
     QTimer *m_refreshTimer;
     
+    // 设备租约：等待中的请求（租约ID -> 任务ID、班级、学科、设备）和正在使用的租约
+    QMap<int, QStringList> m_pendingScanRequests;
+    QMap<int, QStringList> m_pendingPrintRequests;
+    QMap<QString, int> m_scanLeases;           // 设备 -> 扫描租约
+    QMap<QString, QList<int>> m_printLeases;   // 打印任务名称 -> 按提交顺序的打印租约
+    
+    // 放纸即扫：待扫描任务（任务ID、班级、学科）按顺序分配给放好纸的设备
+    QList<QStringList> m_queuedScanTasks;
+    QSet<QString> m_startedScanTasks;          // 已开始的任务，服务器不再列为待扫描或扫描失败后移除
+    QMap<QString, QString> m_activeScanTasks;  // 设备 -> 正在扫描的任务ID
+    QMap<QString, QString> m_taskPapers;       // 任务ID -> 纸张（如 "A3双面"），决定扫描区域
+    QMap<QString, QString> m_taskExams;        // 任务ID -> 考试类型，决定字节预算和答题卡版面
+    QMap<QString, int> m_taskSheets;           // 任务ID -> 答题卡张数（任务的 quantity），决定扫描页数
+    QMap<QString, QUrl> m_esclScanners;        // 支持进纸器监视的设备 -> eSCL 地址
+    
     // 辅助方法
     void setupConnections();
     void addSampleTasks();
@@ -75,6 +96,13 @@ private:
     void initializeDeviceManager();
     void displayDeviceInfo();
     void testMultifunctionDevice();
+    void releaseScanLease(const QString &deviceName);
+    void releasePrintLease(const QString &jobName);
+    bool hasScanRequest(const QString &deviceName) const;
+    bool requestScanResume(const QString &deviceName);
+    void updateFeederWatches();
+    void finishScanTask(const QString &deviceName, bool failed);
+    void updateIppEndpoint(const QString &deviceName);
     
     // 新增：简化后的功能调用方法
     void onDeviceScanRequested(const QString &deviceName, const QString &taskId, 
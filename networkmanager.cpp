@@ -7,6 +7,10 @@
 #include <QStandardPaths>
 #include <QDebug>
 
+namespace {
+const qint64 PrintStreamReadBuffer = 256 * 1024;   // 流式下载的接收缓冲：暂停读取时满了即停止从网络接收
+}
+
 NetworkManager::NetworkManager(QObject *parent)
     : QObject(parent),
       m_networkManager(new QNetworkAccessManager(this)),
@@ -141,6 +145,71 @@ void NetworkManager::downloadPrintFile(const QString &taskId, const QString &fil
             this, &NetworkManager::onDownloadProgress);
 }
 
+void NetworkManager::streamPrintFile(const QString &taskId, const QString &fileUrl)
+{
+    if (m_printStreams.contains(taskId)) {
+        qDebug() << "Print stream already running for task" << taskId;
+        return;
+    }
+    
+    QNetworkRequest request;
+    request.setUrl(QUrl(fileUrl));
+    
+    QNetworkReply *reply = m_networkManager->get(request);
+    reply->setProperty("requestType", "streamPrint");
+    reply->setProperty("taskId", taskId);
+    m_printStreams[taskId] = reply;
+    
+    // 接收缓冲有上限：打印端来不及写入时暂停读取，TCP 窗口随之收窄，内存不随文件大小增长
+    reply->setReadBufferSize(PrintStreamReadBuffer);
+    
+    // 每收到一段数据就转发，不等待整个文件下载完成
+    connect(reply, &QNetworkReply::readyRead,
+            this, &NetworkManager::onPrintStreamReadyRead);
+    connect(reply, &QNetworkReply::downloadProgress,
+            this, &NetworkManager::onDownloadProgress);
+}
+
+void NetworkManager::abortPrintStream(const QString &taskId)
+{
+    QNetworkReply *reply = m_printStreams.value(taskId, nullptr);
+    if (reply) {
+        reply->abort();
+    }
+}
+
+void NetworkManager::setPrintStreamPaused(const QString &taskId, bool paused)
+{
+    QNetworkReply *reply = m_printStreams.value(taskId, nullptr);
+    if (!reply) return;
+    
+    reply->setProperty("paused", paused);
+    if (!paused) {
+        // 暂停期间缓冲中积压的数据不会再触发 readyRead，恢复时主动取走
+        forwardPrintStream(reply);
+    }
+}
+
+void NetworkManager::onPrintStreamReadyRead()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+    
+    forwardPrintStream(reply);
+}
+
+void NetworkManager::forwardPrintStream(QNetworkReply *reply)
+{
+    // 暂停时数据留在接收缓冲中
+    if (reply->property("paused").toBool()) {
+        return;
+    }
+    QByteArray chunk = reply->readAll();
+    if (!chunk.isEmpty()) {
+        emit printStreamData(reply->property("taskId").toString(), chunk);
+    }
+}
+
 void NetworkManager::updatePrintStatus(const QString &taskId, const QString &status)
 {
     QJsonObject data;
@@ -153,11 +222,28 @@ void NetworkManager::updatePrintStatus(const QString &taskId, const QString &sta
     reply->setProperty("requestType", "updatePrintStatus");
 }
 
-void NetworkManager::onRequestFinished()
+void NetworkManager::onRequestFinished(QNetworkReply *reply)
 {
-    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
     if (!reply) return;
     
+    if (reply->property("requestType").toString() == "streamPrint") {
+        QString taskId = reply->property("taskId").toString();
+        m_printStreams.remove(taskId);
+        
+        bool success = reply->error() == QNetworkReply::NoError;
+        if (success) {
+            QByteArray rest = reply->readAll();
+            if (!rest.isEmpty()) {
+                emit printStreamData(taskId, rest);
+            }
+        } else {
+            handleError(reply);
+        }
+        emit printStreamFinished(taskId, success);
+        reply->deleteLater();
+        return;
+    }
+    
     if (reply->error() == QNetworkReply::NoError) {
         handleJsonResponse(reply);
     } else {
@@ -179,7 +265,17 @@ void NetworkManager::handleJsonResponse(QNetworkReply *reply)
         }
     } else if (requestType == "classInfo") {
         QString examType = reply->property("examType").toString();
-        if (doc.isArray()) {
+        // 新接口返回 {"classes": [...], "layout": {...}, "scan": {...}}，答题卡版面和扫描要求随班级信息一起下发
+        if (doc.isObject()) {
+            QJsonObject object = doc.object();
+            emit classInfoReceived(examType, object.value("classes").toArray());
+            if (object.value("layout").isObject()) {
+                emit examLayoutReceived(examType, object.value("layout").toObject());
+            }
+            if (object.value("scan").isObject()) {
+                emit examScanSettingsReceived(examType, object.value("scan").toObject());
+            }
+        } else if (doc.isArray()) {
             emit classInfoReceived(examType, doc.array());
         }
     } else if (requestType == "scanTasks") {
@@ -262,10 +358,32 @@ void NetworkManager::simulateNetworkResponse(const QString &endpoint)
         classes.append(QJsonObject{{"name", "高一(2)班"}, {"id", "2"}});
         classes.append(QJsonObject{{"name", "高一(3)班"}, {"id", "3"}});
         emit classInfoReceived("期中考试", classes);
+        
+        // A3 纵向答题卡（与批量扫描的进纸方向一致），四角 5mm 定位标记
+        QJsonArray marks{QJsonArray{10, 10}, QJsonArray{287, 10}, QJsonArray{10, 410}, QJsonArray{287, 410}};
+        QJsonArray regions;
+        regions.append(QJsonObject{{"id", "13"}, {"rect", QJsonArray{20, 110, 257, 120}}});
+        regions.append(QJsonObject{{"id", "14"}, {"rect", QJsonArray{20, 250, 257, 150}}});
+        // 1~10 题单选，每题 A~D 四个 5×3mm 填涂框
+        QJsonArray questions;
+        for (int i = 0; i < 10; ++i) {
+            QJsonArray bubbles;
+            for (int option = 0; option < 4; ++option) {
+                bubbles.append(QJsonArray{30 + option * 8, 30 + i * 6, 5, 3});
+            }
+            questions.append(QJsonObject{{"id", QString::number(i + 1)}, {"options", "ABCD"}, {"bubbles", bubbles}});
+        }
+        QJsonObject side{{"marks", marks}, {"regions", regions}, {"questions", questions}};
+        emit examLayoutReceived("期中考试", QJsonObject{
+            {"width", 297}, {"height", 420}, {"markSize", 5}, {"sides", QJsonArray{side, side}}
+        });
+        // 300dpi A3 彩色每页约400KB；月考答题卡只有填涂和黑色笔迹，按黑白输出
+        emit examScanSettingsReceived("期中考试", QJsonObject{{"bytesPerPage", 400 * 1024}});
+        emit examScanSettingsReceived("月考", QJsonObject{{"binarization", "sauvola"}});
     } else if (endpoint.contains("scan-tasks")) {
         QJsonArray tasks;
         tasks.append(QJsonObject{
-            {"id", "1"}, {"className", "高一(1)班"}, {"subject", "数学"},
+            {"id", "1"}, {"examType", "期中考试"}, {"className", "高一(1)班"}, {"subject", "数学"},
             {"paper", "A3双面"}, {"status", "待扫描"}, {"quantity", "50"},
             {"time", "2025/8/2 8:07:25"}
         });
@@ -8,6 +8,7 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QTimer>
+#include <QMap>
 
 class NetworkManager : public QObject
 {
@@ -33,6 +34,11 @@ public:
     // 打印任务管理
     void requestPrintTasks();
     void downloadPrintFile(const QString &taskId, const QString &fileUrl);
+    // 流式下载：数据到达即转发，不写入临时文件
+    void streamPrintFile(const QString &taskId, const QString &fileUrl);
+    void abortPrintStream(const QString &taskId);
+    // 打印端写入积压时暂停转发（数据留在有上限的接收缓冲中，网络随之减速）
+    void setPrintStreamPaused(const QString &taskId, bool paused);
     void updatePrintStatus(const QString &taskId, const QString &status);
 
     // 模拟网络功能（用于测试）
@@ -44,6 +50,8 @@ signals:
     // 考试类型相关信号
     void examTypesReceived(const QJsonArray &examTypes);
     void classInfoReceived(const QString &examType, const QJsonArray &classes);
+    void examLayoutReceived(const QString &examType, const QJsonObject &layout);   // 答题卡版面模板
+    void examScanSettingsReceived(const QString &examType, const QJsonObject &settings);   // 考试的扫描要求
     
     // 扫描任务相关信号
     void scanTasksReceived(const QJsonArray &tasks);
@@ -52,12 +60,15 @@ signals:
     // 打印任务相关信号
     void printTasksReceived(const QJsonArray &tasks);
     void downloadCompleted(const QString &taskId, const QString &filePath, bool success);
+    void printStreamData(const QString &taskId, const QByteArray &data);
+    void printStreamFinished(const QString &taskId, bool success);
     
     // 错误信号
     void networkError(const QString &error);
 
 private slots:
-    void onRequestFinished();
+    void onRequestFinished(QNetworkReply *reply);
+    void onPrintStreamReadyRead();
     void onUploadProgress(qint64 bytesSent, qint64 bytesTotal);
     void onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
 
@@ -68,6 +79,10 @@ private:
     QTimer *m_pollTimer;
     bool m_simulationMode;
     
+    // 流式打印下载
+    QMap<QString, QNetworkReply*> m_printStreams;
+    void forwardPrintStream(QNetworkReply *reply);
+    
     // 请求辅助方法
     QNetworkRequest createRequest(const QString &endpoint);
     void handleJsonResponse(QNetworkReply *reply);
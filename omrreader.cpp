@@ -0,0 +1,136 @@
+#include "omrreader.h"
+#include "stripimage.h"
+#include <QJsonObject>
+
+namespace {
+const int InkThreshold = 160;           // 灰度低于该值视为有墨迹（2B 铅笔约 80~140）
+const double BubbleInset = 0.15;        // 每边去掉框宽（高）的15%，印刷的边框不计入填涂
+const double MarkedFill = 0.40;         // 填涂比例达到该值视为已涂
+const double LightFill = 0.20;          // 介于两者之间视为涂得太浅（或没擦干净），交人工复核
+
+// 一段像素中低于阈值的个数：比较结果直接累加，没有分支，编译器可向量化（NEON/SSE）
+int countDark(const uchar *pixels, int count)
+{
+    int dark = 0;
+    for (int i = 0; i < count; ++i) {
+        dark += pixels[i] < InkThreshold;
+    }
+    return dark;
+}
+}
+
+OmrReader::OmrReader(const QVector<OmrQuestion> &questions, const PageRegistration &registration,
+                     int width, int height, int channels)
+    : m_questions(questions),
+      m_channels(channels),
+      m_lastRow(-1)
+{
+    const QRect page(0, 0, width, height);
+    for (int q = 0; q < questions.size(); ++q) {
+        const QVector<QRectF> &bubbles = questions.at(q).bubbles;
+        for (int option = 0; option < bubbles.size(); ++option) {
+            const QRectF &rect = bubbles.at(option);
+            const double dx = rect.width() * BubbleInset;
+            const double dy = rect.height() * BubbleInset;
+            Bubble bubble;
+            bubble.question = q;
+            bubble.option = option;
+            bubble.rect = registration.mapRect(rect.adjusted(dx, dy, -dx, -dy)).intersected(page);
+            bubble.ink = 0;
+            if (!bubble.rect.isEmpty()) {
+                m_bubbles.append(bubble);
+                m_lastRow = qMax(m_lastRow, bubble.rect.bottom());
+            }
+        }
+    }
+    if (channels == 3) {
+        m_gray.resize(width);
+    }
+}
+
+void OmrReader::addRows(const uchar *rows, int count, int y, int stride)
+{
+    for (Bubble &bubble : m_bubbles) {
+        const int first = qMax(y, bubble.rect.top());
+        const int last = qMin(y + count - 1, bubble.rect.bottom());
+        const int left = bubble.rect.left();
+        const int width = bubble.rect.width();
+        for (int row = first; row <= last; ++row) {
+            const uchar *line = rows + qint64(row - y) * stride;
+            if (m_channels == 3) {
+                // 只转换框内的一段
+                StripOps::rgbToGray(line + left * 3, m_gray.data(), width);
+                bubble.ink += countDark(m_gray.constData(), width);
+            } else {
+                bubble.ink += countDark(line + left, width);
+            }
+        }
+    }
+}
+
+QString OmrReader::questionStatus(int question, QString *answer, QJsonArray *fill) const
+{
+    const OmrQuestion &omr = m_questions.at(question);
+    QVector<double> ratios(omr.bubbles.size(), 0);
+    for (const Bubble &bubble : m_bubbles) {
+        if (bubble.question == question) {
+            ratios[bubble.option] = double(bubble.ink) / (qint64(bubble.rect.width()) * bubble.rect.height());
+        }
+    }
+
+    QString marked;
+    QString light;
+    for (int option = 0; option < ratios.size(); ++option) {
+        fill->append(qRound(ratios[option] * 100) / 100.0);
+        if (ratios[option] >= MarkedFill) {
+            marked.append(omr.options.at(option));
+        } else if (ratios[option] >= LightFill) {
+            light.append(omr.options.at(option));
+        }
+    }
+
+    // 单选题有一个涂满时，其余浅痕视为擦除；没有涂满的选项时浅痕需要复核
+    if (!marked.isEmpty()) {
+        *answer = marked;
+        if (!omr.multiple && marked.size() > 1) {
+            return "multiple";
+        }
+        return omr.multiple && !light.isEmpty() ? "uncertain" : "ok";
+    }
+    if (!light.isEmpty()) {
+        *answer = light;
+        return "uncertain";
+    }
+    return "blank";
+}
+
+QJsonArray OmrReader::answers() const
+{
+    QJsonArray answers;
+    for (int q = 0; q < m_questions.size(); ++q) {
+        QString answer;
+        QJsonArray fill;
+        QString status = questionStatus(q, &answer, &fill);
+        answers.append(QJsonObject{
+            {"id", m_questions.at(q).id},
+            {"answer", answer},
+            {"status", status},
+            {"fill", fill}
+        });
+    }
+    return answers;
+}
+
+int OmrReader::uncertainCount() const
+{
+    int count = 0;
+    for (int q = 0; q < m_questions.size(); ++q) {
+        QString answer;
+        QJsonArray fill;
+        QString status = questionStatus(q, &answer, &fill);
+        if (status == "uncertain" || status == "multiple") {
+            ++count;
+        }
+    }
+    return count;
+}
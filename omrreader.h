@@ -0,0 +1,47 @@
+#ifndef OMRREADER_H
+#define OMRREADER_H
+
+#include "examlayout.h"
+#include "regionextractor.h"
+#include <QJsonArray>
+
+// 客观题识别：按配准结果把填涂框映射到页面像素，随条带逐行累加框内的深色像素，
+// 整页读完后得到每个选项的填涂比例和答案，不需要整页进入内存。
+// 计数附在裁剪答题区域的那遍读取上，每框每行只比较几十个像素；每页的开销主要是定位、裁剪两遍解码
+// （加上首遍处理共三遍），实际耗时见 extractRegions 的日志
+class OmrReader
+{
+public:
+    OmrReader(const QVector<OmrQuestion> &questions, const PageRegistration &registration,
+              int width, int height, int channels);
+
+    bool isEmpty() const { return m_bubbles.isEmpty(); }
+    int lastRow() const { return m_lastRow; }       // 最后一个填涂框的底边，之后的行不必读取
+
+    // 按顺序送入从第 y 行开始的 count 行（8 位灰度或 RGB）
+    void addRows(const uchar *rows, int count, int y, int stride);
+
+    // [{"id":"1","answer":"B","status":"ok","fill":[0.06,0.81,0.05,0.07]}]
+    // status：ok / blank（未填涂）/ multiple（单选题涂了多个）/ uncertain（涂得太浅，需人工复核）
+    QJsonArray answers() const;
+    int uncertainCount() const;
+
+private:
+    struct Bubble
+    {
+        int question;
+        int option;
+        QRect rect;             // 页面像素，已去掉印刷的边框
+        qint64 ink;
+    };
+
+    QVector<OmrQuestion> m_questions;
+    QVector<Bubble> m_bubbles;
+    int m_channels;
+    int m_lastRow;
+    QVector<uchar> m_gray;      // RGB 行转灰度的缓冲
+
+    QString questionStatus(int question, QString *answer, QJsonArray *fill) const;
+};
+
+#endif // OMRREADER_H
@@ -0,0 +1,196 @@
+#include "pagebufferpool.h"
+#include <QDebug>
+#include <cstdlib>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
+
+namespace {
+const int MinSizeClass = 16;           // 最小级别 64KB
+const int MappedSizeClass = 21;        // 2MB 及以上用 mmap，可以使用大页
+}
+
+PageBufferPool::PageBufferPool(int maxCachedPerClass)
+    : m_maxCachedPerClass(maxCachedPerClass),
+      m_allocations(0),
+      m_reuses(0),
+      m_hugeTlbAvailable(true)
+{
+}
+
+PageBufferPool::~PageBufferPool()
+{
+    QMutexLocker locker(&m_mutex);
+    int inUse = m_blocks.size();
+    for (const QList<uchar*> &blocks : m_freeBlocks) {
+        inUse -= blocks.size();
+    }
+    if (inUse > 0) {
+        qWarning() << "页面缓冲池销毁时仍有缓冲区未归还:" << inUse;
+    }
+    qDebug() << "页面缓冲池: 分配" << m_allocations << "复用" << m_reuses;
+    
+    for (auto it = m_blocks.constBegin(); it != m_blocks.constEnd(); ++it) {
+        freeBlock(it.key(), it.value());
+    }
+}
+
+int PageBufferPool::sizeClassFor(qint64 size)
+{
+    int sizeClass = MinSizeClass;
+    while ((qint64(1) << sizeClass) < size) {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+uchar *PageBufferPool::allocateBlock(int sizeClass, Block *block)
+{
+    qint64 capacity = qint64(1) << sizeClass;
+    block->capacity = capacity;
+    block->sizeClass = sizeClass;
+    
+#ifdef Q_OS_LINUX
+    if (sizeClass >= MappedSizeClass) {
+        // 先尝试预留的大页（hugetlbfs），没有预留时退回普通映射并建议内核使用透明大页
+        void *memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (m_hugeTlbAvailable) {
+            memory = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (memory == MAP_FAILED) {
+                m_hugeTlbAvailable = false;
+            } else {
+                block->hugePages = true;
+            }
+        }
+#endif
+        if (memory == MAP_FAILED) {
+            memory = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                return nullptr;
+            }
+#ifdef MADV_HUGEPAGE
+            block->hugePages = madvise(memory, capacity, MADV_HUGEPAGE) == 0;
+#endif
+        }
+        block->mapped = true;
+        return static_cast<uchar*>(memory);
+    }
+#endif
+    
+    return static_cast<uchar*>(malloc(capacity));
+}
+
+void PageBufferPool::freeBlock(uchar *buffer, const Block &block)
+{
+#ifdef Q_OS_LINUX
+    if (block.mapped) {
+        munmap(buffer, block.capacity);
+        return;
+    }
+#endif
+    free(buffer);
+}
+
+uchar *PageBufferPool::acquire(qint64 size, qint64 *capacity)
+{
+    int sizeClass = sizeClassFor(size);
+    QMutexLocker locker(&m_mutex);
+    
+    QList<uchar*> &freeBlocks = m_freeBlocks[sizeClass];
+    if (!freeBlocks.isEmpty()) {
+        ++m_reuses;
+        uchar *buffer = freeBlocks.takeLast();
+        if (capacity) *capacity = m_blocks.value(buffer).capacity;
+        return buffer;
+    }
+    
+    Block block;
+    uchar *buffer = allocateBlock(sizeClass, &block);
+    if (!buffer) {
+        qWarning() << "页面缓冲区分配失败，大小:" << size;
+        return nullptr;
+    }
+    ++m_allocations;
+    m_blocks.insert(buffer, block);
+    if (capacity) *capacity = block.capacity;
+    return buffer;
+}
+
+void PageBufferPool::release(uchar *buffer)
+{
+    if (!buffer) return;
+    
+    QMutexLocker locker(&m_mutex);
+    auto it = m_blocks.find(buffer);
+    if (it == m_blocks.end()) {
+        qWarning() << "归还的缓冲区不属于页面缓冲池";
+        return;
+    }
+    
+    // 每级只缓存有限个，多出来的直接还给系统
+    QList<uchar*> &freeBlocks = m_freeBlocks[it.value().sizeClass];
+    if (freeBlocks.size() < m_maxCachedPerClass) {
+        freeBlocks.append(buffer);
+    } else {
+        Block block = it.value();
+        m_blocks.erase(it);
+        freeBlock(buffer, block);
+    }
+}
+
+void PageBufferPool::trim()
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it) {
+        for (uchar *buffer : it.value()) {
+            freeBlock(buffer, m_blocks.take(buffer));
+        }
+        it.value().clear();
+    }
+}
+
+qint64 PageBufferPool::allocationCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_allocations;
+}
+
+qint64 PageBufferPool::reuseCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_reuses;
+}
+
+int PageBufferPool::hugePageCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    int count = 0;
+    for (const Block &block : m_blocks) {
+        if (block.hugePages) ++count;
+    }
+    return count;
+}
+
+// ===== PageBuffer =====
+
+PageBuffer::PageBuffer(PageBufferPool *pool, qint64 size)
+    : m_pool(pool),
+      m_data(nullptr),
+      m_size(size)
+{
+    if (size > 0) {
+        m_data = m_pool ? m_pool->acquire(size) : static_cast<uchar*>(malloc(size));
+    }
+}
+
+PageBuffer::~PageBuffer()
+{
+    if (m_pool) {
+        m_pool->release(m_data);
+    } else {
+        free(m_data);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef PAGEBUFFERPOOL_H
+#define PAGEBUFFERPOOL_H
+
+#include <QMutex>
+#include <QMap>
+#include <QHash>
+#include <QList>
+
+// 页面缓冲池：按2的幂分级缓存大块内存，扫描、后处理、编码各阶段借用后归还，
+// 批量扫描稳定后每页不再向系统申请大块内存。线程安全
+class PageBufferPool
+{
+public:
+    explicit PageBufferPool(int maxCachedPerClass = 8);
+    ~PageBufferPool();
+
+    // 借用至少 size 字节的缓冲区，实际容量为所在级别的大小
+    uchar *acquire(qint64 size, qint64 *capacity = nullptr);
+    void release(uchar *buffer);
+    
+    // 释放所有缓存的空闲缓冲区（正在使用的不受影响）
+    void trim();
+    
+    // 统计：向系统申请的次数、复用次数、使用大页的缓冲区数
+    qint64 allocationCount() const;
+    qint64 reuseCount() const;
+    int hugePageCount() const;
+
+private:
+    struct Block
+    {
+        qint64 capacity = 0;
+        int sizeClass = 0;
+        bool mapped = false;       // mmap 分配（否则 malloc）
+        bool hugePages = false;
+    };
+    
+    mutable QMutex m_mutex;
+    QMap<int, QList<uchar*>> m_freeBlocks;   // 级别 -> 空闲缓冲区
+    QHash<uchar*, Block> m_blocks;           // 所有已分配的缓冲区
+    int m_maxCachedPerClass;
+    qint64 m_allocations;
+    qint64 m_reuses;
+    bool m_hugeTlbAvailable;                 // MAP_HUGETLB 失败后不再尝试
+    
+    static int sizeClassFor(qint64 size);
+    uchar *allocateBlock(int sizeClass, Block *block);
+    void freeBlock(uchar *buffer, const Block &block);
+};
+
+// 缓冲区借用凭证：析构时自动归还；pool 为空时直接使用堆内存
+class PageBuffer
+{
+public:
+    PageBuffer(PageBufferPool *pool, qint64 size);
+    ~PageBuffer();
+    
+    uchar *data() const { return m_data; }
+    qint64 size() const { return m_size; }
+    bool isNull() const { return m_data == nullptr; }
+
+private:
+    Q_DISABLE_COPY(PageBuffer)
+    
+    PageBufferPool *m_pool;
+    uchar *m_data;
+    qint64 m_size;
+};
+
+#endif // PAGEBUFFERPOOL_H
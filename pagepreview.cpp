@@ -0,0 +1,161 @@
+#include "pagepreview.h"
+#include "stripimage.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+
+namespace {
+const int PreviewQuality = 75;
+const char *PreviewDirectory = ".previews";
+
+// 先写临时文件再改名，浏览器不会读到写了一半的预览
+bool replaceFile(const QString &tempPath, const QString &path, QString *error)
+{
+    QFile::remove(path);
+    if (!QFile::rename(tempPath, path)) {
+        QFile::remove(tempPath);
+        if (error) *error = "Cannot replace " + path;
+        return false;
+    }
+    return true;
+}
+}
+
+PagePreview::PagePreview(int width, int height, int channels)
+    : m_width(width),
+      m_height(height),
+      m_channels(channels),
+      m_largeWidth((width + LargeScale - 1) / LargeScale),
+      m_largeHeight((height + LargeScale - 1) / LargeScale),
+      m_rows(0),
+      m_sums(m_largeWidth * channels, 0),
+      m_large(m_largeWidth * m_largeHeight * channels, 0)
+{
+}
+
+void PagePreview::addRows(const uchar *rows, int count, int stride)
+{
+    for (int row = 0; row < count && m_rows < m_height; ++row) {
+        const uchar *line = rows + qint64(row) * stride;
+        quint32 *sums = m_sums.data();
+        for (int x = 0; x < m_width; ++x) {
+            quint32 *target = sums + (x / LargeScale) * m_channels;
+            for (int c = 0; c < m_channels; ++c) {
+                target[c] += line[x * m_channels + c];
+            }
+        }
+        ++m_rows;
+
+        // 每满 8 行（或到最后一行）输出一行 1/8 预览
+        if (m_rows % LargeScale != 0 && m_rows != m_height) {
+            continue;
+        }
+        int largeRow = (m_rows - 1) / LargeScale;
+        int blockRows = m_rows - largeRow * LargeScale;
+        uchar *target = m_large.data() + qint64(largeRow) * m_largeWidth * m_channels;
+        for (int x = 0; x < m_largeWidth; ++x) {
+            int pixels = blockRows * qMin(int(LargeScale), m_width - x * LargeScale);
+            for (int c = 0; c < m_channels; ++c) {
+                target[x * m_channels + c] = uchar(sums[x * m_channels + c] / pixels);
+            }
+        }
+        m_sums.fill(0);
+    }
+}
+
+bool PagePreview::save(const QString &pagePath, QString *error) const
+{
+    if (m_rows < m_height || m_largeWidth <= 0 || m_largeHeight <= 0) {
+        if (error) *error = "Preview is incomplete";
+        return false;
+    }
+    QDir().mkpath(QFileInfo(previewPath(pagePath, LargeScale)).path());
+    if (!writeJpeg(previewPath(pagePath, LargeScale), m_large.constData(), m_largeWidth, m_largeHeight,
+                   m_channels, error)) {
+        return false;
+    }
+
+    // 1/32 由 1/8 再做 4×4 平均
+    const int factor = SmallScale / LargeScale;
+    const int smallWidth = (m_largeWidth + factor - 1) / factor;
+    const int smallHeight = (m_largeHeight + factor - 1) / factor;
+    QVector<uchar> small(smallWidth * smallHeight * m_channels);
+    for (int y = 0; y < smallHeight; ++y) {
+        for (int x = 0; x < smallWidth; ++x) {
+            for (int c = 0; c < m_channels; ++c) {
+                quint32 sum = 0;
+                int pixels = 0;
+                for (int dy = 0; dy < factor && y * factor + dy < m_largeHeight; ++dy) {
+                    const uchar *line = m_large.constData() + qint64(y * factor + dy) * m_largeWidth * m_channels;
+                    for (int dx = 0; dx < factor && x * factor + dx < m_largeWidth; ++dx) {
+                        sum += line[(x * factor + dx) * m_channels + c];
+                        ++pixels;
+                    }
+                }
+                small[(y * smallWidth + x) * m_channels + c] = uchar(sum / pixels);
+            }
+        }
+    }
+    return writeJpeg(previewPath(pagePath, SmallScale), small.constData(), smallWidth, smallHeight,
+                     m_channels, error);
+}
+
+bool PagePreview::saveImage(const QString &pagePath, const QImage &image, QString *error)
+{
+    QDir().mkpath(QFileInfo(previewPath(pagePath, LargeScale)).path());
+    const int scales[] = {LargeScale, SmallScale};
+    for (int scale : scales) {
+        QImage preview = image.scaled(qMax(1, image.width() / scale), qMax(1, image.height() / scale),
+                                      Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        QString path = previewPath(pagePath, scale);
+        QImageWriter writer(path + ".part", "jpeg");
+        writer.setQuality(PreviewQuality);
+        if (!writer.write(preview)) {
+            if (error) *error = writer.errorString();
+            QFile::remove(path + ".part");
+            return false;
+        }
+        if (!replaceFile(path + ".part", path, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString PagePreview::previewPath(const QString &pagePath, int scale)
+{
+    QFileInfo info(pagePath);
+    return QString("%1/%2/%3_%4.jpg").arg(info.path(), PreviewDirectory, info.completeBaseName()).arg(scale);
+}
+
+QImage PagePreview::load(const QString &pagePath, int scale)
+{
+    QImage image(previewPath(pagePath, scale));
+    if (!image.isNull()) {
+        return image;
+    }
+
+    // 未经后处理的页面：按缩小后的尺寸解码，Qt 的 JPEG 插件会设置 libjpeg 的 scale_denom
+    QImageReader reader(pagePath);
+    QSize size = reader.size();
+    if (size.isValid()) {
+        reader.setScaledSize(QSize(qMax(1, size.width() / scale), qMax(1, size.height() / scale)));
+    }
+    return reader.read();
+}
+
+bool PagePreview::writeJpeg(const QString &path, const uchar *pixels, int width, int height, int channels,
+                            QString *error)
+{
+    JpegStripWriter writer;
+    QString tempPath = path + ".part";
+    if (!writer.open(tempPath, width, height, channels, PreviewQuality)
+        || !writer.writeRows(pixels, height, width * channels) || !writer.finish()) {
+        if (error) *error = writer.errorString();
+        QFile::remove(tempPath);
+        return false;
+    }
+    return replaceFile(tempPath, path, error);
+}
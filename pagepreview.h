@@ -0,0 +1,45 @@
+#ifndef PAGEPREVIEW_H
+#define PAGEPREVIEW_H
+
+#include <QString>
+#include <QImage>
+#include <QVector>
+
+// 预览金字塔：后处理逐行累加生成 1/8 和 1/32 缩小图，保存在页面所在目录的 .previews 下，
+// 翻看整批页面时只读几KB的小图，不必解码整页
+class PagePreview
+{
+public:
+    enum Scale {
+        LargeScale = 8,         // 单页查看
+        SmallScale = 32         // 翻页浏览
+    };
+
+    PagePreview(int width, int height, int channels);
+
+    // 按顺序送入整页的行（8 位灰度或 RGB）
+    void addRows(const uchar *rows, int count, int stride);
+    bool save(const QString &pagePath, QString *error = nullptr) const;
+
+    // 整页处理的格式直接由 QImage 生成
+    static bool saveImage(const QString &pagePath, const QImage &image, QString *error = nullptr);
+
+    static QString previewPath(const QString &pagePath, int scale);
+    // 优先读缓存的预览；没有时直接缩小解码（JPEG 由 libjpeg 在 DCT 域缩小，不做整页解码）
+    static QImage load(const QString &pagePath, int scale);
+
+private:
+    int m_width;
+    int m_height;
+    int m_channels;
+    int m_largeWidth;
+    int m_largeHeight;
+    int m_rows;                     // 已送入的行数
+    QVector<quint32> m_sums;        // 当前 8 行块的各列累加
+    QVector<uchar> m_large;         // 1/8 预览像素
+
+    static bool writeJpeg(const QString &path, const uchar *pixels, int width, int height, int channels,
+                          QString *error);
+};
+
+#endif // PAGEPREVIEW_H
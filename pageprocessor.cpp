@@ -0,0 +1,742 @@
+#include "pageprocessor.h"
+#include "stripimage.h"
+#include "pagebufferpool.h"
+#include "bitonal.h"
+#include "deskew.h"
+#include "pagepreview.h"
+#include "regionextractor.h"
+#include "omrreader.h"
+#include <QThreadPool>
+#include <QThread>
+#include <QRunnable>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QScopedPointer>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+const int BlankSampleWidth = 256;      // 空白页检测使用的缩略图宽度（整页处理）
+const int BlankSampleStep = 4;         // 条带处理时空白页检测每4行4列采样一次
+const int StripRows = 64;              // 每个条带的行数：600dpi A3 彩色约1.3MB
+const int ProxyBands = 16;             // 质量搜索代理图：从整页均匀抽取16条行带
+const int ProxyBandRows = 16;          // 每条行带16行（保持全分辨率，字节数按行数比例放大即为整页估计）
+const double BlankMarginRatio = 0.05;  // 忽略四周边缘（扫描阴影、装订孔）
+const int InkThreshold = 160;          // 灰度低于该值视为有墨迹
+const int SauvolaWindowDivisor = 20;   // Sauvola 窗口半径 = dpi/20（300dpi 时窗口宽约2.6mm，为笔画宽度的数倍）
+const int MinSauvolaRadius = 7;
+
+// 单页任务：所有线程从同一个队列取任务，先完成的线程立即取下一页
+class PageTask : public QRunnable
+{
+public:
+    PageTask(PageProcessor *processor, const QString &deviceName, const QString &filePath,
+             const PageProcessOptions &options, PageBufferPool *pool)
+        : m_processor(processor), m_deviceName(deviceName), m_filePath(filePath), m_options(options),
+          m_pool(pool)
+    {
+    }
+
+    void run() override
+    {
+        PageResult result = PageProcessor::processPage(m_filePath, m_options, m_pool);
+        
+        // 通过事件队列回到处理器所在线程（处理器析构时会等待任务结束）
+        QMetaObject::invokeMethod(m_processor, "onPageFinished", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_deviceName), Q_ARG(PageResult, result));
+    }
+
+private:
+    PageProcessor *m_processor;
+    QString m_deviceName;
+    QString m_filePath;
+    PageProcessOptions m_options;
+    PageBufferPool *m_pool;
+};
+
+// 整页读入的图像按条带接口输出灰度行（PNG/TIFF 等没有条带读取器的格式二值化时使用）
+class ImageStripReader : public StripReader
+{
+public:
+    bool open(const QString &filePath)
+    {
+        QImageReader reader(filePath);
+        m_image = reader.read().convertToFormat(QImage::Format_Grayscale8);
+        if (m_image.isNull()) {
+            m_error = reader.errorString();
+            return false;
+        }
+        m_width = m_image.width();
+        m_height = m_image.height();
+        m_channels = 1;
+        return true;
+    }
+    
+    int readRows(uchar *buffer, int maxRows) override
+    {
+        int rows = qMin(maxRows, m_height - m_row);
+        for (int row = 0; row < rows; ++row) {
+            memcpy(buffer + qint64(row) * m_width, m_image.constScanLine(m_row + row), m_width);
+        }
+        m_row += rows;
+        return rows;
+    }
+
+private:
+    QImage m_image;
+    int m_row = 0;
+};
+
+StripReader *openStripReader(const QString &filePath, bool wholeImageFallback)
+{
+    StripReader *reader = StripReader::open(filePath);
+    if (!reader && wholeImageFallback) {
+        ImageStripReader *imageReader = new ImageStripReader;
+        if (imageReader->open(filePath)) {
+            return imageReader;
+        }
+        delete imageReader;
+    }
+    return reader;
+}
+
+// 打开源文件；有纠偏裁边参数时包装为纠偏读取器
+StripReader *openPageReader(const QString &filePath, bool wholeImageFallback, const DeskewParams &deskew,
+                            PageBufferPool *pool)
+{
+    StripReader *reader = openStripReader(filePath, wholeImageFallback);
+    if (reader && deskew.valid) {
+        return new DeskewStripReader(reader, deskew, pool);
+    }
+    return reader;
+}
+
+// 统计条带中的墨迹采样（空白页检测），y 为条带首行在整页中的行号
+void countStripInk(const uchar *gray, int rows, int y, int width, int height, qint64 *ink, qint64 *samples)
+{
+    const int marginX = int(width * BlankMarginRatio);
+    const int marginY = int(height * BlankMarginRatio);
+    const int samplesPerRow = (width - 2 * marginX + BlankSampleStep - 1) / BlankSampleStep;
+    for (int row = 0; row < rows; ++row) {
+        int imageRow = y + row;
+        if (imageRow < marginY || imageRow >= height - marginY || imageRow % BlankSampleStep != 0) {
+            continue;
+        }
+        *ink += StripOps::countInk(gray + qint64(row) * width, marginX, width - marginX,
+                                   InkThreshold, BlankSampleStep);
+        *samples += samplesPerRow;
+    }
+}
+
+// 预览生成失败不影响页面本身
+void savePreview(const PagePreview &preview, const QString &pagePath)
+{
+    QString error;
+    if (!preview.save(pagePath, &error)) {
+        qDebug() << "预览生成失败:" << pagePath << error;
+    }
+}
+
+// 提取答题区域时暂时保留的源文件：输出与源文件同名时源文件先改名，否则保留原文件
+QString keptSourcePath(const PageResult &result)
+{
+    return result.outputPath == result.sourcePath ? result.sourcePath + ".orig" : result.sourcePath;
+}
+
+// 答题区域与客观题：找定位标记，裁出各区域拼成一张图、识别填涂，写入清单；
+// 源文件还在时经同样的纠偏裁边读取源文件，拼图不再从有损的输出 JPEG 二次压缩，否则读取输出页面。
+// 失败时不影响页面本身，上传整页
+void extractRegions(const PageProcessOptions &options, const DeskewParams &deskew, PageBufferPool *pool,
+                    PageResult *result)
+{
+    const QString keptSource = keptSourcePath(*result);
+    const bool fromSource = keptSource != result->outputPath && QFile::exists(keptSource);
+    auto openPage = [&]() {
+        return fromSource ? openPageReader(keptSource, true, deskew, pool)
+                          : openStripReader(result->outputPath, true);
+    };
+    // 定位和裁剪各要再解码一遍页面（裁剪读到最后一个区域为止），耗时分开记录，
+    // 与 processPage 的总耗时对照即可得到除首遍处理外的额外开销
+    QElapsedTimer timer;
+    timer.start();
+    QScopedPointer<StripReader> reader(openPage());
+    if (!reader) {
+        return;
+    }
+    PageRegistration registration = RegionExtractor::locate(reader.data(), options.layout, options.dpi, pool);
+    const qint64 locateMs = timer.restart();
+    if (!registration.valid) {
+        qDebug() << "未找到定位标记，上传整页:" << result->outputPath << "标记数:" << registration.marksFound;
+        return;
+    }
+    
+    QFileInfo info(result->outputPath);
+    const QString base = info.path() + "/" + info.completeBaseName() + "_regions";
+    const int quality = result->quality > 0 ? result->quality : options.quality;
+    QJsonArray regions;
+    QString error;
+    reader.reset(openPage());
+    if (!reader) {
+        return;
+    }
+    OmrReader omr(options.layout.questions, registration, reader->width(), reader->height(), reader->channels());
+    if (!RegionExtractor::extract(reader.data(), options.layout, registration, base + ".jpg", quality,
+                                  options.dpi, pool, &regions, omr.isEmpty() ? nullptr : &omr, &error)) {
+        qDebug() << "答题区域提取失败，上传整页:" << result->outputPath << error;
+        return;
+    }
+    qDebug() << "答题区域:" << info.fileName() << (fromSource ? "源文件" : "输出文件") << "定位(ms):" << locateMs
+             << "裁剪与填涂(ms):" << timer.elapsed() << "填涂框:" << options.layout.questions.size() << "题";
+    // 版面只有客观题时不生成拼图，只上传清单
+    const bool package = !regions.isEmpty();
+    
+    QJsonArray transform;
+    for (double value : registration.m) {
+        transform.append(value);
+    }
+    QJsonObject manifest{
+        {"page", info.fileName()},
+        {"marks", registration.marksFound},
+        {"residual", registration.residual},
+        {"transform", transform},
+        {"regions", regions}
+    };
+    if (package) {
+        manifest.insert("package", QFileInfo(base + ".jpg").fileName());
+    }
+    if (!omr.isEmpty()) {
+        manifest.insert("answers", omr.answers());
+        result->objectiveAnswers = options.layout.questions.size();
+        result->uncertainAnswers = omr.uncertainCount();
+    }
+    QFile file(base + ".json.part");
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(manifest).toJson(QJsonDocument::Compact)) < 0) {
+        qDebug() << "答题区域清单写入失败:" << file.fileName();
+        file.remove();
+        QFile::remove(base + ".jpg");
+        return;
+    }
+    file.close();
+    QFile::remove(base + ".json");
+    if (!file.rename(base + ".json")) {
+        file.remove();
+        QFile::remove(base + ".jpg");
+        return;
+    }
+    result->regionPath = package ? base + ".jpg" : QString();
+    result->manifestPath = base + ".json";
+}
+
+// 缩略图上统计深色像素比例（非条带格式使用）
+double inkRatio(const QImage &image)
+{
+    QImage sample = image.scaledToWidth(qMin(BlankSampleWidth, image.width()), Qt::FastTransformation)
+                         .convertToFormat(QImage::Format_Grayscale8);
+    int marginX = int(sample.width() * BlankMarginRatio);
+    int marginY = int(sample.height() * BlankMarginRatio);
+    
+    qint64 total = 0;
+    qint64 ink = 0;
+    for (int y = marginY; y < sample.height() - marginY; ++y) {
+        const uchar *line = sample.constScanLine(y);
+        for (int x = marginX; x < sample.width() - marginX; ++x) {
+            ++total;
+            if (line[x] < InkThreshold) {
+                ++ink;
+            }
+        }
+    }
+    return total > 0 ? double(ink) / total : 0;
+}
+
+QString outputFormat(const QString &filePath, const PageProcessOptions &options)
+{
+    QString format = options.format.isEmpty() ? QFileInfo(filePath).suffix().toLower() : options.format.toLower();
+    return format == "jpg" ? QString("jpeg") : format;
+}
+
+QString outputPathFor(const QString &filePath, const QString &format)
+{
+    QFileInfo info(filePath);
+    return info.path() + "/" + info.completeBaseName() + "." + (format == "jpeg" ? "jpg" : format);
+}
+
+// 临时文件替换为最终文件，格式变化时删除原文件；keepSource 时源文件留给答题区域提取，之后再删除
+bool replaceOutput(const QString &tempPath, PageResult *result, bool keepSource)
+{
+    const QString keptSource = keptSourcePath(*result);
+    const bool moveSource = keepSource && keptSource != result->sourcePath;
+    if (moveSource) {
+        QFile::remove(keptSource);
+        QFile::rename(result->sourcePath, keptSource);
+    }
+    QFile::remove(result->outputPath);
+    if (!QFile::rename(tempPath, result->outputPath)) {
+        QFile::remove(tempPath);
+        if (moveSource) {
+            QFile::rename(keptSource, result->sourcePath);
+        }
+        result->error = "Cannot replace " + result->outputPath;
+        return false;
+    }
+    if (result->outputPath != result->sourcePath && !keepSource) {
+        QFile::remove(result->sourcePath);
+    }
+    return true;
+}
+
+// 条带处理：读取、灰度转换、空白检测、JPEG 编码逐条带进行，内存占用与分辨率无关
+bool processStrips(StripReader *reader, const PageProcessOptions &options, bool rewrite,
+                   PageBufferPool *pool, PageResult *result)
+{
+    const int width = reader->width();
+    const int height = reader->height();
+    const int channels = reader->channels();
+    const bool toGray = options.grayscale && channels == 3;
+    const bool needGray = toGray || options.detectBlank;
+    
+    // 条带缓冲区从缓冲池借用，连续处理的页面复用同一批内存
+    PageBuffer strip(pool, qint64(StripRows) * reader->rowBytes());
+    PageBuffer grayStrip(pool, channels == 3 && needGray && !toGray ? qint64(StripRows) * width : 0);
+    if (strip.isNull()) {
+        result->error = "Out of memory for strip buffer";
+        return false;
+    }
+    uchar *data = strip.data();
+    
+    // 预览与输出内容一致（灰度输出时为灰度）
+    const int outChannels = toGray ? 1 : channels;
+    QScopedPointer<PagePreview> preview(options.previews ? new PagePreview(width, height, outChannels) : nullptr);
+    
+    JpegStripWriter writer;
+    QString tempPath = result->outputPath + ".part";
+    if (rewrite && !writer.open(tempPath, width, height, toGray ? 1 : channels, options.quality, options.dpi)) {
+        result->error = writer.errorString();
+        QFile::remove(tempPath);
+        return false;
+    }
+    
+    qint64 ink = 0;
+    qint64 samples = 0;
+    
+    int y = 0;
+    while (y < height) {
+        int rows = reader->readRows(data, StripRows);
+        if (rows <= 0) {
+            result->error = rows < 0 ? reader->errorString() : QString("Image data ended early");
+            if (rewrite) QFile::remove(tempPath);
+            return false;
+        }
+        
+        // 灰度输出时就地转换，否则转换到单独的灰度条带只用于检测
+        const uchar *gray = data;
+        if (channels == 3 && needGray) {
+            uchar *target = toGray ? data : grayStrip.data();
+            StripOps::rgbToGray(data, target, rows * width);
+            gray = target;
+        }
+        
+        if (options.detectBlank) {
+            countStripInk(gray, rows, y, width, height, &ink, &samples);
+        }
+        
+        const uchar *output = toGray ? gray : data;
+        if (preview) {
+            preview->addRows(output, rows, toGray ? width : reader->rowBytes());
+        }
+        if (rewrite) {
+            if (!writer.writeRows(output, rows, toGray ? width : reader->rowBytes())) {
+                result->error = writer.errorString();
+                QFile::remove(tempPath);
+                return false;
+            }
+        }
+        y += rows;
+    }
+    
+    if (options.detectBlank) {
+        result->inkRatio = samples > 0 ? double(ink) / samples : 0;
+        result->blank = result->inkRatio < options.blankInkRatio;
+    }
+    
+    if (rewrite) {
+        if (!writer.finish()) {
+            result->error = writer.errorString();
+            QFile::remove(tempPath);
+            return false;
+        }
+        if (!replaceOutput(tempPath, result, options.layout.isValid())) {
+            return false;
+        }
+    }
+    if (preview) {
+        savePreview(*preview, result->outputPath);
+    }
+    return true;
+}
+
+// 按字节预算选择 JPEG 质量：读取一遍源图像组成代理图，在代理图上二分查找
+int chooseQuality(StripReader *reader, const PageProcessOptions &options, PageBufferPool *pool)
+{
+    const int width = reader->width();
+    const int height = reader->height();
+    const bool toGray = options.grayscale && reader->channels() == 3;
+    const int outChannels = toGray ? 1 : reader->channels();
+    const int bands = qMax(1, qMin(ProxyBands, height / ProxyBandRows));
+    const int spacing = height / bands;
+    const int proxyRows = qMin(height, bands * ProxyBandRows);
+    const int proxyStride = width * outChannels;
+    
+    PageBuffer strip(pool, qint64(StripRows) * reader->rowBytes());
+    PageBuffer proxy(pool, qint64(proxyRows) * proxyStride);
+    if (strip.isNull() || proxy.isNull()) {
+        return options.quality;
+    }
+    
+    int copied = 0;
+    int y = 0;
+    while (y < height && copied < proxyRows) {
+        int rows = reader->readRows(strip.data(), StripRows);
+        if (rows <= 0) {
+            return options.quality;
+        }
+        for (int row = 0; row < rows && copied < proxyRows; ++row) {
+            if ((y + row) % spacing >= ProxyBandRows) {
+                continue;
+            }
+            const uchar *source = strip.data() + qint64(row) * reader->rowBytes();
+            uchar *target = proxy.data() + qint64(copied) * proxyStride;
+            if (toGray) {
+                StripOps::rgbToGray(source, target, width);
+            } else {
+                memcpy(target, source, proxyStride);
+            }
+            ++copied;
+        }
+        y += rows;
+    }
+    
+    // 代理图与整页的像素密度相同，编码后大小按行数比例即为整页估计
+    const double scale = double(height) / qMax(1, copied);
+    int low = options.minQuality;
+    int high = options.maxQuality;
+    int best = options.minQuality;
+    while (low <= high) {
+        int quality = (low + high) / 2;
+        qint64 size = JpegStripWriter::encodedSize(proxy.data(), width, copied, outChannels, proxyStride, quality);
+        if (size < 0) {
+            return options.quality;
+        }
+        if (size * scale <= options.targetBytes) {
+            best = quality;
+            low = quality + 1;
+        } else {
+            high = quality - 1;
+        }
+    }
+    return best;
+}
+
+// Otsu 全局阈值：读取一遍源图像统计灰度直方图（每4行4列采样）
+int chooseThreshold(StripReader *reader, PageBufferPool *pool)
+{
+    const int width = reader->width();
+    PageBuffer strip(pool, qint64(StripRows) * reader->rowBytes());
+    if (strip.isNull()) {
+        return 127;
+    }
+    
+    quint32 histogram[256] = {0};
+    int y = 0;
+    while (y < reader->height()) {
+        int rows = reader->readRows(strip.data(), StripRows);
+        if (rows <= 0) {
+            break;
+        }
+        if (reader->channels() == 3) {
+            StripOps::rgbToGray(strip.data(), strip.data(), rows * width);
+        }
+        for (int row = 0; row < rows; ++row) {
+            if ((y + row) % BlankSampleStep == 0) {
+                BitonalOps::addHistogram(strip.data() + qint64(row) * width, width, BlankSampleStep, histogram);
+            }
+        }
+        y += rows;
+    }
+    return BitonalOps::otsuThreshold(histogram);
+}
+
+// 二值化条带处理：灰度转换、空白检测、二值化、G4 编码逐行进行。threshold < 0 时使用 Sauvola 局部阈值
+bool processBitonal(StripReader *reader, const PageProcessOptions &options, int threshold,
+                    PageBufferPool *pool, PageResult *result)
+{
+    const int width = reader->width();
+    const int height = reader->height();
+    
+    PageBuffer strip(pool, qint64(StripRows) * reader->rowBytes());
+    PageBuffer bits(pool, width);
+    if (strip.isNull() || bits.isNull()) {
+        result->error = "Out of memory for strip buffer";
+        return false;
+    }
+    uchar *data = strip.data();
+    
+    TiffG4Writer writer;
+    QString tempPath = result->outputPath + ".part";
+    if (!writer.open(tempPath, width, height, options.dpi)) {
+        result->error = writer.errorString();
+        QFile::remove(tempPath);
+        return false;
+    }
+    
+    int radius = options.dpi > 0 ? qMax(MinSauvolaRadius, options.dpi / SauvolaWindowDivisor) : 15;
+    QScopedPointer<SauvolaBinarizer> sauvola(threshold < 0 ? new SauvolaBinarizer(width, radius) : nullptr);
+    QScopedPointer<PagePreview> preview(options.previews ? new PagePreview(width, height, 1) : nullptr);
+    bool written = true;
+    qint64 ink = 0;
+    qint64 samples = 0;
+    
+    int y = 0;
+    while (y < height && written) {
+        int rows = reader->readRows(data, StripRows);
+        if (rows <= 0) {
+            result->error = rows < 0 ? reader->errorString() : QString("Image data ended early");
+            QFile::remove(tempPath);
+            return false;
+        }
+        if (reader->channels() == 3) {
+            StripOps::rgbToGray(data, data, rows * width);
+        }
+        if (options.detectBlank) {
+            countStripInk(data, rows, y, width, height, &ink, &samples);
+        }
+        if (preview) {
+            preview->addRows(data, rows, width);
+        }
+        
+        // Sauvola 输出比输入滞后窗口半径行，每输入一行取完可输出的行
+        for (int row = 0; row < rows && written; ++row) {
+            const uchar *gray = data + qint64(row) * width;
+            if (sauvola) {
+                sauvola->pushRow(gray);
+                while (written && sauvola->takeRow(bits.data())) {
+                    written = writer.writeRows(bits.data(), 1, width);
+                }
+            } else {
+                BitonalOps::threshold(gray, bits.data(), width, threshold);
+                written = writer.writeRows(bits.data(), 1, width);
+            }
+        }
+        y += rows;
+    }
+    if (sauvola) {
+        sauvola->finish();
+        while (written && sauvola->takeRow(bits.data())) {
+            written = writer.writeRows(bits.data(), 1, width);
+        }
+    }
+    
+    if (!written || !writer.finish()) {
+        result->error = writer.errorString();
+        QFile::remove(tempPath);
+        return false;
+    }
+    if (options.detectBlank) {
+        result->inkRatio = samples > 0 ? double(ink) / samples : 0;
+        result->blank = result->inkRatio < options.blankInkRatio;
+    }
+    if (!replaceOutput(tempPath, result, options.layout.isValid())) {
+        return false;
+    }
+    if (preview) {
+        savePreview(*preview, result->outputPath);
+    }
+    return true;
+}
+
+// 整页处理：PNG/TIFF 等没有条带读写器的格式
+bool processImage(const PageProcessOptions &options, const QString &format, bool rewrite, PageResult *result)
+{
+    QImageReader reader(result->sourcePath);
+    QImage image = reader.read();
+    if (image.isNull()) {
+        result->error = reader.errorString();
+        return false;
+    }
+    
+    if (options.detectBlank) {
+        result->inkRatio = inkRatio(image);
+        result->blank = result->inkRatio < options.blankInkRatio;
+    }
+    if (options.grayscale && image.format() != QImage::Format_Grayscale8) {
+        image = image.convertToFormat(QImage::Format_Grayscale8);
+    }
+    
+    QString error;
+    if (options.previews && !PagePreview::saveImage(result->outputPath, image, &error)) {
+        qDebug() << "预览生成失败:" << result->outputPath << error;
+    }
+    if (!rewrite) {
+        return true;
+    }
+    
+    // 先写临时文件再替换，上传方不会读到写了一半的图像
+    QString tempPath = result->outputPath + ".part";
+    QImageWriter writer(tempPath, format.toLatin1());
+    writer.setQuality(options.quality);
+    if (!writer.write(image)) {
+        result->error = writer.errorString();
+        QFile::remove(tempPath);
+        return false;
+    }
+    return replaceOutput(tempPath, result, options.layout.isValid());
+}
+}
+
+PageProcessor::PageProcessor(QObject *parent)
+    : QObject(parent),
+      m_pool(new QThreadPool(this)),
+      m_bufferPool(nullptr),
+      m_pending(0)
+{
+    qRegisterMetaType<PageResult>("PageResult");
+    
+    // RK3566 为4核，按实际核数创建线程
+    m_pool->setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+PageProcessor::~PageProcessor()
+{
+    // 等待正在处理的页面写完，避免留下半个文件
+    m_pool->clear();
+    m_pool->waitForDone();
+}
+
+void PageProcessor::submit(const QString &deviceName, const QString &filePath, const PageProcessOptions &options)
+{
+    ++m_pending;
+    m_pool->start(new PageTask(this, deviceName, filePath, options, m_bufferPool));
+}
+
+int PageProcessor::maxThreadCount() const
+{
+    return m_pool->maxThreadCount();
+}
+
+void PageProcessor::setMaxThreadCount(int count)
+{
+    m_pool->setMaxThreadCount(qMax(1, count));
+}
+
+bool PageProcessor::waitForDone(int msecs)
+{
+    return m_pool->waitForDone(msecs);
+}
+
+void PageProcessor::onPageFinished(const QString &deviceName, const PageResult &result)
+{
+    if (!result.ok) {
+        qDebug() << "页面后处理失败:" << result.sourcePath << result.error;
+    }
+    
+    emit pageProcessed(deviceName, result);
+    if (--m_pending == 0) {
+        emit allPagesProcessed();
+    }
+}
+
+PageResult PageProcessor::processPage(const QString &filePath, const PageProcessOptions &options,
+                                      PageBufferPool *pool)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    PageResult result;
+    result.sourcePath = filePath;
+    
+    // 只检测不转换时不必重新编码；二值化固定输出 G4 TIFF
+    const bool bitonal = !options.binarization.isEmpty();
+    const bool geometry = options.deskew || options.autoCrop;
+    bool rewrite = bitonal || geometry || options.grayscale || !options.format.isEmpty();
+    QString format = bitonal ? QString("tiff") : outputFormat(filePath, options);
+    result.outputPath = rewrite ? outputPathFor(filePath, format) : filePath;
+    
+    // JPEG/PNM 输入且输出为 JPEG（或不重新编码）时按条带处理，其余格式整页处理（不纠偏裁边）；
+    // 二值化总是逐行进行，其他格式整页读入后按行送入
+    QScopedPointer<StripReader> reader;
+    if (bitonal || !rewrite || format == "jpeg") {
+        reader.reset(openStripReader(filePath, bitonal));
+    }
+    
+    // 纠偏裁边：先读一遍缩略图求角度和裁剪区域，之后每次打开源文件都经过纠偏读取器；
+    // 不需要旋转也不需要裁剪时像素不变，没有其他改变像素的处理就不重新编码
+    DeskewParams deskew;
+    if (reader && geometry) {
+        deskew = Deskew::analyze(reader.data(), options.dpi, options.deskew, options.autoCrop, pool);
+        result.skewAngle = deskew.angle;
+        reader.reset(openPageReader(filePath, bitonal, deskew, pool));
+    }
+    if (geometry && !deskew.valid) {
+        rewrite = bitonal || options.grayscale || !options.format.isEmpty();
+        result.outputPath = rewrite ? outputPathFor(filePath, format) : filePath;
+    }
+    
+    // Otsu 需要整页直方图：先读一遍求阈值，再重新打开源文件二值化
+    int threshold = -1;
+    if (reader && bitonal && options.binarization.compare("otsu", Qt::CaseInsensitive) == 0) {
+        threshold = chooseThreshold(reader.data(), pool);
+        reader.reset(openPageReader(filePath, bitonal, deskew, pool));
+    }
+    
+    // 有字节预算时先在代理图上选择质量，再重新打开源文件正式编码
+    PageProcessOptions actualOptions = options;
+    if (reader && rewrite && !bitonal && options.targetBytes > 0) {
+        actualOptions.quality = chooseQuality(reader.data(), options, pool);
+        reader.reset(openPageReader(filePath, bitonal, deskew, pool));
+    }
+    if (bitonal && !reader) {
+        result.error = "Cannot read " + filePath;
+        result.outputPath = filePath;
+        return result;
+    }
+    if (rewrite && format == "jpeg") {
+        result.quality = actualOptions.quality;
+    }
+    
+    bool ok = false;
+    if (bitonal) {
+        ok = processBitonal(reader.data(), actualOptions, threshold, pool, &result);
+    } else {
+        ok = reader ? processStrips(reader.data(), actualOptions, rewrite, pool, &result)
+                    : processImage(actualOptions, format, rewrite, &result);
+    }
+    if (!ok) {
+        result.outputPath = filePath;
+        return result;
+    }
+    
+    result.ok = true;
+    result.bytes = QFileInfo(result.outputPath).size();
+    
+    // 整页保留在本地备查，上传改为答题区域拼图；提取完成后删除保留的源文件
+    if (options.layout.isValid()) {
+        if (!result.blank) {
+            extractRegions(options, deskew, pool, &result);
+        }
+        const QString keptSource = keptSourcePath(result);
+        if (keptSource != result.outputPath) {
+            QFile::remove(keptSource);
+        }
+    }
+    result.elapsedMs = timer.elapsed();
+    // 每页一行摘要；纠偏角度、客观题等结果随 PageResult 返回，区域提取另有日志
+    qDebug() << "页面后处理:" << QFileInfo(filePath).fileName() << "耗时(ms):" << result.elapsedMs
+             << "大小:" << result.bytes;
+    return result;
+}
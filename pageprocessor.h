@@ -0,0 +1,88 @@
+#ifndef PAGEPROCESSOR_H
+#define PAGEPROCESSOR_H
+
+#include <QObject>
+#include <QString>
+#include <QMetaType>
+#include "examlayout.h"
+
+class QThreadPool;
+class PageBufferPool;
+
+// 单页后处理选项
+struct PageProcessOptions
+{
+    bool detectBlank = true;
+    double blankInkRatio = 0.002;   // 深色像素比例低于该值视为空白页
+    bool grayscale = false;         // 转为8位灰度
+    QString format;                 // 输出格式（jpeg/png/tiff），空表示保持原格式
+    int quality = 85;               // JPEG 质量
+    qint64 targetBytes = 0;         // 每页字节预算，>0 时在 [minQuality, maxQuality] 内自动选择质量
+    int minQuality = 40;            // 低于该质量手写笔迹开始模糊，预算不足时也不再降低
+    int maxQuality = 90;
+    QString binarization;           // 二值化方法（otsu/sauvola），非空时输出 CCITT G4 压缩的黑白 TIFF
+    int dpi = 0;                    // 写入输出文件的分辨率，Sauvola 窗口也按分辨率换算
+    bool deskew = false;            // 按投影轮廓估计进纸歪斜并旋转纠正（±5度以内）
+    bool autoCrop = false;          // 裁掉纸张以外的扫描区域（A3 扫描区域中的 A4 答题卡）
+    bool previews = false;          // 生成 1/8、1/32 预览图（PagePreview），本地翻看不必解码整页
+    SheetLayout layout;             // 答题卡版面：有效时按定位标记配准，裁出答题区域另存为拼图、识别客观题
+};
+
+// 单页处理结果
+struct PageResult
+{
+    bool ok = false;
+    QString sourcePath;
+    QString outputPath;
+    bool blank = false;
+    double inkRatio = 0;
+    int quality = 0;                // 实际使用的 JPEG 质量（重新编码时）
+    double skewAngle = 0;           // 纠偏角度（度）
+    qint64 bytes = 0;               // 输出文件大小
+    QString regionPath;             // 答题区域拼图（JPEG），为空表示未提取，上传整页
+    QString manifestPath;           // 清单（JSON）：各区域位置、配准结果和客观题答案
+    int objectiveAnswers = 0;       // 本机识别的客观题数
+    int uncertainAnswers = 0;       // 其中需人工复核的题数（多涂、涂得太浅）
+    qint64 elapsedMs = 0;
+    QString error;
+};
+Q_DECLARE_METATYPE(PageResult)
+
+// 扫描后处理线程池：每页一个任务，线程数与CPU核数一致，结果在调用线程通过信号返回
+class PageProcessor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PageProcessor(QObject *parent = nullptr);
+    ~PageProcessor();
+
+    // 提交一页，处理完成后发出 pageProcessed（可能与提交顺序不同）
+    void submit(const QString &deviceName, const QString &filePath, const PageProcessOptions &options);
+    int pendingCount() const { return m_pending; }
+    
+    int maxThreadCount() const;
+    void setMaxThreadCount(int count);
+    bool waitForDone(int msecs = -1);
+    
+    // 条带缓冲区从缓冲池借用（缓冲池由调用方持有，须比处理器存活更久）
+    void setBufferPool(PageBufferPool *pool) { m_bufferPool = pool; }
+    
+    // 在工作线程中执行，只使用局部数据和线程安全的缓冲池
+    static PageResult processPage(const QString &filePath, const PageProcessOptions &options,
+                                  PageBufferPool *pool = nullptr);
+
+signals:
+    void pageProcessed(const QString &deviceName, const PageResult &result);
+    void allPagesProcessed();
+
+private slots:
+    void onPageFinished(const QString &deviceName, const PageResult &result);
+
+private:
+    QThreadPool *m_pool;
+    PageBufferPool *m_bufferPool;
+    int m_pending;
+};
+
+#endif // PAGEPROCESSOR_H
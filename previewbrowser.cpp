@@ -0,0 +1,120 @@
+#include "previewbrowser.h"
+#include "pagepreview.h"
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsPixmapItem>
+#include <QPixmapCache>
+#include <QKeyEvent>
+#include <QWheelEvent>
+#include <QFileInfo>
+#include <QLabel>
+#include <QDebug>
+
+PreviewBrowser::PreviewBrowser(QGraphicsView *view, QObject *parent)
+    : QObject(parent),
+      m_view(view),
+      m_scene(new QGraphicsScene(this)),
+      m_item(new QGraphicsPixmapItem),
+      m_current(-1)
+{
+    m_scene->addItem(m_item);
+    m_item->setTransformationMode(Qt::SmoothTransformation);
+    m_view->setScene(m_scene);
+    m_view->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    m_view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    m_view->setFocusPolicy(Qt::StrongFocus);
+    m_view->installEventFilter(this);
+    m_view->viewport()->installEventFilter(this);
+}
+
+void PreviewBrowser::clear()
+{
+    m_pages.clear();
+    m_current = -1;
+    m_item->setPixmap(QPixmap());
+    m_view->setToolTip(QString());
+}
+
+void PreviewBrowser::addPage(const QString &pagePath)
+{
+    // 同一页面重新处理（如续扫替换）时只刷新显示
+    int index = m_pages.indexOf(pagePath);
+    if (index < 0) {
+        m_pages.append(pagePath);
+        index = m_pages.size() - 1;
+    }
+    QPixmapCache::remove(PagePreview::previewPath(pagePath, PagePreview::SmallScale));
+    showPage(index);
+}
+
+void PreviewBrowser::showPage(int index)
+{
+    if (index < 0 || index >= m_pages.size()) {
+        return;
+    }
+    m_current = index;
+    const QString pagePath = m_pages.at(index);
+
+    // 小图读一次后留在缓存中，来回翻页不再读盘
+    const QString key = PagePreview::previewPath(pagePath, PagePreview::SmallScale);
+    QPixmap pixmap;
+    if (!QPixmapCache::find(key, &pixmap)) {
+        pixmap = QPixmap::fromImage(PagePreview::load(pagePath, PagePreview::SmallScale));
+        QPixmapCache::insert(key, pixmap);
+    }
+
+    m_item->setPixmap(pixmap);
+    m_scene->setSceneRect(m_item->boundingRect());
+    m_view->fitInView(m_item, Qt::KeepAspectRatio);
+    m_view->setToolTip(QString("%1 (%2/%3)").arg(QFileInfo(pagePath).fileName()).arg(index + 1).arg(m_pages.size()));
+}
+
+void PreviewBrowser::openLargePreview(const QString &pagePath)
+{
+    QImage image = PagePreview::load(pagePath, PagePreview::LargeScale);
+    if (image.isNull()) {
+        qDebug() << "无法读取页面预览:" << pagePath;
+        return;
+    }
+    QLabel *label = new QLabel;
+    label->setAttribute(Qt::WA_DeleteOnClose);
+    label->setWindowTitle(QFileInfo(pagePath).fileName());
+    label->setPixmap(QPixmap::fromImage(image));
+    label->show();
+}
+
+bool PreviewBrowser::eventFilter(QObject *watched, QEvent *event)
+{
+    if (m_pages.isEmpty()) {
+        return QObject::eventFilter(watched, event);
+    }
+
+    switch (event->type()) {
+    case QEvent::Wheel: {
+        QWheelEvent *wheel = static_cast<QWheelEvent*>(event);
+        showPage(m_current + (wheel->angleDelta().y() > 0 ? -1 : 1));
+        return true;
+    }
+    case QEvent::KeyPress: {
+        QKeyEvent *key = static_cast<QKeyEvent*>(event);
+        if (key->key() == Qt::Key_Left || key->key() == Qt::Key_PageUp) {
+            showPage(m_current - 1);
+            return true;
+        }
+        if (key->key() == Qt::Key_Right || key->key() == Qt::Key_PageDown) {
+            showPage(m_current + 1);
+            return true;
+        }
+        break;
+    }
+    case QEvent::MouseButtonDblClick:
+        openLargePreview(m_pages.value(m_current));
+        return true;
+    case QEvent::Resize:
+        m_view->fitInView(m_item, Qt::KeepAspectRatio);
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
@@ -0,0 +1,39 @@
+#ifndef PREVIEWBROWSER_H
+#define PREVIEWBROWSER_H
+
+#include <QObject>
+#include <QStringList>
+
+class QGraphicsView;
+class QGraphicsScene;
+class QGraphicsPixmapItem;
+
+// 扫描页面浏览：在 graphicsView 中显示 1/32 预览，滚轮或左右方向键翻页，双击打开 1/8 预览
+class PreviewBrowser : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PreviewBrowser(QGraphicsView *view, QObject *parent = nullptr);
+
+    // 新批次开始时清空；新页面加入后自动显示最新一页
+    void clear();
+    void addPage(const QString &pagePath);
+    void showPage(int index);
+    int pageCount() const { return m_pages.size(); }
+    int currentIndex() const { return m_current; }
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    QGraphicsView *m_view;
+    QGraphicsScene *m_scene;
+    QGraphicsPixmapItem *m_item;
+    QStringList m_pages;
+    int m_current;
+
+    void openLargePreview(const QString &pagePath);
+};
+
+#endif // PREVIEWBROWSER_H
@@ -1,19 +1,71 @@
 #include "printmanager.h"
+#include "processwatchdog.h"
+#include "ippclient.h"
 #include <QDebug>
+#include <QFile>
 #include <QFileInfo>
+#include <QDateTime>
 #include <QRegularExpression>
 #include <QProcess>
 #include <QTimer>
 #include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QThreadPool>
+#include <QRunnable>
+#include <algorithm>
+
+namespace {
+const int ProcessStartTimeout = 10000;   // 进程启动期限
+const int SubmitTimeout = 120000;        // lp 提交一个文件的期限
+const int StreamIdleTimeout = 60000;     // 流式打印无数据写入的期限
+const int QueryTimeout = 15000;          // lpstat 查询期限
+const qint64 StreamHighWater = 1024 * 1024;  // lp 标准输入积压超过该值时暂停下载
+const qint64 StreamLowWater = 256 * 1024;    // 积压降到该值以下时恢复
+const int JobTrackInterval = 5000;       // 已提交任务的队列查询间隔
+
+// 纸张对应的lp选项；A3 试卷按原尺寸铺满纸张
+QStringList mediaOptions(const QString &media)
+{
+    QStringList options;
+    options << "-o" << "media=" + media;
+    if (media == "A3") {
+        options << "-o" << "fit-to-page";
+        options << "-o" << "scaling=100";
+    }
+    return options;
+}
+}
 
 PrintManager::PrintManager(QObject *parent)
     : QObject(parent),
-      m_simulationMode(false)
+      m_preflightPool(new QThreadPool(this)),
+      m_maxPagesPerJob(40),
+      m_simulationMode(false),
+      m_watchdog(new ProcessWatchdog(this)),
+      m_jobTrackTimer(new QTimer(this))
 {
+    qRegisterMetaType<PdfPreflight>("PdfPreflight");
+    m_preflightPool->setMaxThreadCount(1);
+    
+    // 有已提交、尚未打印完的任务时定期查询打印队列
+    m_jobTrackTimer->setInterval(JobTrackInterval);
+    connect(m_jobTrackTimer, &QTimer::timeout, this, [this]() {
+        for (const QString &deviceName : m_trackedJobs.keys()) {
+            getPrintJobs(deviceName);
+        }
+    });
 }
 
 PrintManager::~PrintManager()
 {
+    // 退出时直接结束所有外部进程，不等待其响应
+    for (QProcess *process : m_printProcesses.values() + m_streamProcesses.values()) {
+        process->disconnect(this);
+        process->kill();
+    }
+    m_preflightPool->clear();
+    m_preflightPool->waitForDone();
 }
 
 
@@ -24,13 +76,37 @@ void PrintManager::setPrintSettings(const QString &deviceName, int copies, const
     m_printMedia[deviceName] = media;
     m_printSides[deviceName] = sides;
     
+    // 设置变化后重新生成模板
+    m_optionTemplates.remove(deviceName);
+    
+    // 提前读取打印机能力，提交任务时不必等待
+    loadPrintCapabilities(deviceName);
+    
     qDebug() << "设置打印参数，设备:" << deviceName 
              << "份数:" << copies 
              << "纸张:" << media 
              << "双面:" << sides;
 }
 
-QStringList PrintManager::buildPrintOptions(const QString &deviceName)
+QStringList PrintManager::buildPrintOptions(const QString &deviceName, int copies)
+{
+    // 份数只在这里添加；未指定时使用设备设置
+    if (copies <= 0) {
+        copies = m_printCopies.value(deviceName, 1);
+    }
+    
+    // 模板已存在时直接复制（QStringList为隐式共享，复制开销很小）
+    auto cached = m_optionTemplates.constFind(deviceName);
+    QStringList options = cached != m_optionTemplates.constEnd() ? cached.value()
+                                                                 : buildOptionTemplate(deviceName);
+    if (copies > 1) {
+        options << "-n" << QString::number(copies);
+        options << "-o" << "collate=true";
+    }
+    return options;
+}
+
+QStringList PrintManager::buildOptionTemplate(const QString &deviceName)
 {
     QStringList options;
     
@@ -38,17 +114,11 @@ QStringList PrintManager::buildPrintOptions(const QString &deviceName)
     options << "-d" << deviceName;
     
     // 获取该设备的打印设置
-    int copies = m_printCopies.value(deviceName, 1);
     QString media = m_printMedia.value(deviceName, "A4");
     QString sides = m_printSides.value(deviceName, "two-sided-long-edge");
     
-    // 打印份数
-    if (copies > 1) {
-        options << "-n" << QString::number(copies);
-    }
-    
-    // 纸张大小设置
-    options << "-o" << "media=" + media;
+    // 纸张大小设置（A3 另加铺满纸张的选项）
+    options << mediaOptions(media);
     
     // 双面打印设置
     if (sides == "two-sided-long-edge") {
@@ -59,20 +129,212 @@ QStringList PrintManager::buildPrintOptions(const QString &deviceName)
         options << "-o" << "sides=one-sided";
     }
     
-    // 特殊纸张设置
-    if (media == "A3") {
-        // A3纸张的特殊设置
-        options << "-o" << "fit-to-page";
-        options << "-o" << "scaling=100";
+    m_optionTemplates.insert(deviceName, options);
+    return options;
+}
+
+QStringList PrintManager::advancedOptionTemplate(const QString &deviceName, const QString &media,
+                                                 const QString &sides, int resolution, int printQuality)
+{
+    QString key = QString("%1|%2|%3|%4|%5").arg(deviceName, media, sides)
+                  .arg(resolution).arg(printQuality);
+    
+    auto cached = m_advancedTemplates.constFind(key);
+    if (cached != m_advancedTemplates.constEnd()) {
+        return cached.value();
     }
     
+    QStringList options;
+    options << "-d" << deviceName;
+    options << mediaOptions(media);
+    options << "-o" << "sides=" + sides;
+    options << "-o" << QString("printer-resolution=%1dpi").arg(resolution);
+    options << "-o" << QString("print-quality=%1").arg(printQuality);
+    
+    m_advancedTemplates.insert(key, options);
     return options;
 }
 
+PrintCapabilities PrintManager::getPrintCapabilities(const QString &deviceName)
+{
+    // 尚未读取时先按未知能力处理（不做检查），读取完成后再生效
+    if (!m_printCapabilities.contains(deviceName)) {
+        loadPrintCapabilities(deviceName);
+    }
+    return m_printCapabilities.value(deviceName);
+}
+
+void PrintManager::loadPrintCapabilities(const QString &deviceName)
+{
+    if (m_printCapabilities.contains(deviceName) || m_loadingCapabilities.contains(deviceName)) {
+        return;
+    }
+    if (m_simulationMode) {
+        m_printCapabilities[deviceName] = PrintCapabilities();
+        return;
+    }
+    
+    // lpoptions -l 列出PPD选项，格式如 "PageSize/Media Size: *A4 A3 Letter"；异步读取，不阻塞界面线程
+    m_loadingCapabilities.insert(deviceName);
+    QProcess *process = new QProcess(this);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this, process, deviceName](int exitCode, QProcess::ExitStatus exitStatus) {
+        PrintCapabilities caps;
+        if (exitCode == 0 && exitStatus == QProcess::NormalExit) {
+            caps = parsePrintCapabilities(process->readAllStandardOutput());
+            qDebug() << "打印机能力:" << deviceName << "纸张:" << caps.media
+                     << "双面:" << caps.sides << "分辨率:" << caps.resolutions << "质量:" << caps.qualities;
+        } else {
+            qDebug() << "无法读取打印机能力:" << deviceName;
+        }
+        process->deleteLater();
+        setPrintCapabilities(deviceName, caps);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this, process, deviceName](QProcess::ProcessError error) {
+        // 启动失败不会发出 finished
+        if (error == QProcess::FailedToStart) {
+            qDebug() << "无法读取打印机能力:" << deviceName;
+            process->deleteLater();
+            setPrintCapabilities(deviceName, PrintCapabilities());
+        }
+    });
+    m_watchdog->watch(process, "lpoptions " + deviceName, ProcessStartTimeout, QueryTimeout);
+    process->start("lpoptions", QStringList() << "-p" << deviceName << "-l");
+}
+
+void PrintManager::setPrintCapabilities(const QString &deviceName, const PrintCapabilities &caps)
+{
+    m_loadingCapabilities.remove(deviceName);
+    m_printCapabilities[deviceName] = caps;
+    emit printCapabilitiesLoaded(deviceName);
+    
+    // 等待能力的请求按收到的顺序校验提交；读取失败时能力无效，只做基本检查
+    const QList<AdvancedPrintRequest> waiting = m_capabilityWaiters.take(deviceName);
+    for (const AdvancedPrintRequest &request : waiting) {
+        printFileAdvanced(deviceName, request.filePath, request.media, request.sides,
+                          request.resolution, request.printQuality, request.copies, request.jobName);
+    }
+}
+
+PrintCapabilities PrintManager::parsePrintCapabilities(const QString &output)
+{
+    PrintCapabilities caps;
+    QStringList lines = output.split('\n', QString::SkipEmptyParts);
+    
+    for (const QString &line : lines) {
+        int colon = line.indexOf(':');
+        if (colon < 0) continue;
+        
+        QString option = line.left(colon).section('/', 0, 0).trimmed();
+        QStringList values = line.mid(colon + 1).split(' ', QString::SkipEmptyParts);
+        for (QString &value : values) {
+            if (value.startsWith('*')) value.remove(0, 1);
+        }
+        
+        if (option == "PageSize" || option == "media") {
+            caps.media = values;
+        } else if (option == "Duplex" || option == "sides") {
+            caps.sides << "one-sided";
+            for (const QString &value : values) {
+                if (value == "DuplexNoTumble" || value == "two-sided-long-edge") {
+                    caps.sides << "two-sided-long-edge";
+                } else if (value == "DuplexTumble" || value == "two-sided-short-edge") {
+                    caps.sides << "two-sided-short-edge";
+                }
+            }
+        } else if (option == "Resolution") {
+            QRegularExpression dpiRegex("^(\\d+)");
+            for (const QString &value : values) {
+                QRegularExpressionMatch match = dpiRegex.match(value);
+                if (match.hasMatch()) caps.resolutions << match.captured(1).toInt();
+            }
+        } else if (option == "cupsPrintQuality" || option == "print-quality") {
+            for (const QString &value : values) {
+                if (value == "Draft" || value == "3") caps.qualities << 3;
+                else if (value == "Normal" || value == "4") caps.qualities << 4;
+                else if (value == "High" || value == "5") caps.qualities << 5;
+            }
+        }
+    }
+    
+    caps.valid = !caps.media.isEmpty();
+    return caps;
+}
+
+bool PrintManager::validatePrintOptions(const QString &deviceName, const QString &media, const QString &sides,
+                                        int resolution, int printQuality, int copies, QString *error)
+{
+    QString message;
+    
+    if (copies < 1 || copies > 999) {
+        message = QString("Invalid copies: %1").arg(copies);
+    } else if (printQuality < 3 || printQuality > 5) {
+        message = QString("Invalid print quality: %1").arg(printQuality);
+    } else if (resolution <= 0) {
+        message = QString("Invalid resolution: %1").arg(resolution);
+    } else if (sides != "one-sided" && sides != "two-sided-long-edge" && sides != "two-sided-short-edge") {
+        message = "Invalid sides: " + sides;
+    }
+    
+    // 能力已知时，按打印机实际支持的选项检查
+    PrintCapabilities caps = getPrintCapabilities(deviceName);
+    if (message.isEmpty() && caps.valid) {
+        if (!caps.media.contains(media, Qt::CaseInsensitive)) {
+            message = "Unsupported media: " + media;
+        } else if (!caps.sides.isEmpty() && !caps.sides.contains(sides)) {
+            message = "Unsupported sides: " + sides;
+        } else if (!caps.resolutions.isEmpty() && !caps.resolutions.contains(resolution)) {
+            message = QString("Unsupported resolution: %1").arg(resolution);
+        } else if (!caps.qualities.isEmpty() && !caps.qualities.contains(printQuality)) {
+            message = QString("Unsupported print quality: %1").arg(printQuality);
+        }
+    }
+    
+    if (error) {
+        *error = message;
+    }
+    return message.isEmpty();
+}
+
+void PrintManager::clampPrintOptions(const QString &deviceName, QString *sides, int *resolution,
+                                     int *printQuality, int *copies)
+{
+    *copies = qBound(1, *copies, 999);
+    *printQuality = qBound(3, *printQuality, 5);
+    
+    PrintCapabilities caps = getPrintCapabilities(deviceName);
+    if (!caps.valid) {
+        return;
+    }
+    
+    // 不支持双面的打印机退回单面
+    if (!caps.sides.isEmpty() && !caps.sides.contains(*sides)) {
+        *sides = caps.sides.contains("two-sided-long-edge") ? "two-sided-long-edge" : "one-sided";
+    }
+    
+    // 分辨率和质量取最接近的可用值
+    if (!caps.resolutions.isEmpty() && !caps.resolutions.contains(*resolution)) {
+        int best = caps.resolutions.first();
+        for (int value : caps.resolutions) {
+            if (qAbs(value - *resolution) < qAbs(best - *resolution)) best = value;
+        }
+        qDebug() << "打印分辨率已校正:" << deviceName << *resolution << "->" << best;
+        *resolution = best;
+    }
+    if (!caps.qualities.isEmpty() && !caps.qualities.contains(*printQuality)) {
+        int best = caps.qualities.first();
+        for (int value : caps.qualities) {
+            if (qAbs(value - *printQuality) < qAbs(best - *printQuality)) best = value;
+        }
+        *printQuality = best;
+    }
+}
+
 bool PrintManager::printFile(const QString &deviceName, const QString &filePath, const QString &jobName)
 {
+    QString actualJobName = jobName.isEmpty() ? QFileInfo(filePath).fileName() : jobName;
     if (!QFile::exists(filePath)) {
-        emit printError(deviceName, "File does not exist: " + filePath);
+        failPrintJob(deviceName, actualJobName, "File does not exist: " + filePath);
         return false;
     }
     
@@ -81,47 +343,1009 @@ bool PrintManager::printFile(const QString &deviceName, const QString &filePath,
     // 添加文件名
     args << filePath;
     
-    qDebug() << "Starting print with command: lp" << args;
+    return submitPrintJob(deviceName, args, actualJobName);
+}
+
+bool PrintManager::printFileWithOptions(const QString &deviceName, const QString &filePath, const QStringList &options)
+{
+    if (!QFile::exists(filePath)) {
+        failPrintJob(deviceName, QFileInfo(filePath).fileName(), "File does not exist: " + filePath);
+        return false;
+    }
     
-    QProcess *process = getOrCreatePrintProcess(deviceName);
-    process->start("lp", args);
+    QStringList args = buildPrintOptions(deviceName);
+    args.append(options);
+    args << filePath;
+    
+    return submitPrintJob(deviceName, args, QFileInfo(filePath).fileName());
+}
+
+
+
+bool PrintManager::beginPrintStream(const QString &deviceName, const QString &streamId, const QString &jobName,
+                                    int copies)
+{
+    QString actualJobName = jobName.isEmpty() ? streamId : jobName;
+    if (m_streamProcesses.contains(streamId)) {
+        failPrintJob(deviceName, actualJobName, "Print stream already open: " + streamId);
+        return false;
+    }
     
-    if (process->waitForStarted()) {
-        QString actualJobName = jobName.isEmpty() ? QFileInfo(filePath).fileName() : jobName;
+    // IPP 设备：Print-Job 需要完整的文档，先写入临时文件，结束时从文件流式提交，不占用内存
+    if (m_ippClients.contains(deviceName)) {
+        if (m_ippStreamFiles.contains(streamId)) {
+            failPrintJob(deviceName, actualJobName, "Print stream already open: " + streamId);
+            return false;
+        }
+        QTemporaryFile *file = new QTemporaryFile(this);
+        if (!file->open()) {
+            delete file;
+            failPrintJob(deviceName, actualJobName, "Cannot create print stream file: " + streamId);
+            return false;
+        }
+        m_ippStreamFiles[streamId] = file;
+        m_ippStreamCopies[streamId] = copies;
+        m_streamDevices[streamId] = deviceName;
+        m_streamJobNames[streamId] = actualJobName;
         emit printStarted(deviceName, actualJobName);
         return true;
+    }
+    
+    // 不指定文件时lp从标准输入读取文档，边接收边提交给CUPS
+    QStringList args = buildPrintOptions(deviceName, copies);
+    args << "-t" << actualJobName;
+    
+    qDebug() << "Starting print stream with command: lp" << args;
+    
+    QProcess *process = new QProcess(this);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &PrintManager::onStreamProcessFinished);
+    connect(process, &QProcess::started, this, [this, deviceName, actualJobName]() {
+        emit printStarted(deviceName, actualJobName);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this, process, streamId](QProcess::ProcessError error) {
+        // 启动失败不会发出 finished，在这里关闭流
+        if (error == QProcess::FailedToStart && m_streamProcesses.value(streamId) == process) {
+            QString deviceName = m_streamDevices.take(streamId);
+            QString jobName = m_streamJobNames.take(streamId);
+            m_streamProcesses.remove(streamId);
+            process->deleteLater();
+            failPrintJob(deviceName, jobName, "Failed to start print stream process");
+        }
+    });
+    
+    // 数据写入中断（下载停滞）超过期限时终止lp，CUPS丢弃不完整的文档
+    // lp 读得比下载慢时写入缓冲会积压：超过上限通知暂停下载，消化到下限以下再恢复
+    connect(process, &QProcess::bytesWritten, this, [this, process, streamId](qint64) {
+        if (m_throttledStreams.contains(streamId) && process->bytesToWrite() < StreamLowWater) {
+            m_throttledStreams.remove(streamId);
+            emit printStreamBackpressure(streamId, false);
+        }
+    });
+    
+    m_streamProcesses[streamId] = process;
+    m_streamDevices[streamId] = deviceName;
+    m_streamJobNames[streamId] = actualJobName;
+    m_watchdog->watch(process, "lp stream " + deviceName, ProcessStartTimeout, 0, StreamIdleTimeout);
+    process->start("lp", args);
+    return true;
+}
+
+void PrintManager::writePrintStream(const QString &streamId, const QByteArray &data)
+{
+    if (QTemporaryFile *file = m_ippStreamFiles.value(streamId)) {
+        if (file->write(data) != data.size()) {
+            discardIppStream(streamId, "Cannot write print stream file: " + file->errorString());
+        }
+        return;
+    }
+    
+    QProcess *process = m_streamProcesses.value(streamId, nullptr);
+    if (!process) {
+        qDebug() << "Print stream not open:" << streamId;
+        return;
+    }
+    
+    process->write(data);
+    if (process->bytesToWrite() > StreamHighWater && !m_throttledStreams.contains(streamId)) {
+        m_throttledStreams.insert(streamId);
+        emit printStreamBackpressure(streamId, true);
+    }
+}
+
+void PrintManager::endPrintStream(const QString &streamId)
+{
+    if (m_ippStreamFiles.contains(streamId)) {
+        QString deviceName = m_streamDevices.value(streamId);
+        IppClient *client = m_ippClients.value(deviceName);
+        QTemporaryFile *file = m_ippStreamFiles.value(streamId);
+        if (!client) {
+            // 流式接收期间 IPP 地址被移除
+            discardIppStream(streamId, "IPP endpoint removed: " + deviceName);
+            return;
+        }
+        if (!file->flush()) {
+            discardIppStream(streamId, "Cannot write print stream file: " + file->errorString());
+            return;
+        }
+        
+        QString jobName = m_streamJobNames.take(streamId);
+        m_streamDevices.remove(streamId);
+        m_ippStreamFiles.remove(streamId);
+        
+        IppJobOptions options;
+        options.copies = m_ippStreamCopies.take(streamId);
+        options.collate = options.copies > 1;
+        options.media = m_printMedia.value(deviceName, "A4");
+        options.sides = m_printSides.value(deviceName);
+        
+        // 临时文件保留到提交结束（Create-Job 之后还要再读一次）
+        QString key = deviceName + "|" + QString::number(client->submitJobFile(jobName, file->fileName(), options));
+        m_ippSubmissionNames[key] = jobName;
+        m_ippSubmissionFiles[key] = file;
+        return;
+    }
+    
+    QProcess *process = m_streamProcesses.value(streamId, nullptr);
+    if (process) {
+        // 关闭标准输入，lp随后提交文档并退出
+        process->closeWriteChannel();
+    }
+}
+
+void PrintManager::abortPrintStream(const QString &streamId)
+{
+    if (m_ippStreamFiles.contains(streamId)) {
+        // 尚未发送给打印机，直接丢弃
+        discardIppStream(streamId, "Print stream aborted: " + streamId);
+        return;
+    }
+    
+    QProcess *process = m_streamProcesses.take(streamId);
+    QString deviceName = m_streamDevices.take(streamId);
+    QString jobName = m_streamJobNames.take(streamId);
+    m_throttledStreams.remove(streamId);
+    
+    if (process) {
+        // 未完整提交的文档会被CUPS丢弃
+        process->disconnect(this);
+        process->kill();
+        process->deleteLater();
+        failPrintJob(deviceName, jobName, "Print stream aborted: " + streamId);
+    }
+}
+
+void PrintManager::discardIppStream(const QString &streamId, const QString &error)
+{
+    delete m_ippStreamFiles.take(streamId);
+    m_ippStreamCopies.remove(streamId);
+    failPrintJob(m_streamDevices.take(streamId), m_streamJobNames.take(streamId), error);
+}
+
+void PrintManager::onStreamProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    QProcess *process = qobject_cast<QProcess*>(sender());
+    if (!process) return;
+    
+    QString streamId = m_streamProcesses.key(process);
+    QString deviceName = m_streamDevices.take(streamId);
+    QString jobName = m_streamJobNames.take(streamId);
+    m_streamProcesses.remove(streamId);
+    m_throttledStreams.remove(streamId);
+    
+    if (exitCode == 0 && exitStatus == QProcess::NormalExit) {
+        int jobId = extractJobId(process->readAllStandardOutput());
+        acceptPrintJob(deviceName, jobName, jobId);
     } else {
-        emit printError(deviceName, "Failed to start print process");
+        QString error = process->readAllStandardError();
+        failPrintJob(deviceName, jobName, "Print stream failed: " + error);
+    }
+    
+    process->deleteLater();
+}
+
+bool PrintManager::printFileAdvanced(const QString &deviceName, const QString &filePath,
+                                     const QString &media, const QString &sides,
+                                     int resolution, int printQuality, int copies,
+                                     const QString &jobName)
+{
+    QString actualJobName = jobName.isEmpty() ? QFileInfo(filePath).fileName() : jobName;
+    if (!QFile::exists(filePath)) {
+        failPrintJob(deviceName, actualJobName, "File does not exist: " + filePath);
         return false;
     }
+    
+    // 能力还在读取时先排队，读取完成后再校正和校验，不带着未检查的选项提交
+    if (!m_printCapabilities.contains(deviceName)) {
+        loadPrintCapabilities(deviceName);
+    }
+    if (!m_printCapabilities.contains(deviceName)) {
+        AdvancedPrintRequest request;
+        request.filePath = filePath;
+        request.media = media;
+        request.sides = sides;
+        request.resolution = resolution;
+        request.printQuality = printQuality;
+        request.copies = copies;
+        request.jobName = actualJobName;
+        m_capabilityWaiters[deviceName].append(request);
+        qDebug() << "等待打印机能力读取完成后提交:" << deviceName << actualJobName;
+        return true;
+    }
+    
+    // 可调整的选项先按打印机能力校正，仍无法满足的组合在提交前拒绝
+    QString actualSides = sides;
+    clampPrintOptions(deviceName, &actualSides, &resolution, &printQuality, &copies);
+    
+    QString error;
+    if (!validatePrintOptions(deviceName, media, actualSides, resolution, printQuality, copies, &error)) {
+        failPrintJob(deviceName, actualJobName, "Invalid print options: " + error);
+        return false;
+    }
+    
+    QStringList args = advancedOptionTemplate(deviceName, media, actualSides, resolution, printQuality);
+    if (copies > 1) {
+        args << "-n" << QString::number(copies);
+    }
+    
+    args << "-t" << actualJobName;
+    args << filePath;
+    
+    return submitPrintJob(deviceName, args, actualJobName);
 }
 
-bool PrintManager::printFileWithOptions(const QString &deviceName, const QString &filePath, const QStringList &options)
+bool PrintManager::printFileWithProfile(const QString &deviceName, const QString &filePath,
+                                        const QString &profile, int copies, const QString &jobName)
+{
+    PrintCapabilities caps = getPrintCapabilities(deviceName);
+    QString media = m_printMedia.value(deviceName, "A4");
+    QString sides = m_printSides.value(deviceName, "two-sided-long-edge");
+    int resolution = 300;
+    int quality = 4;
+    
+    if (profile == "draft") {
+        // 草稿方案：最低分辨率和草稿质量，适合大批量试卷
+        quality = 3;
+        if (!caps.resolutions.isEmpty()) {
+            resolution = *std::min_element(caps.resolutions.begin(), caps.resolutions.end());
+        }
+    } else if (profile == "high") {
+        quality = 5;
+        if (!caps.resolutions.isEmpty()) {
+            resolution = *std::max_element(caps.resolutions.begin(), caps.resolutions.end());
+        }
+    } else if (profile != "normal") {
+        failPrintJob(deviceName, jobName.isEmpty() ? QFileInfo(filePath).fileName() : jobName,
+                     "Unknown print profile: " + profile);
+        return false;
+    }
+    
+    // 打印机不支持的质量和分辨率由 printFileAdvanced 校正为最接近的可用值
+    return printFileAdvanced(deviceName, filePath, media, sides, resolution, quality, copies, jobName);
+}
+
+bool PrintManager::printCollated(const QString &deviceName, const QString &filePath, int copies,
+                                 const QString &jobName, bool separatorSheet)
 {
     if (!QFile::exists(filePath)) {
-        emit printError(deviceName, "File does not exist: " + filePath);
+        failPrintJob(deviceName, jobName, "File does not exist: " + filePath);
         return false;
     }
     
-    QStringList args = buildPrintOptions(deviceName);
-    args.append(options);
+    // 预检：损坏的文件在进入打印队列前拒绝（已由 preflightPdfAsync 预检的文件直接取缓存）
+    PdfPreflight preflight = preflightPdf(filePath);
+    if (!preflight.valid) {
+        failPrintJob(deviceName, jobName, "Preflight failed: " + preflight.error);
+        return false;
+    }
+    
+    QStringList args = buildPrintOptions(deviceName, copies);
+    
+    // 按文档实际纸张自动选择纸张和双面方式，只补充用户没有通过 setPrintSettings 指定的选项
+    // （识别出 A3 时同时加上铺满纸张的选项，与 setPrintSettings 指定 A3 时一致）
+    if (!preflight.media.isEmpty() && !m_printMedia.contains(deviceName)) {
+        args << mediaOptions(preflight.media);
+    }
+    QString sides = m_printSides.value(deviceName, preflight.sides);
+    if (!preflight.sides.isEmpty() && !m_printSides.contains(deviceName)) {
+        args << "-o" << "sides=" + preflight.sides;
+    }
+    
+    // 分隔页：在本任务前打印一张标题页，与上一个班级的试卷分开
+    if (separatorSheet) {
+        args << "-o" << "job-sheets=standard,none";
+    }
+    
+    // 单份的大文档拆成若干页段分别提交，打印机可以更早开始出纸
+    // 多份逐份打印时不拆分，以免打乱装订顺序
+    if (copies == 1 && preflight.pageCount > m_maxPagesPerJob) {
+        // 双面打印时每段保持偶数页，避免段与段之间共用一张纸
+        int chunk = m_maxPagesPerJob;
+        if (sides != "one-sided" && chunk % 2 != 0) {
+            chunk -= 1;
+        }
+        chunk = qMax(chunk, 2);
+        
+        int parts = (preflight.pageCount + chunk - 1) / chunk;
+        QStringList partNames;
+        for (int part = 0; part < parts; ++part) {
+            partNames << QString("%1_part%2of%3").arg(jobName).arg(part + 1).arg(parts);
+        }
+        // 先通知调用方各页段的任务名称，之后的提交结果按页段名称上报
+        emit printJobSplit(deviceName, jobName, partNames);
+        
+        bool ok = true;
+        for (int part = 0; part < parts; ++part) {
+            int first = part * chunk + 1;
+            int last = qMin(preflight.pageCount, first + chunk - 1);
+            const QString &partName = partNames.at(part);
+            
+            QStringList partArgs = args;
+            partArgs << "-o" << QString("page-ranges=%1-%2").arg(first).arg(last);
+            
+            // 分隔页只在第一段之前打印
+            if (part > 0 && separatorSheet) {
+                partArgs << "-o" << "job-sheets=none,none";
+            }
+            
+            partArgs << "-t" << partName;
+            partArgs << filePath;
+            ok = submitPrintJob(deviceName, partArgs, partName) && ok;
+        }
+        return ok;
+    }
+    
+    args << "-t" << jobName;
     args << filePath;
     
-    qDebug() << "Starting print with custom options: lp" << args;
+    return submitPrintJob(deviceName, args, jobName);
+}
+
+void PrintManager::setMaxPagesPerJob(int pages)
+{
+    m_maxPagesPerJob = qMax(pages, 2);
+}
+
+namespace {
+
+// 预检任务：在工作线程读取并解析整个文件，结果回到打印管理器所在线程
+class PreflightTask : public QRunnable
+{
+public:
+    PreflightTask(PrintManager *manager, const QString &filePath, qint64 modified)
+        : m_manager(manager), m_filePath(filePath), m_modified(modified)
+    {
+    }
+
+    void run() override
+    {
+        bool opened = false;
+        PdfPreflight result = PrintManager::readPdfPreflight(m_filePath, &opened);
+        
+        // 打印管理器析构时会等待任务结束
+        QMetaObject::invokeMethod(m_manager, "onPreflightFinished", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_filePath), Q_ARG(qint64, m_modified),
+                                  Q_ARG(bool, opened), Q_ARG(PdfPreflight, result));
+    }
+
+private:
+    PrintManager *m_manager;
+    QString m_filePath;
+    qint64 m_modified;
+};
+}
+
+PdfPreflight PrintManager::preflightPdf(const QString &filePath)
+{
+    QFileInfo info(filePath);
+    qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    
+    auto cached = m_preflightCache.constFind(filePath);
+    if (cached != m_preflightCache.constEnd() && cached.value().first == modified) {
+        return cached.value().second;
+    }
+    
+    bool opened = false;
+    PdfPreflight result = readPdfPreflight(filePath, &opened);
+    if (!opened) {
+        return result;
+    }
+    m_preflightCache.insert(filePath, qMakePair(modified, result));
+    
+    qDebug() << "PDF预检:" << filePath << "有效:" << result.valid << "页数:" << result.pageCount
+             << "纸张:" << result.media << "双面:" << result.sides << result.error;
+    return result;
+}
+
+void PrintManager::preflightPdfAsync(const QString &filePath)
+{
+    QFileInfo info(filePath);
+    qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    
+    auto cached = m_preflightCache.constFind(filePath);
+    if (cached != m_preflightCache.constEnd() && cached.value().first == modified) {
+        PdfPreflight result = cached.value().second;
+        QTimer::singleShot(0, this, [this, filePath, result]() {
+            emit pdfPreflighted(filePath, result);
+        });
+        return;
+    }
+    m_preflightPool->start(new PreflightTask(this, filePath, modified));
+}
+
+void PrintManager::onPreflightFinished(const QString &filePath, qint64 modified, bool opened,
+                                       const PdfPreflight &result)
+{
+    // 打不开的文件不缓存，下次重新读取
+    if (opened) {
+        m_preflightCache.insert(filePath, qMakePair(modified, result));
+    }
+    qDebug() << "PDF预检:" << filePath << "有效:" << result.valid << "页数:" << result.pageCount
+             << "纸张:" << result.media << "双面:" << result.sides << result.error;
+    emit pdfPreflighted(filePath, result);
+}
+
+PdfPreflight PrintManager::readPdfPreflight(const QString &filePath, bool *opened)
+{
+    QFile file(filePath);
+    bool ok = file.open(QIODevice::ReadOnly);
+    if (opened) {
+        *opened = ok;
+    }
+    if (!ok) {
+        PdfPreflight result;
+        result.error = "Cannot open file: " + filePath;
+        return result;
+    }
+    return parsePdf(file.readAll());
+}
+
+namespace {
+
+bool isPdfSpace(char c)
+{
+    return c == ' ' || c == '\r' || c == '\n' || c == '\t' || c == '\f' || c == '\0';
+}
+
+bool isPdfDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// 解压 FlateDecode 流；qUncompress 需要4字节的长度前缀，只作为初始缓冲区大小的提示
+QByteArray inflateStream(const QByteArray &compressed)
+{
+    quint32 hint = quint32(qMin(compressed.size() * 8, 64 * 1024 * 1024));
+    QByteArray prefixed;
+    prefixed.append(char((hint >> 24) & 0xff));
+    prefixed.append(char((hint >> 16) & 0xff));
+    prefixed.append(char((hint >> 8) & 0xff));
+    prefixed.append(char(hint & 0xff));
+    prefixed.append(compressed);
+    return qUncompress(prefixed);
+}
+
+// 字典中 key 对应的值：数组返回含方括号的整段，引用返回 "N G R"，其他返回到下一个分隔符为止
+QByteArray dictValue(const QByteArray &dict, const QByteArray &key)
+{
+    int pos = 0;
+    while ((pos = dict.indexOf(key, pos)) >= 0) {
+        pos += key.size();
+        // 排除前缀相同的键，如 /Page 与 /Pages
+        if (pos < dict.size() && (isPdfDigit(dict[pos]) || QChar(dict[pos]).isLetter())) {
+            continue;
+        }
+        while (pos < dict.size() && isPdfSpace(dict[pos])) {
+            ++pos;
+        }
+        if (pos < dict.size() && dict[pos] == '[') {
+            int close = dict.indexOf(']', pos);
+            return close < 0 ? QByteArray() : dict.mid(pos, close - pos + 1);
+        }
+        int end = pos;
+        while (end < dict.size() && dict[end] != '/' && dict[end] != '<' && dict[end] != '>' && dict[end] != '[') {
+            ++end;
+        }
+        return dict.mid(pos, end - pos).trimmed();
+    }
+    return QByteArray();
+}
+
+// "12 0 R" 形式的间接引用，返回对象编号；不是引用时返回 -1
+int referenceNumber(const QByteArray &value)
+{
+    QList<QByteArray> parts = value.simplified().split(' ');
+    if (parts.size() == 3 && parts[2] == "R") {
+        bool ok = false;
+        int number = parts[0].toInt(&ok);
+        return ok ? number : -1;
+    }
+    return -1;
+}
+
+// 间接引用替换为所引用对象的内容
+QByteArray resolveValue(const QMap<int, QByteArray> &objects, const QByteArray &value)
+{
+    int number = referenceNumber(value);
+    return number >= 0 ? objects.value(number).trimmed() : value;
+}
+
+// 逐个收集 "N G obj ... endobj" 对象（流对象只保留字典部分），并展开压缩对象流（PDF 1.5+）。
+// 按文件顺序处理，增量更新追加的新版本覆盖之前的定义
+void collectPdfObjects(const QByteArray &data, QMap<int, QByteArray> *objects)
+{
+    int pos = 0;
+    while ((pos = data.indexOf(" obj", pos)) >= 0) {
+        int keyword = pos;
+        int bodyStart = pos + 4;
+        pos = bodyStart;
+        
+        // 向前解析 "编号 代号"，不符合格式的（如流数据中的字节）跳过
+        int i = keyword;
+        while (i > 0 && isPdfDigit(data[i - 1])) --i;
+        int genStart = i;
+        while (i > 0 && isPdfSpace(data[i - 1])) --i;
+        int numberEnd = i;
+        while (i > 0 && isPdfDigit(data[i - 1])) --i;
+        if (genStart == keyword || numberEnd == genStart || i == numberEnd
+                || (bodyStart < data.size() && QChar(data[bodyStart]).isLetterOrNumber())) {
+            continue;
+        }
+        int number = data.mid(i, numberEnd - i).toInt();
+        
+        int endObj = data.indexOf("endobj", bodyStart);
+        if (endObj < 0) {
+            break;
+        }
+        int stream = data.indexOf("stream", bodyStart);
+        if (stream < 0 || stream > endObj) {
+            objects->insert(number, data.mid(bodyStart, endObj - bodyStart));
+            pos = endObj + 6;
+            continue;
+        }
+        
+        QByteArray dict = data.mid(bodyStart, stream - bodyStart);
+        objects->insert(number, dict);
+        int streamStart = stream + 6;
+        if (streamStart < data.size() && data[streamStart] == '\r') ++streamStart;
+        if (streamStart < data.size() && data[streamStart] == '\n') ++streamStart;
+        int streamEnd = data.indexOf("endstream", streamStart);
+        if (streamEnd < 0) {
+            break;
+        }
+        pos = streamEnd + 9;
+        
+        // 对象流：头部为 N 对 "编号 偏移"，偏移相对于 /First
+        if (dict.contains("/ObjStm") && dict.contains("/FlateDecode")) {
+            QByteArray content = inflateStream(data.mid(streamStart, streamEnd - streamStart));
+            int count = dictValue(dict, "/N").toInt();
+            int first = dictValue(dict, "/First").toInt();
+            QList<QByteArray> header = content.left(first).simplified().split(' ');
+            if (first <= 0 || first > content.size() || header.size() < count * 2) {
+                continue;
+            }
+            for (int k = 0; k < count; ++k) {
+                int offset = first + header[k * 2 + 1].toInt();
+                int next = k + 1 < count ? first + header[k * 2 + 3].toInt() : content.size();
+                objects->insert(header[k * 2].toInt(), content.mid(offset, next - offset));
+            }
+        }
+    }
+}
+
+// 从文档目录沿页面树的第一个分支找到第1页，MediaBox 和 Rotate 可由上层节点继承
+bool resolveFirstPage(const QMap<int, QByteArray> &objects, int root,
+                      int *pageCount, QList<double> *mediaBox, int *rotate)
+{
+    int node = referenceNumber(dictValue(objects.value(root), "/Pages"));
+    
+    // 限制深度，防止损坏的文件形成环
+    for (int depth = 0; depth < 32 && objects.contains(node); ++depth) {
+        const QByteArray dict = objects.value(node);
+        if (depth == 0) {
+            *pageCount = resolveValue(objects, dictValue(dict, "/Count")).toInt();
+        }
+        
+        QByteArray box = resolveValue(objects, dictValue(dict, "/MediaBox"));
+        QList<QByteArray> numbers = box.mid(1, box.size() - 2).simplified().split(' ');
+        if (box.startsWith('[') && numbers.size() == 4) {
+            mediaBox->clear();
+            for (const QByteArray &number : numbers) {
+                mediaBox->append(number.toDouble());
+            }
+        }
+        QByteArray rotation = resolveValue(objects, dictValue(dict, "/Rotate"));
+        if (!rotation.isEmpty()) {
+            *rotate = rotation.toInt();
+        }
+        
+        QByteArray kids = resolveValue(objects, dictValue(dict, "/Kids"));
+        if (kids.isEmpty()) {
+            return mediaBox->size() == 4;
+        }
+        QList<QByteArray> refs = kids.mid(1, kids.size() - 2).simplified().split(' ');
+        node = refs.size() >= 3 ? referenceNumber(refs[0] + ' ' + refs[1] + ' ' + refs[2]) : -1;
+    }
+    return false;
+}
+
+} // namespace
+
+PdfPreflight PrintManager::parsePdf(const QByteArray &data)
+{
+    PdfPreflight result;
+    
+    // 文件头和结尾标记：下载不完整的文件通常缺少 %%EOF
+    if (data.left(1024).indexOf("%PDF-") < 0) {
+        result.error = "Not a PDF file";
+        return result;
+    }
+    if (data.right(1024).indexOf("%%EOF") < 0) {
+        result.error = "PDF file is truncated";
+        return result;
+    }
+    
+    QMap<int, QByteArray> objects;
+    collectPdfObjects(data, &objects);
+    
+    // 文档目录：增量更新时以最后一个 trailer（或交叉引用流）中的 /Root 为准
+    int rootKey = data.lastIndexOf("/Root");
+    int root = rootKey >= 0 ? referenceNumber(dictValue(data.mid(rootKey, 32), "/Root")) : -1;
+    
+    int pageCount = 0;
+    QList<double> mediaBox;
+    int rotate = 0;
+    resolveFirstPage(objects, root, &pageCount, &mediaBox, &rotate);
+    
+    // 找不到文档目录时，按页面树节点（带 /Kids 的 /Pages 字典）的最大 /Count 估计页数
+    if (pageCount == 0) {
+        for (const QByteArray &object : objects) {
+            if (object.contains("/Kids") && object.contains("/Pages")) {
+                pageCount = qMax(pageCount, resolveValue(objects, dictValue(object, "/Count")).toInt());
+            }
+        }
+    }
+    
+    if (pageCount == 0 && !data.contains("/Encrypt")) {
+        result.error = "No page tree found";
+        return result;
+    }
+    
+    result.valid = true;
+    result.pageCount = pageCount;
+    
+    if (mediaBox.size() == 4) {
+        result.widthPt = qAbs(mediaBox[2] - mediaBox[0]);
+        result.heightPt = qAbs(mediaBox[3] - mediaBox[1]);
+        // 页面旋转90度时横竖方向互换
+        result.landscape = (result.widthPt > result.heightPt) != (qAbs(rotate) % 180 == 90);
+        
+        // 按短边/长边与标准纸张比较，允许10点误差
+        double shortSide = qMin(result.widthPt, result.heightPt);
+        double longSide = qMax(result.widthPt, result.heightPt);
+        struct PaperSize { const char *name; double shortSide; double longSide; };
+        static const PaperSize papers[] = {
+            { "A4", 595, 842 },
+            { "A3", 842, 1191 },
+            { "B4", 729, 1032 },
+            { "Letter", 612, 792 }
+        };
+        for (const PaperSize &paper : papers) {
+            if (qAbs(shortSide - paper.shortSide) < 10 && qAbs(longSide - paper.longSide) < 10) {
+                result.media = paper.name;
+                break;
+            }
+        }
+    }
+    
+    // 单页文档单面打印；横向版面按短边翻转
+    if (pageCount == 1) {
+        result.sides = "one-sided";
+    } else if (pageCount > 1) {
+        result.sides = result.landscape ? "two-sided-short-edge" : "two-sided-long-edge";
+    }
+    
+    return result;
+}
+
+bool PrintManager::submitPrintJob(const QString &deviceName, const QStringList &args, const QString &jobName)
+{
+    PrintSubmission submission;
+    submission.args = args;
+    submission.jobName = jobName;
+    return submitPrintJob(deviceName, submission);
+}
+
+bool PrintManager::submitPrintJob(const QString &deviceName, const PrintSubmission &submission)
+{
+    const QString &jobName = submission.jobName;
+    if (m_ippClients.contains(deviceName)) {
+        return submitIppJob(deviceName, submission.args, jobName);
+    }
+    
+    // 没有 lp 时启动必然失败，提交前直接返回失败，调用方可以立即处理
+    if (QStandardPaths::findExecutable("lp").isEmpty()) {
+        failPrintJob(deviceName, jobName, "Print command not found: lp");
+        return false;
+    }
     
     QProcess *process = getOrCreatePrintProcess(deviceName);
-    process->start("lp", args);
     
-    if (process->waitForStarted()) {
-        emit printStarted(deviceName, QFileInfo(filePath).fileName());
+    // 上一个lp还在提交时排队，避免覆盖正在运行的进程
+    if (process->state() != QProcess::NotRunning) {
+        m_pendingSubmissions[deviceName].append(submission);
+        qDebug() << "Print submission queued:" << jobName;
         return true;
-    } else {
-        emit printError(deviceName, "Failed to start print process");
+    }
+    
+    qDebug() << "Starting print with command: lp" << submission.args;
+    
+    // 不等待进程启动：启动后发出 printStarted，启动失败或超时由错误处理上报
+    m_submitting[deviceName] = submission;
+    m_watchdog->watch(process, "lp " + deviceName, ProcessStartTimeout, SubmitTimeout);
+    process->start("lp", submission.args);
+    return true;
+}
+
+void PrintManager::submitNextPrintJob(const QString &deviceName)
+{
+    if (m_pendingSubmissions.value(deviceName).isEmpty()) {
+        return;
+    }
+    
+    PrintSubmission next = m_pendingSubmissions[deviceName].takeFirst();
+    if (m_pendingSubmissions[deviceName].isEmpty()) {
+        m_pendingSubmissions.remove(deviceName);
+    }
+    submitPrintJob(deviceName, next);
+}
+
+void PrintManager::setIppEndpoint(const QString &deviceName, const QUrl &printerUri)
+{
+    delete m_ippClients.take(deviceName);
+    
+    // 旧客户端上尚未有结果的提交不会再收到通知，按失败结束
+    QString prefix = deviceName + "|";
+    for (const QString &key : m_ippSubmissionNames.keys()) {
+        if (key.startsWith(prefix)) {
+            delete m_ippSubmissionFiles.take(key);
+            failPrintJob(deviceName, m_ippSubmissionNames.take(key), "IPP endpoint changed: " + deviceName);
+        }
+    }
+    
+    if (!printerUri.isValid() || printerUri.isEmpty()) {
+        return;
+    }
+    
+    IppClient *client = new IppClient(printerUri, this);
+    m_ippClients[deviceName] = client;
+    qDebug() << "IPP 直连打印:" << deviceName << printerUri;
+    
+    connect(client, &IppClient::jobSubmitted, this, [this, deviceName](int submissionId, int jobId) {
+        QString key = deviceName + "|" + QString::number(submissionId);
+        delete m_ippSubmissionFiles.take(key);
+        QString jobName = m_ippSubmissionNames.take(key);
+        acceptPrintJob(deviceName, jobName, jobId);
+    });
+    connect(client, &IppClient::jobFailed, this, [this, deviceName](int submissionId, const QString &error) {
+        QString key = deviceName + "|" + QString::number(submissionId);
+        delete m_ippSubmissionFiles.take(key);
+        QString jobName = m_ippSubmissionNames.take(key);
+        failPrintJob(deviceName, jobName, QString("IPP print failed (%1): %2").arg(jobName, error));
+    });
+    // IPP 请求不经过子进程，超时同样记入看门狗，和 lp 的超时一起统计
+    connect(client, &IppClient::requestTimedOut, this, [this, deviceName](const QString &request) {
+        m_watchdog->recordTimeout("ipp " + deviceName, request);
+    });
+    connect(client, &IppClient::jobFinished, this, [deviceName](int jobId, int state) {
+        if (state != IppClient::Completed) {
+            qDebug() << "IPP 打印任务未完成:" << deviceName << jobId << state;
+        }
+    });
+}
+
+bool PrintManager::ippOptionsFromArgs(const QStringList &args, IppJobOptions *ippOptions,
+                                      QString *filePath, QString *error)
+{
+    // 把已构建好的lp参数转换为IPP任务属性；Print-Job 一次只能提交一个文档
+    IppJobOptions &options = *ippOptions;
+    QStringList files;
+    for (int i = 0; i < args.size(); ++i) {
+        const QString &arg = args.at(i);
+        bool hasValue = i + 1 < args.size();
+        if (arg == "-n" && hasValue) {
+            options.copies = qMax(1, args.at(++i).toInt());
+        } else if (arg == "-P" && hasValue) {
+            QString value = args.at(++i);
+            options.firstPage = value.section('-', 0, 0).toInt();
+            options.lastPage = value.section('-', 1, 1).toInt();
+        } else if ((arg == "-d" || arg == "-t" || arg == "-h" || arg == "-H" || arg == "-q" || arg == "-U")
+                   && hasValue) {
+            ++i;
+        } else if (arg == "-o" && hasValue) {
+            QString option = args.at(++i);
+            QString key = option.section('=', 0, 0);
+            QString value = option.section('=', 1);
+            if (key == "media") {
+                options.media = value;
+            } else if (key == "sides") {
+                options.sides = value;
+            } else if (key == "print-quality") {
+                options.printQuality = value.toInt();
+            } else if (key == "printer-resolution") {
+                options.resolution = value.remove("dpi").toInt();
+            } else if (key == "page-ranges") {
+                options.firstPage = value.section('-', 0, 0).toInt();
+                options.lastPage = value.section('-', 1, 1).toInt();
+            } else if (key == "collate") {
+                options.collate = value == "true";
+            } else if (key == "job-sheets") {
+                // IPP 只有一个 job-sheets 值，对应lp的开始页
+                options.jobSheets = value.section(',', 0, 0);
+            } else if (key == "fit-to-page") {
+                options.printScaling = "fit";
+            }
+        } else if (!arg.startsWith('-') || arg == "-") {
+            files << arg;
+        }
+    }
+    
+    if (files.size() != 1) {
+        if (error) {
+            *error = files.isEmpty() ? QString("No file to print")
+                                     : QString("IPP printing accepts one file per job, got %1").arg(files.size());
+        }
+        return false;
+    }
+    *filePath = files.first();
+    return true;
+}
+
+bool PrintManager::submitIppJob(const QString &deviceName, const QStringList &args, const QString &jobName)
+{
+    QString filePath;
+    QString error;
+    IppJobOptions options;
+    if (!ippOptionsFromArgs(args, &options, &filePath, &error)) {
+        failPrintJob(deviceName, jobName, "Invalid IPP print job: " + error);
         return false;
     }
+    
+    if (!QFileInfo(filePath).isReadable()) {
+        failPrintJob(deviceName, jobName, "Cannot read print file: " + filePath);
+        return false;
+    }
+    if (!filePath.endsWith(".pdf", Qt::CaseInsensitive)) {
+        options.documentFormat = "application/octet-stream";   // 由打印机自动识别
+    }
+    
+    // 发送时从文件流式读取，不把整个文档读入内存
+    qDebug() << "IPP 提交打印任务:" << deviceName << jobName;
+    IppClient *client = m_ippClients.value(deviceName);
+    int submissionId = client->submitJobFile(jobName, filePath, options);
+    m_ippSubmissionNames[deviceName + "|" + QString::number(submissionId)] = jobName;
+    emit printStarted(deviceName, jobName);
+    return true;
+}
+
+void PrintManager::acceptPrintJob(const QString &deviceName, const QString &jobName, int jobId)
+{
+    emit printCompleted(deviceName, jobName, jobId);
+    
+    // 无法跟踪的任务（没有任务ID）只能视为已完成
+    if (jobId <= 0) {
+        emit printJobFinished(deviceName, jobId);
+        return;
+    }
+    m_trackedJobs[deviceName].insert(jobId);
+    if (!m_jobTrackTimer->isActive()) {
+        m_jobTrackTimer->start();
+    }
 }
 
+void PrintManager::failPrintJob(const QString &deviceName, const QString &jobName, const QString &error)
+{
+    // printError 只用于显示；调用方按任务名称处理失败的任务
+    emit printError(deviceName, error);
+    emit printJobFailed(deviceName, jobName, error);
+}
 
+void PrintManager::updateTrackedJobs(const QString &deviceName, const QMap<int, QString> &jobs)
+{
+    if (!m_trackedJobs.contains(deviceName)) {
+        return;
+    }
+    
+    // 不再出现在队列中的任务已打印完成（或被取消）
+    QSet<int> &tracked = m_trackedJobs[deviceName];
+    for (int jobId : tracked.values()) {
+        if (!jobs.contains(jobId)) {
+            tracked.remove(jobId);
+            if (tracked.isEmpty()) {
+                m_trackedJobs.remove(deviceName);
+            }
+            emit printJobFinished(deviceName, jobId);
+        }
+    }
+    
+    if (m_trackedJobs.isEmpty()) {
+        m_jobTrackTimer->stop();
+    }
+}
+
+void PrintManager::getPrintJobs(const QString &deviceName)
+{
+    // IPP 设备的任务状态由客户端持续跟踪，无需调用lpstat
+    if (IppClient *client = m_ippClients.value(deviceName)) {
+        QMap<int, QString> jobs = client->activeJobs();
+        QTimer::singleShot(0, this, [this, deviceName, jobs]() {
+            updateTrackedJobs(deviceName, jobs);
+            emit printJobsReceived(deviceName, jobs);
+        });
+        return;
+    }
+    
+    // lpstat -o 列出未完成的任务，格式如 "Brother_MFC_J3940DW-123 user 1024 ..."
+    QProcess *process = new QProcess(this);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this, process, deviceName](int exitCode, QProcess::ExitStatus exitStatus) {
+        if (exitCode == 0 && exitStatus == QProcess::NormalExit) {
+            QMap<int, QString> jobs;
+            QString output = process->readAllStandardOutput();
+            QStringList lines = output.split('\n', QString::SkipEmptyParts);
+            QString prefix = deviceName + "-";
+            
+            for (const QString &line : lines) {
+                QString jobTag = line.section(' ', 0, 0);
+                if (jobTag.startsWith(prefix)) {
+                    int jobId = jobTag.mid(prefix.length()).toInt();
+                    if (jobId > 0) {
+                        jobs[jobId] = line.section(' ', 1).simplified();
+                    }
+                }
+            }
+            updateTrackedJobs(deviceName, jobs);
+            emit printJobsReceived(deviceName, jobs);
+        } else {
+            emit printError(deviceName, "Failed to query print jobs: " + QString(process->readAllStandardError()));
+        }
+        process->deleteLater();
+    });
+    m_watchdog->watch(process, "lpstat " + deviceName, ProcessStartTimeout, QueryTimeout);
+    process->start("lpstat", QStringList() << "-o" << deviceName);
+}
+
+void PrintManager::cancelPrintJob(const QString &deviceName, int jobId)
+{
+    if (IppClient *client = m_ippClients.value(deviceName)) {
+        client->cancelJob(jobId);
+        return;
+    }
+    QProcess::startDetached("cancel", QStringList() << QString("%1-%2").arg(deviceName).arg(jobId));
+}
+
+void PrintManager::holdPrintJob(const QString &deviceName, int jobId)
+{
+    // 仅对尚未开始打印的任务有效，正在打印的任务CUPS会忽略
+    qDebug() << "挂起打印任务:" << deviceName << jobId;
+    if (IppClient *client = m_ippClients.value(deviceName)) {
+        client->holdJob(jobId);
+        return;
+    }
+    QProcess::startDetached("lp", QStringList() << "-i" << QString("%1-%2").arg(deviceName).arg(jobId)
+                                                << "-H" << "hold");
+}
+
+void PrintManager::releasePrintJob(const QString &deviceName, int jobId)
+{
+    qDebug() << "恢复打印任务:" << deviceName << jobId;
+    if (IppClient *client = m_ippClients.value(deviceName)) {
+        client->releaseJob(jobId);
+        return;
+    }
+    QProcess::startDetached("lp", QStringList() << "-i" << QString("%1-%2").arg(deviceName).arg(jobId)
+                                                << "-H" << "resume");
+}
 
 void PrintManager::onPrintProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
@@ -137,19 +1361,31 @@ void PrintManager::onPrintProcessFinished(int exitCode, QProcess::ExitStatus exi
         }
     }
     
-    if (exitCode == 0) {
-        QString output = process->readAllStandardOutput();
-        int jobId = extractJobId(output);
-        
-        if (jobId > 0) {
-            emit printCompleted(deviceName, "Print Job", jobId);
-        } else {
-            emit printCompleted(deviceName, "Print Job", -1);
-        }
+    PrintSubmission submission = m_submitting.take(deviceName);
+    QString jobName = submission.jobName.isEmpty() ? QString("Print Job") : submission.jobName;
+    
+    // lp 输出任务号时 CUPS 已保存了完整的任务
+    int jobId = extractJobId(process->readAllStandardOutput());
+    
+    if (exitCode == 0 && exitStatus == QProcess::NormalExit) {
+        acceptPrintJob(deviceName, jobName, jobId > 0 ? jobId : -1);
+    } else if (jobId > 0) {
+        // 已进入打印队列后才被终止：按已提交处理，重新提交会重复打印
+        qDebug() << "lp 在任务进入队列后退出:" << jobName << jobId;
+        acceptPrintJob(deviceName, jobName, jobId);
+    } else if (exitStatus == QProcess::CrashExit && !submission.args.isEmpty() && !submission.retried) {
+        // 被看门狗终止（CUPS 暂时无响应）：lp 没有返回任务号，CUPS 不会保留不完整的任务，
+        // 放回队首重新提交一次；再次失败才上报。重试标记随这次提交保存，不与同名任务混淆
+        submission.retried = true;
+        m_pendingSubmissions[deviceName].prepend(submission);
+        qDebug() << "lp 提交被终止，重新提交:" << jobName;
     } else {
         QString error = process->readAllStandardError();
-        emit printError(deviceName, "Print failed: " + error);
+        failPrintJob(deviceName, jobName, "Print failed: " + error);
     }
+    
+    // 提交队列中的下一个任务
+    submitNextPrintJob(deviceName);
 }
 
 void PrintManager::onPrintProcessError(QProcess::ProcessError error)
@@ -166,6 +1402,9 @@ void PrintManager::onPrintProcessError(QProcess::ProcessError error)
         }
     }
     
+    // 进程崩溃或被看门狗终止时还会发出 finished，在那里统一上报
+    if (error == QProcess::Crashed) return;
+    
     QString errorMsg;
     switch (error) {
         case QProcess::FailedToStart:
@@ -182,7 +1421,13 @@ void PrintManager::onPrintProcessError(QProcess::ProcessError error)
             break;
     }
     
-    emit printError(deviceName, errorMsg);
+    // 启动失败不会发出 finished，该任务在这里结束，继续提交排队的任务
+    if (error == QProcess::FailedToStart) {
+        failPrintJob(deviceName, m_submitting.take(deviceName).jobName, errorMsg);
+        submitNextPrintJob(deviceName);
+    } else {
+        emit printError(deviceName, errorMsg);
+    }
 }
 
 QProcess* PrintManager::getOrCreatePrintProcess(const QString &deviceName)
@@ -193,6 +1438,10 @@ QProcess* PrintManager::getOrCreatePrintProcess(const QString &deviceName)
                 this, &PrintManager::onPrintProcessFinished);
         connect(process, &QProcess::errorOccurred,
                 this, &PrintManager::onPrintProcessError);
+        connect(process, &QProcess::started, this, [this, deviceName]() {
+            QString jobName = m_submitting.value(deviceName).jobName;
+            emit printStarted(deviceName, jobName.isEmpty() ? QString("Print Job") : jobName);
+        });
         m_printProcesses[deviceName] = process;
     }
     return m_printProcesses[deviceName];
@@ -200,17 +1449,18 @@ QProcess* PrintManager::getOrCreatePrintProcess(const QString &deviceName)
 
 void PrintManager::cleanupProcess(const QString &deviceName)
 {
-    if (m_printProcesses.contains(deviceName)) {
-        QProcess *process = m_printProcesses[deviceName];
-        if (process) {
-            process->terminate();
-            process->waitForFinished(5000);
-            if (process->state() == QProcess::Running) {
-                process->kill();
-            }
-            delete process;
-        }
-        m_printProcesses.remove(deviceName);
+    QProcess *process = m_printProcesses.take(deviceName);
+    if (!process) return;
+    
+    // 异步终止，进程退出后再释放，不阻塞界面线程
+    process->disconnect(this);
+    m_submitting.remove(deviceName);
+    if (process->state() == QProcess::NotRunning) {
+        process->deleteLater();
+    } else {
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                process, &QObject::deleteLater);
+        ProcessWatchdog::terminateProcess(process);
     }
 }
 
@@ -248,6 +1498,7 @@ void PrintManager::simulatePrint(const QString &fileName, const QString &printer
     QTimer::singleShot(2000, [this, fileName, printerName]() {
         int jobId = QRandomGenerator::global()->bounded(1000, 9999);
         emit printCompleted(printerName, fileName, jobId);
+        emit printJobFinished(printerName, jobId);
         qDebug() << "模拟打印完成，任务ID:" << jobId;
     });
 } 
\ No newline at end of file
@@ -5,7 +5,62 @@
 #include <QProcess>
 #include <QStringList>
 #include <QMap>
+#include <QList>
+#include <QPair>
+#include <QSet>
 #include <QTimer>
+#include <QUrl>
+#include <QMetaType>
+
+class ProcessWatchdog;
+class IppClient;
+class QThreadPool;
+class QTemporaryFile;
+struct IppJobOptions;
+
+// 打印机能力（解析自PPD选项，每台设备只解析一次）
+struct PrintCapabilities
+{
+    bool valid = false;
+    QStringList media;        // 支持的纸张，如 A4、A3
+    QStringList sides;        // one-sided / two-sided-long-edge / two-sided-short-edge
+    QList<int> resolutions;   // 支持的分辨率(dpi)
+    QList<int> qualities;     // IPP print-quality：3草稿 4普通 5高质量
+};
+
+// PDF预检结果（只解析页面树和MediaBox，不渲染）
+struct PdfPreflight
+{
+    bool valid = false;
+    QString error;
+    int pageCount = 0;        // 0 表示无法确定（如加密文档）
+    double widthPt = 0;       // 第一页MediaBox宽度（点）
+    double heightPt = 0;
+    bool landscape = false;
+    QString media;            // 识别出的纸张，如 A4、A3；无法识别时为空
+    QString sides;            // 推荐的双面设置
+};
+Q_DECLARE_METATYPE(PdfPreflight)
+
+// 一次lp提交：同一设备的提交依次执行
+struct PrintSubmission
+{
+    QStringList args;
+    QString jobName;
+    bool retried = false;     // lp 被终止后已重新提交过一次
+};
+
+// 打印机能力读取完成前收到的高级打印请求，读取完成后再校验和提交
+struct AdvancedPrintRequest
+{
+    QString filePath;
+    QString media;
+    QString sides;
+    int resolution = 300;
+    int printQuality = 5;
+    int copies = 1;
+    QString jobName;
+};
 
 class PrintManager : public QObject
 {
@@ -28,47 +83,143 @@ public:
                           int copies = 1,
                           const QString &jobName = "");
     
+    // 按预设方案打印："draft" 草稿快速、"normal" 普通、"high" 高质量
+    bool printFileWithProfile(const QString &deviceName, const QString &filePath,
+                              const QString &profile, int copies = 1,
+                              const QString &jobName = "");
+    
+    // 多份逐份打印；separatorSheet 时在本任务前插入分隔页（合并同一试卷的多个班级时，从第二个班级起使用）
+    bool printCollated(const QString &deviceName, const QString &filePath, int copies,
+                       const QString &jobName, bool separatorSheet = false);
+    
+    // PDF预检：页数、纸张识别，拒绝损坏的文件
+    PdfPreflight preflightPdf(const QString &filePath);
+    void preflightPdfAsync(const QString &filePath);   // 在工作线程读取解析，完成后发出 pdfPreflighted
+    static PdfPreflight readPdfPreflight(const QString &filePath, bool *opened = nullptr);   // 不使用缓存，可在任意线程调用
+    void setMaxPagesPerJob(int pages);
+    
+    // 打印机能力
+    PrintCapabilities getPrintCapabilities(const QString &deviceName);
+    void loadPrintCapabilities(const QString &deviceName);     // 异步读取，完成后发出 printCapabilitiesLoaded
+    bool validatePrintOptions(const QString &deviceName, const QString &media, const QString &sides,
+                              int resolution, int printQuality, int copies, QString *error = nullptr);
+    void clampPrintOptions(const QString &deviceName, QString *sides, int *resolution,
+                           int *printQuality, int *copies);
+    
+    // 流式打印：数据经lp标准输入直接送入CUPS，不产生临时文件
+    bool beginPrintStream(const QString &deviceName, const QString &streamId, const QString &jobName = "",
+                          int copies = 1);
+    void writePrintStream(const QString &streamId, const QByteArray &data);
+    void endPrintStream(const QString &streamId);
+    void abortPrintStream(const QString &streamId);
+    
+    // IPP Everywhere：设置后该设备的任务直接提交给打印机，不经过CUPS
+    void setIppEndpoint(const QString &deviceName, const QUrl &printerUri);
+    bool hasIppEndpoint(const QString &deviceName) const { return m_ippClients.contains(deviceName); }
+    
     // 打印设置
     void setPrintSettings(const QString &deviceName, int copies = 1, const QString &media = "A4", 
                          const QString &sides = "two-sided-long-edge");
     
     // 打印任务管理
     void getPrintJobs(const QString &deviceName);
+    bool hasOutstandingJobs(const QString &deviceName) const { return m_trackedJobs.contains(deviceName); }
     void cancelPrintJob(const QString &deviceName, int jobId);
+    void holdPrintJob(const QString &deviceName, int jobId);
+    void releasePrintJob(const QString &deviceName, int jobId);
     void pausePrinter(const QString &deviceName);
     void resumePrinter(const QString &deviceName);
 
     // 模拟打印功能（用于测试）
     void enableSimulationMode(bool enable = true);
     bool isSimulationMode() const { return m_simulationMode; }
+    ProcessWatchdog *watchdog() const { return m_watchdog; }
     void simulatePrint(const QString &deviceName, const QString &fileName);
 
 signals:
     // 打印信号
     void printStarted(const QString &deviceName, const QString &jobName);
-    void printCompleted(const QString &deviceName, const QString &jobName, int jobId);
+    void printCompleted(const QString &deviceName, const QString &jobName, int jobId);   // 打印队列已接受任务
+    void printJobSplit(const QString &deviceName, const QString &jobName, const QStringList &partNames);   // 大文档拆成若干页段提交
+    void printJobFinished(const QString &deviceName, int jobId);    // 任务离开打印队列（打印完成或被取消）
     void printError(const QString &deviceName, const QString &error);
+    void printJobFailed(const QString &deviceName, const QString &jobName, const QString &error);   // 某个任务未能进入打印队列
     void printJobsReceived(const QString &deviceName, const QMap<int, QString> &jobs);
+    void printStreamBackpressure(const QString &streamId, bool paused);   // lp 标准输入积压/消化
+    void printCapabilitiesLoaded(const QString &deviceName);
+    void pdfPreflighted(const QString &filePath, const PdfPreflight &result);
 
 private slots:
     void onPrintProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onPrintProcessError(QProcess::ProcessError error);
+    void onStreamProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onPreflightFinished(const QString &filePath, qint64 modified, bool opened, const PdfPreflight &result);
 
 private:
     // 进程管理
     QMap<QString, QProcess*> m_printProcesses;
+    QMap<QString, QProcess*> m_streamProcesses;   // 流ID -> lp进程
+    QMap<QString, QString> m_streamDevices;       // 流ID -> 设备名称
+    QMap<QString, QString> m_streamJobNames;      // 流ID -> 任务名称
+    QSet<QString> m_throttledStreams;             // 写入积压、已通知暂停下载的流
+    
+    // lp提交队列：同一设备的lp进程忙时依次提交
+    QMap<QString, QList<PrintSubmission>> m_pendingSubmissions;  // 设备 -> 排队的提交
+    QMap<QString, PrintSubmission> m_submitting;                 // 设备 -> 正在提交（超时后重试用）
     
     // 打印设置
     QMap<QString, int> m_printCopies;
     QMap<QString, QString> m_printMedia;
     QMap<QString, QString> m_printSides;
     
+    // 选项模板：预先构建好的lp参数，每个任务只需复制
+    QMap<QString, QStringList> m_optionTemplates;          // 设备 -> 基本设置模板
+    QMap<QString, QStringList> m_advancedTemplates;        // 设备|纸张|双面|分辨率|质量 -> 模板
+    QMap<QString, PrintCapabilities> m_printCapabilities;  // 设备 -> 打印机能力
+    QSet<QString> m_loadingCapabilities;                   // 正在读取能力的设备
+    QMap<QString, QList<AdvancedPrintRequest>> m_capabilityWaiters;   // 设备 -> 等待能力读取完成的请求
+    
+    // 预检结果缓存：文件路径 -> (修改时间, 结果)
+    QMap<QString, QPair<qint64, PdfPreflight>> m_preflightCache;
+    QThreadPool *m_preflightPool;   // 预检读取整个文件，放在工作线程
+    int m_maxPagesPerJob;     // 超过该页数的单份文档拆分为多个任务
+    
+    // IPP 直连打印
+    QMap<QString, IppClient*> m_ippClients;            // 设备 -> IPP客户端
+    QMap<QString, QString> m_ippSubmissionNames;        // 设备|提交编号 -> 任务名称
+    QMap<QString, QTemporaryFile*> m_ippStreamFiles;    // 流ID -> 暂存已接收文档的临时文件
+    QMap<QString, int> m_ippStreamCopies;               // 流ID -> 份数
+    QMap<QString, QTemporaryFile*> m_ippSubmissionFiles;   // 设备|提交编号 -> 临时文件，提交结束后删除
+    
     // 模拟模式
     bool m_simulationMode;
     
+    // 外部进程看门狗
+    ProcessWatchdog *m_watchdog;
+    
+    // 已提交、尚未打印完的任务
+    QMap<QString, QSet<int>> m_trackedJobs;    // 设备 -> 任务ID
+    QTimer *m_jobTrackTimer;
+    
     // 辅助方法
-    QStringList buildPrintOptions(const QString &deviceName);
+    QStringList buildPrintOptions(const QString &deviceName, int copies = 0);   // copies 为0时使用设备设置
+    QStringList buildOptionTemplate(const QString &deviceName);
     int extractJobId(const QString &output);
+    QStringList advancedOptionTemplate(const QString &deviceName, const QString &media, const QString &sides,
+                                       int resolution, int printQuality);
+    PrintCapabilities parsePrintCapabilities(const QString &output);
+    void setPrintCapabilities(const QString &deviceName, const PrintCapabilities &caps);
+    static PdfPreflight parsePdf(const QByteArray &data);
+    bool submitPrintJob(const QString &deviceName, const QStringList &args, const QString &jobName);
+    bool submitPrintJob(const QString &deviceName, const PrintSubmission &submission);
+    void acceptPrintJob(const QString &deviceName, const QString &jobName, int jobId);
+    void failPrintJob(const QString &deviceName, const QString &jobName, const QString &error);
+    void discardIppStream(const QString &streamId, const QString &error);
+    void updateTrackedJobs(const QString &deviceName, const QMap<int, QString> &jobs);
+    void submitNextPrintJob(const QString &deviceName);
+    bool submitIppJob(const QString &deviceName, const QStringList &args, const QString &jobName);
+    bool ippOptionsFromArgs(const QStringList &args, IppJobOptions *options, QString *filePath,
+                            QString *error = nullptr);
     
     // 进程管理
     QProcess* getOrCreatePrintProcess(const QString &deviceName);
@@ -0,0 +1,193 @@
+#include "processwatchdog.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QTimer>
+
+namespace {
+const int ChronicTimeoutCount = 3;     // 同一进程超时达到该次数时告警
+}
+
+ProcessWatchdog::ProcessWatchdog(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ProcessWatchdog::~ProcessWatchdog()
+{
+}
+
+void ProcessWatchdog::watch(QProcess *process, const QString &name, int startTimeoutMs,
+                            int runTimeoutMs, int idleTimeoutMs)
+{
+    if (!process) return;
+    unwatch(process);
+    
+    Watch watch;
+    watch.name = name;
+    watch.startTimeout = startTimeoutMs;
+    watch.runTimeout = runTimeoutMs;
+    watch.idleTimeout = idleTimeoutMs;
+    
+    // 计时器挂在进程下，进程销毁时一起释放
+    watch.timer = new QTimer(process);
+    watch.timer->setSingleShot(true);
+    connect(watch.timer, &QTimer::timeout, this, &ProcessWatchdog::onDeadline);
+    
+    connect(process, &QProcess::started, this, &ProcessWatchdog::onStarted);
+    connect(process, &QProcess::readyReadStandardOutput, this, &ProcessWatchdog::onActivity);
+    connect(process, &QProcess::readyReadStandardError, this, &ProcessWatchdog::onActivity);
+    connect(process, &QProcess::bytesWritten, this, &ProcessWatchdog::onActivity);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &ProcessWatchdog::onStopped);
+    connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            unwatch(process);
+        }
+    });
+    connect(process, &QObject::destroyed, this, [this, process]() {
+        m_watches.remove(process);
+    });
+    
+    m_watches.insert(process, watch);
+    
+    if (process->state() == QProcess::Running) {
+        armRunStage(process);
+    } else {
+        m_watches[process].stage = "start";
+        if (startTimeoutMs > 0) {
+            watch.timer->start(startTimeoutMs);
+        }
+    }
+}
+
+void ProcessWatchdog::unwatch(QProcess *process)
+{
+    if (!m_watches.contains(process)) {
+        return;
+    }
+    
+    Watch watch = m_watches.take(process);
+    process->disconnect(this);
+    if (watch.timer) {
+        watch.timer->stop();
+        watch.timer->deleteLater();
+    }
+}
+
+void ProcessWatchdog::terminateProcess(QProcess *process, int graceMs)
+{
+    if (!process || process->state() == QProcess::NotRunning) {
+        return;
+    }
+    
+    process->terminate();
+    QTimer::singleShot(graceMs, process, [process]() {
+        if (process->state() != QProcess::NotRunning) {
+            qDebug() << "进程未响应终止请求，强制结束:" << process->program();
+            process->kill();
+        }
+    });
+}
+
+int ProcessWatchdog::timeoutCount(const QString &name) const
+{
+    return m_timeoutCounts.value(name, 0);
+}
+
+void ProcessWatchdog::onStarted()
+{
+    QProcess *process = qobject_cast<QProcess*>(sender());
+    if (process && m_watches.contains(process)) {
+        armRunStage(process);
+    }
+}
+
+void ProcessWatchdog::onActivity()
+{
+    QProcess *process = qobject_cast<QProcess*>(sender());
+    if (!process || !m_watches.contains(process)) return;
+    
+    // 有输出或有数据写入时重新计算无响应期限
+    const Watch &watch = m_watches[process];
+    if (watch.stage == "run" && watch.idleTimeout > 0) {
+        armRunStage(process);
+    }
+}
+
+void ProcessWatchdog::onStopped()
+{
+    QProcess *process = qobject_cast<QProcess*>(sender());
+    if (process) {
+        unwatch(process);
+    }
+}
+
+void ProcessWatchdog::onDeadline()
+{
+    QTimer *timer = qobject_cast<QTimer*>(sender());
+    if (!timer) return;
+    
+    QProcess *process = qobject_cast<QProcess*>(timer->parent());
+    if (!process || !m_watches.contains(process)) return;
+    
+    Watch watch = m_watches.value(process);
+    QString stage = watch.stage;
+    if (stage == "run" && watch.idleTimeout > 0
+        && (watch.runTimeout <= 0 || watch.running.elapsed() < watch.runTimeout)) {
+        stage = "idle";
+    }
+    
+    unwatch(process);
+    recordTimeout(watch.name, stage);
+    emit processTimedOut(watch.name, stage);
+    
+    // 终止后进程发出 finished(CrashExit)，由调用方按失败处理
+    terminateProcess(process);
+}
+
+void ProcessWatchdog::armRunStage(QProcess *process)
+{
+    Watch &watch = m_watches[process];
+    if (watch.stage != "run") {
+        watch.stage = "run";
+        watch.running.start();
+    }
+    
+    // 取总运行期限剩余时间与无响应期限中较短的一个
+    int interval = -1;
+    if (watch.runTimeout > 0) {
+        interval = qMax(0, watch.runTimeout - int(watch.running.elapsed()));
+    }
+    if (watch.idleTimeout > 0 && (interval < 0 || watch.idleTimeout < interval)) {
+        interval = watch.idleTimeout;
+    }
+    
+    if (interval >= 0) {
+        watch.timer->start(interval);
+    } else {
+        watch.timer->stop();
+    }
+}
+
+void ProcessWatchdog::recordTimeout(const QString &name, const QString &stage)
+{
+    int count = ++m_timeoutCounts[name];
+    qDebug() << "进程超时:" << name << "阶段:" << stage << "累计次数:" << count;
+    if (count >= ChronicTimeoutCount) {
+        qWarning() << "进程频繁超时，请检查设备或网络:" << name << "次数:" << count;
+    }
+    
+    // 追加到日志文件，跨次运行也能看到经常卡住的设备
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    QFile log(dir + "/watchdog.log");
+    if (log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        QTextStream out(&log);
+        out << QDateTime::currentDateTime().toString(Qt::ISODate) << '\t'
+            << name << '\t' << stage << '\t' << count << '\n';
+    }
+}
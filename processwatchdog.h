@@ -0,0 +1,63 @@
+#ifndef PROCESSWATCHDOG_H
+#define PROCESSWATCHDOG_H
+
+#include <QObject>
+#include <QProcess>
+#include <QMap>
+#include <QElapsedTimer>
+
+class QTimer;
+
+// 外部进程看门狗：按阶段（启动、运行、无输出）设置期限，超时后异步终止进程，
+// 进程随后照常发出 finished/errorOccurred，调用方原有的清理逻辑即可释放设备
+class ProcessWatchdog : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProcessWatchdog(QObject *parent = nullptr);
+    ~ProcessWatchdog();
+
+    // 在 start() 之前或之后调用均可；runTimeoutMs/idleTimeoutMs 为0表示不限制
+    void watch(QProcess *process, const QString &name, int startTimeoutMs,
+               int runTimeoutMs, int idleTimeoutMs = 0);
+    void unwatch(QProcess *process);
+    
+    // 先 terminate，宽限期后仍未退出则 kill，不阻塞调用线程
+    static void terminateProcess(QProcess *process, int graceMs = 3000);
+    
+    // 记录一次超时；不经过外部进程的操作（如 eSCL 请求）也记入同一统计和日志
+    void recordTimeout(const QString &name, const QString &stage);
+    
+    // 超时记录：名称 -> 次数
+    int timeoutCount(const QString &name) const;
+    QMap<QString, int> timeoutCounts() const { return m_timeoutCounts; }
+
+signals:
+    void processTimedOut(const QString &name, const QString &stage);
+
+private slots:
+    void onStarted();
+    void onActivity();
+    void onStopped();
+    void onDeadline();
+
+private:
+    struct Watch
+    {
+        QString name;
+        QString stage;             // "start" / "run"
+        int startTimeout = 0;
+        int runTimeout = 0;
+        int idleTimeout = 0;
+        QTimer *timer = nullptr;
+        QElapsedTimer running;     // 运行阶段计时
+    };
+    
+    QMap<QProcess*, Watch> m_watches;
+    QMap<QString, int> m_timeoutCounts;
+    
+    void armRunStage(QProcess *process);
+};
+
+#endif // PROCESSWATCHDOG_H
@@ -0,0 +1,389 @@
+#include "regionextractor.h"
+#include "pagebufferpool.h"
+#include "omrreader.h"
+#include <QFile>
+#include <QJsonObject>
+#include <QtMath>
+#include <cmath>
+#include <cstring>
+
+namespace {
+const int StripRows = 64;
+const int AnalysisDpi = 75;             // 找定位标记用的缩略图分辨率（5mm 标记约15像素）
+const int InkThreshold = 160;           // 灰度低于该值视为有墨迹
+const double MmPerInch = 25.4;
+const double SearchRadiusMm = 15.0;     // 在版面位置 ±15mm 内搜索标记（进纸偏移、裁边误差）
+const float MinMarkFill = 0.7f;         // 标记方块内的墨迹比例下限
+const float MaxMarkSurround = 0.25f;    // 方块外一圈的墨迹比例上限，文字和表格线不会被当成标记
+const double MaxResidualMm = 1.5;       // 拟合残差超过该值视为有标记误判
+const double MaxScaleError = 0.15;      // 拟合比例与扫描分辨率相差超过15%视为误判
+const double RegionMarginMm = 1.0;      // 答题区域四周多裁1mm，抵消定位误差
+const int PackageAlignRows = 16;        // 各区域在拼图中按 JPEG MCU 行对齐，压缩块不跨区域
+
+// 在 expected 附近搜索墨迹最满、外圈最空的 size×size 方块，返回方块范围内的墨迹重心（缩略图坐标）
+bool findMark(const QVector<float> &ink, int thumbWidth, int thumbHeight, const QPointF &expected,
+              int size, int ring, int radius, QPointF *center)
+{
+    const int outer = size + 2 * ring;
+    const int x0 = qMax(0, qFloor(expected.x()) - radius - outer / 2);
+    const int y0 = qMax(0, qFloor(expected.y()) - radius - outer / 2);
+    const int x1 = qMin(thumbWidth, qCeil(expected.x()) + radius + outer / 2 + 1);
+    const int y1 = qMin(thumbHeight, qCeil(expected.y()) + radius + outer / 2 + 1);
+    const int w = x1 - x0;
+    const int h = y1 - y0;
+    if (w < outer || h < outer) {
+        return false;
+    }
+
+    // 搜索窗口的积分图，任意方块的墨迹和为四次查表
+    const int stride = w + 1;
+    QVector<double> integral(stride * (h + 1), 0);
+    for (int y = 0; y < h; ++y) {
+        const float *row = ink.constData() + qint64(y0 + y) * thumbWidth + x0;
+        double rowSum = 0;
+        for (int x = 0; x < w; ++x) {
+            rowSum += row[x];
+            integral[(y + 1) * stride + x + 1] = integral[y * stride + x + 1] + rowSum;
+        }
+    }
+    auto boxSum = [&](int x, int y, int bw, int bh) {
+        return integral[(y + bh) * stride + x + bw] - integral[y * stride + x + bw]
+               - integral[(y + bh) * stride + x] + integral[y * stride + x];
+    };
+
+    const double innerArea = double(size) * size;
+    const double ringArea = double(outer) * outer - innerArea;
+    double bestScore = -1;
+    int bestX = 0;
+    int bestY = 0;
+    for (int y = 0; y + outer <= h; ++y) {
+        for (int x = 0; x + outer <= w; ++x) {
+            double innerSum = boxSum(x + ring, y + ring, size, size);
+            double inner = innerSum / innerArea;
+            double surround = (boxSum(x, y, outer, outer) - innerSum) / ringArea;
+            if (inner < MinMarkFill || surround > MaxMarkSurround) {
+                continue;
+            }
+            if (inner - surround > bestScore) {
+                bestScore = inner - surround;
+                bestX = x;
+                bestY = y;
+            }
+        }
+    }
+    if (bestScore < 0) {
+        return false;
+    }
+
+    // 重心只取方块及外扩一个像素（标记边缘的部分覆盖像素），不计入附近的文字；
+    // 像素中心在 +0.5 处，重心精度远高于缩略图的一个像素
+    double sum = 0;
+    double sumX = 0;
+    double sumY = 0;
+    const int grow = qMin(1, ring);
+    for (int y = bestY + ring - grow; y < bestY + ring + size + grow; ++y) {
+        const float *row = ink.constData() + qint64(y0 + y) * thumbWidth + x0;
+        for (int x = bestX + ring - grow; x < bestX + ring + size + grow; ++x) {
+            sum += row[x];
+            sumX += row[x] * (x0 + x + 0.5);
+            sumY += row[x] * (y0 + y + 0.5);
+        }
+    }
+    *center = QPointF(sumX / sum, sumY / sum);
+    return true;
+}
+
+double determinant(const double a[3][3])
+{
+    return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+           - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+           + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+}
+
+// 最小二乘拟合仿射变换（三个点时为精确解），法方程按克莱姆法则求解
+bool fitAffine(const QVector<QPointF> &from, const QVector<QPointF> &to, double *m)
+{
+    double a[3][3] = {{0}};
+    double bx[3] = {0};
+    double by[3] = {0};
+    for (int i = 0; i < from.size(); ++i) {
+        const double v[3] = {from[i].x(), from[i].y(), 1};
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                a[r][c] += v[r] * v[c];
+            }
+            bx[r] += v[r] * to[i].x();
+            by[r] += v[r] * to[i].y();
+        }
+    }
+    const double det = determinant(a);
+    if (qAbs(det) <= 1e-12 * a[0][0] * a[1][1] * a[2][2]) {
+        return false;   // 标记共线
+    }
+    for (int k = 0; k < 3; ++k) {
+        double ax[3][3];
+        double ay[3][3];
+        std::memcpy(ax, a, sizeof(a));
+        std::memcpy(ay, a, sizeof(a));
+        for (int r = 0; r < 3; ++r) {
+            ax[r][k] = bx[r];
+            ay[r][k] = by[r];
+        }
+        m[k] = determinant(ax) / det;
+        m[3 + k] = determinant(ay) / det;
+    }
+    return true;
+}
+
+// 按标记子集拟合并检查残差和比例；skip 为不参与拟合的标记（-1 表示全部参与）
+PageRegistration fitMarks(const QVector<QPointF> &from, const QVector<QPointF> &to, int skip, double pixelsPerMm)
+{
+    PageRegistration registration;
+    QVector<QPointF> fitFrom;
+    QVector<QPointF> fitTo;
+    for (int i = 0; i < from.size(); ++i) {
+        if (i != skip) {
+            fitFrom.append(from[i]);
+            fitTo.append(to[i]);
+        }
+    }
+    registration.marksFound = fitFrom.size();
+    if (fitFrom.size() < 3 || !fitAffine(fitFrom, fitTo, registration.m)) {
+        return registration;
+    }
+    for (int i = 0; i < fitFrom.size(); ++i) {
+        QPointF delta = registration.map(fitFrom[i]) - fitTo[i];
+        registration.residual = qMax(registration.residual, std::hypot(delta.x(), delta.y()));
+    }
+    const double *m = registration.m;
+    const double scale = std::sqrt(qAbs(m[0] * m[4] - m[1] * m[3]));
+    registration.valid = registration.residual <= MaxResidualMm * pixelsPerMm
+                         && qAbs(scale / pixelsPerMm - 1) <= MaxScaleError;
+    return registration;
+}
+
+// 拼图中的一个区域
+struct Placement
+{
+    int region;
+    QRect source;       // 整页中的位置
+    int offset;         // 拼图中的起始行
+};
+}
+
+// ===== PageRegistration =====
+
+QPointF PageRegistration::map(const QPointF &mm) const
+{
+    return QPointF(m[0] * mm.x() + m[1] * mm.y() + m[2], m[3] * mm.x() + m[4] * mm.y() + m[5]);
+}
+
+QRect PageRegistration::mapRect(const QRectF &mm) const
+{
+    const QPointF corners[] = {map(mm.topLeft()), map(mm.topRight()), map(mm.bottomLeft()), map(mm.bottomRight())};
+    double left = corners[0].x();
+    double right = left;
+    double top = corners[0].y();
+    double bottom = top;
+    for (const QPointF &corner : corners) {
+        left = qMin(left, corner.x());
+        right = qMax(right, corner.x());
+        top = qMin(top, corner.y());
+        bottom = qMax(bottom, corner.y());
+    }
+    return QRectF(QPointF(left, top), QPointF(right, bottom)).toAlignedRect();
+}
+
+// ===== RegionExtractor =====
+
+PageRegistration RegionExtractor::locate(StripReader *reader, const SheetLayout &layout, int dpi,
+                                         PageBufferPool *pool)
+{
+    PageRegistration registration;
+    const int width = reader->width();
+    const int height = reader->height();
+    const int channels = reader->channels();
+    if (!layout.isValid() || width <= 0 || height <= 0) {
+        return registration;
+    }
+    // 没有分辨率信息时按纸张宽度估计
+    if (dpi <= 0) {
+        dpi = qMax(1, qRound(width * MmPerInch / layout.widthMm));
+    }
+    const int factor = qMax(1, dpi / AnalysisDpi);
+    const int thumbWidth = (width + factor - 1) / factor;
+    const int thumbHeight = (height + factor - 1) / factor;
+
+    PageBuffer strip(pool, qint64(StripRows) * reader->rowBytes());
+    if (strip.isNull()) {
+        return registration;
+    }
+
+    // 缩略图：每个 factor×factor 块的墨迹比例
+    QVector<float> ink(thumbWidth * thumbHeight, 0);
+    QVector<quint32> inkCount(thumbWidth, 0);
+    int y = 0;
+    while (y < height) {
+        int rows = reader->readRows(strip.data(), StripRows);
+        if (rows <= 0) {
+            return registration;
+        }
+        if (channels == 3) {
+            StripOps::rgbToGray(strip.data(), strip.data(), rows * width);
+        }
+        for (int row = 0; row < rows; ++row) {
+            const uchar *line = strip.data() + qint64(row) * width;
+            for (int tx = 0, x = 0; tx < thumbWidth; ++tx) {
+                const int end = qMin(width, x + factor);
+                quint32 count = 0;
+                for (; x < end; ++x) {
+                    count += line[x] < InkThreshold;
+                }
+                inkCount[tx] += count;
+            }
+
+            int imageRow = y + row;
+            if ((imageRow + 1) % factor != 0 && imageRow != height - 1) {
+                continue;
+            }
+            int thumbRow = imageRow / factor;
+            int blockRows = imageRow - thumbRow * factor + 1;
+            for (int tx = 0; tx < thumbWidth; ++tx) {
+                int blockColumns = qMin(factor, width - tx * factor);
+                ink[thumbRow * thumbWidth + tx] = inkCount[tx] / float(blockRows * blockColumns);
+            }
+            inkCount.fill(0);
+        }
+        y += rows;
+    }
+
+    // 初始估计：页面左上角即纸张左上角（纠偏裁边后基本成立），在其附近搜索各标记
+    const double pixelsPerMm = dpi / MmPerInch;
+    const double thumbPerMm = pixelsPerMm / factor;
+    const int markSize = qMax(3, qRound(layout.markSizeMm * thumbPerMm));
+    const int ring = qMax(1, markSize / 2);
+    const int radius = qCeil(SearchRadiusMm * thumbPerMm);
+    QVector<QPointF> templatePoints;
+    QVector<QPointF> pagePoints;
+    for (const QPointF &mark : layout.marks) {
+        QPointF center;
+        if (findMark(ink, thumbWidth, thumbHeight, mark * thumbPerMm, markSize, ring, radius, &center)) {
+            templatePoints.append(mark);
+            pagePoints.append(center * factor);
+        }
+    }
+
+    // 全部标记拟合不通过时，依次去掉一个标记重试（污损或被涂写的标记）
+    registration = fitMarks(templatePoints, pagePoints, -1, pixelsPerMm);
+    for (int skip = 0; !registration.valid && templatePoints.size() > 3 && skip < templatePoints.size(); ++skip) {
+        PageRegistration candidate = fitMarks(templatePoints, pagePoints, skip, pixelsPerMm);
+        if (candidate.valid) {
+            registration = candidate;
+        }
+    }
+    return registration;
+}
+
+bool RegionExtractor::extract(StripReader *reader, const SheetLayout &layout, const PageRegistration &registration,
+                              const QString &packagePath, int quality, int dpi, PageBufferPool *pool,
+                              QJsonArray *regions, OmrReader *omr, QString *error)
+{
+    const int channels = reader->channels();
+    const QRect page(0, 0, reader->width(), reader->height());
+
+    // 区域映射到整页像素后上下排列，宽度取最宽的区域
+    QVector<Placement> placements;
+    int packageWidth = 0;
+    int packageHeight = 0;
+    int lastRow = -1;
+    for (int i = 0; i < layout.regions.size(); ++i) {
+        // 区域本身超出页面说明定位有误或纸张偏移，裁出的内容不完整，整页上传；只有四周的边距可以被页面截掉
+        const QRectF &rect = layout.regions.at(i).rect;
+        const QRect mapped = registration.mapRect(rect);
+        if (mapped.isEmpty() || !page.contains(mapped)) {
+            if (error) {
+                *error = QString("Region %1 outside page: %2,%3 %4x%5").arg(i)
+                             .arg(mapped.x()).arg(mapped.y()).arg(mapped.width()).arg(mapped.height());
+            }
+            return false;
+        }
+        const QRect source = registration.mapRect(rect.adjusted(-RegionMarginMm, -RegionMarginMm,
+                                                                RegionMarginMm, RegionMarginMm)).intersected(page);
+        packageHeight = (packageHeight + PackageAlignRows - 1) / PackageAlignRows * PackageAlignRows;
+        placements.append({i, source, packageHeight});
+        packageHeight += source.height();
+        packageWidth = qMax(packageWidth, source.width());
+        lastRow = qMax(lastRow, source.bottom());
+    }
+    if (omr) {
+        lastRow = qMax(lastRow, omr->lastRow());
+    }
+    if (placements.isEmpty() && (!omr || omr->isEmpty())) {
+        if (error) *error = "No answer region on page";
+        return false;
+    }
+
+    const qint64 packageStride = qint64(packageWidth) * channels;
+    PageBuffer strip(pool, qint64(StripRows) * reader->rowBytes());
+    PageBuffer package(pool, packageStride * packageHeight);
+    if (strip.isNull() || (!placements.isEmpty() && package.isNull())) {
+        if (error) *error = "Out of memory";
+        return false;
+    }
+    if (!package.isNull()) {
+        std::memset(package.data(), 255, packageStride * packageHeight);
+    }
+
+    // 按行复制到拼图，读过最后一个区域（填涂框）的底边即停止解码
+    int y = 0;
+    while (y <= lastRow) {
+        int rows = reader->readRows(strip.data(), StripRows);
+        if (rows <= 0) {
+            if (error) *error = reader->errorString();
+            return false;
+        }
+        for (const Placement &placement : placements) {
+            const int first = qMax(y, placement.source.top());
+            const int last = qMin(y + rows - 1, placement.source.bottom());
+            for (int row = first; row <= last; ++row) {
+                std::memcpy(package.data() + (placement.offset + row - placement.source.top()) * packageStride,
+                            strip.data() + qint64(row - y) * reader->rowBytes() + placement.source.left() * channels,
+                            placement.source.width() * channels);
+            }
+        }
+        if (omr) {
+            omr->addRows(strip.data(), rows, y, reader->rowBytes());
+        }
+        y += rows;
+    }
+    if (placements.isEmpty()) {
+        return true;
+    }
+
+    // 先写临时文件再替换，上传方不会读到写了一半的拼图
+    JpegStripWriter writer;
+    QString tempPath = packagePath + ".part";
+    if (!writer.open(tempPath, packageWidth, packageHeight, channels, quality, dpi)
+        || !writer.writeRows(package.data(), packageHeight, int(packageStride)) || !writer.finish()) {
+        if (error) *error = writer.errorString();
+        QFile::remove(tempPath);
+        return false;
+    }
+    QFile::remove(packagePath);
+    if (!QFile::rename(tempPath, packagePath)) {
+        if (error) *error = "Cannot replace " + packagePath;
+        QFile::remove(tempPath);
+        return false;
+    }
+
+    for (const Placement &placement : placements) {
+        const QRect &source = placement.source;
+        regions->append(QJsonObject{
+            {"id", layout.regions.at(placement.region).id},
+            {"x", 0}, {"y", placement.offset},
+            {"width", source.width()}, {"height", source.height()},
+            {"source", QJsonArray{source.x(), source.y(), source.width(), source.height()}}
+        });
+    }
+    return true;
+}
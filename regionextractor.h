@@ -0,0 +1,37 @@
+#ifndef REGIONEXTRACTOR_H
+#define REGIONEXTRACTOR_H
+
+#include "stripimage.h"
+#include "examlayout.h"
+#include <QRect>
+#include <QJsonArray>
+
+class PageBufferPool;
+class OmrReader;
+
+// 版面坐标（毫米）到页面像素的仿射变换，由定位标记拟合
+struct PageRegistration
+{
+    bool valid = false;
+    double m[6] = {1, 0, 0, 0, 1, 0};   // x' = m0·x + m1·y + m2，y' = m3·x + m4·y + m5
+    int marksFound = 0;
+    double residual = 0;                // 定位标记拟合的最大残差（像素）
+
+    QPointF map(const QPointF &mm) const;
+    QRect mapRect(const QRectF &mm) const;  // 四角映射后的外接矩形
+};
+
+namespace RegionExtractor
+{
+    // 读取一遍页面，在约75dpi的缩略图上按版面位置附近搜索实心方块标记，拟合版面到页面的变换
+    PageRegistration locate(StripReader *reader, const SheetLayout &layout, int dpi, PageBufferPool *pool);
+
+    // 再读一遍页面，把答题区域按原分辨率裁出、上下拼成一张 JPEG（没有答题区域时不生成）；
+    // regions 返回各区域在拼图中的位置（id、x、y、width、height）和在整页中的位置（source）。
+    // omr 不为空时在同一遍读取中统计客观题填涂
+    bool extract(StripReader *reader, const SheetLayout &layout, const PageRegistration &registration,
+                 const QString &packagePath, int quality, int dpi, PageBufferPool *pool,
+                 QJsonArray *regions, OmrReader *omr = nullptr, QString *error = nullptr);
+}
+
+#endif // REGIONEXTRACTOR_H
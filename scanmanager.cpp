@@ -1,41 +1,87 @@
 #include "scanmanager.h"
+#include "processwatchdog.h"
+#include "esclclient.h"
+#include "pagebufferpool.h"
 #include <QStandardPaths>
 #include <QDateTime>
 #include <QDebug>
 #include <QFileInfo>
 #include <QRegularExpression> // Added for JSON parsing
+#include <QFile>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <algorithm>
+
+namespace {
+// 默认扫描区域：A3（297 x 420 mm），超出设备范围时按能力收窄
+const double DefaultScanWidthMm = 297.0;
+const double DefaultScanHeightMm = 420.0;
+const double PaperToleranceMm = 10.0;    // 按纸张扫描时每边多留的区域，容纳进纸歪斜供纠偏
+const int ProcessStartTimeout = 10000;   // 进程启动期限
+const int ProbeTimeout = 20000;          // 能力探测期限
+const int ScanPageTimeout = 180000;      // 单页扫描期限（A3 600dpi 彩色约需1分钟）
+const int UploadTimeout = 600000;        // 上传总期限
+const int UploadIdleTimeout = 60000;     // 上传无响应期限
+const int BatchRetryInterval = 2000;     // 设备忙时重试下一页的间隔
+}
 
 ScanManager::ScanManager(QObject *parent)
     : QObject(parent),
       m_batchTimer(new QTimer(this)),
       m_uploadServer("http://117.72.74.246:18000"),
-      m_simulationMode(false)
+      m_simulationMode(false),
+      m_watchdog(new ProcessWatchdog(this)),
+      m_bufferPool(new PageBufferPool),
+      m_pageProcessor(new PageProcessor(this))
 {
+    // 扫描进程超时后记录阶段，进程退出时上报
+    connect(m_watchdog, &ProcessWatchdog::processTimedOut,
+            this, [this](const QString &name, const QString &stage) {
+        for (auto it = m_scanProcesses.constBegin(); it != m_scanProcesses.constEnd(); ++it) {
+            if (name == "scanimage " + it.key()) {
+                m_scanTimeouts[it.key()] = stage;
+            }
+        }
+    });
+    
     // 批量扫描定时器
     connect(m_batchTimer, &QTimer::timeout, this, &ScanManager::onBatchScanTimer);
+    
+    m_pageProcessor->setBufferPool(m_bufferPool);
+    connect(m_pageProcessor, &PageProcessor::pageProcessed, this, &ScanManager::onPageProcessed);
 }
 
 ScanManager::~ScanManager()
 {
-    // 清理所有扫描进程
+    // 退出时直接结束所有外部进程，不等待其响应
     for (auto process : m_scanProcesses.values()) {
         if (process) {
-            process->terminate();
-            process->waitForFinished();
-            delete process;
+            process->disconnect(this);
+            process->kill();
         }
     }
     m_scanProcesses.clear();
     
-    // 清理所有上传进程
     for (auto process : m_uploadProcesses.values()) {
         if (process) {
-            process->terminate();
-            process->waitForFinished();
-            delete process;
+            process->disconnect(this);
+            process->kill();
         }
     }
     m_uploadProcesses.clear();
+    
+    for (auto process : m_probeProcesses.values()) {
+        process->disconnect(this);
+        process->kill();
+    }
+    m_probeProcesses.clear();
+    
+    // 后处理线程还在使用缓冲池，先等线程结束再释放缓冲池
+    delete m_pageProcessor;
+    m_pageProcessor = nullptr;
+    delete m_bufferPool;
 }
 
 
@@ -56,46 +102,279 @@ void ScanManager::setScanSettings(const QString &deviceName, int dpi, const QStr
 
 
 QString ScanManager::buildScanCommand(const QString &deviceName, const QString &outputPath)
+{
+    return "scanimage " + buildScanArguments(deviceName, outputPath).join(" ");
+}
+
+QStringList ScanManager::buildScanArguments(const QString &deviceName, const QString &outputPath, QString *error)
 {
     QStringList args;
     
-    // 基本命令
-    args << "scanimage";
-    
     // 设备选择
     if (!deviceName.isEmpty()) {
         args << "--device-name=" + deviceName;
     }
     
     // 获取该设备的扫描设置
-    int dpi = m_scanDpi.value(deviceName, 300);
-    QString format = m_scanFormat.value(deviceName, "jpeg");
-    QString mode = m_scanMode.value(deviceName, "Color");
-    bool duplex = m_scanDuplex.value(deviceName, false);
+    ScanProfile profile = scanProfile(deviceName);
+    int dpi = profile.dpi;
+    QString format = acquisitionFormat(deviceName);
+    QString mode = profile.mode;
+    bool duplex = profile.duplex == 1;
+    
+    // 扫描源选择 - 支持ADF和双面扫描；扫描区域按任务纸张
+    QString source = duplex ? "ADF Duplex" : "ADF";
+    double width = profile.widthMm;
+    double height = profile.heightMm;
+    
+    // 输出格式由 scanimage 前端处理，与设备无关
+    if (format == "jpg") {
+        format = "jpeg";
+    } else if (format == "tif") {
+        format = "tiff";
+    }
+    if (!(QStringList() << "pnm" << "tiff" << "png" << "jpeg").contains(format)) {
+        if (error) *error = "Unsupported scan format: " + format;
+        return QStringList();
+    }
+    
+    // 按设备能力校正，无法满足的设置在启动前报错
+    if (!clampScanSettings(deviceName, &dpi, &mode, &source, &width, &height, error)) {
+        return QStringList();
+    }
     
     // 扫描参数
     args << "--mode" << mode;
-    args << "-x" << "297.11" << "-y" << "420";  // A4纸张尺寸
+    args << "-x" << QString::number(width, 'f', 3) << "-y" << QString::number(height, 'f', 3);
     args << "--resolution" << QString::number(dpi);
     args << "--format" << format;
+    args << "--source" << source;
+    
+    // 输出文件
+    args << "-o" << outputPath;
+    
+    return args;
+}
+
+ScanCapabilities ScanManager::getScanCapabilities(const QString &deviceName)
+{
+    if (m_scanCapabilities.contains(deviceName)) {
+        return m_scanCapabilities.value(deviceName);
+    }
+    
+    // 读本地缓存的选项列表；没有缓存时返回无效能力，由 startScan 在扫描前异步探测
+    QFile cache(capabilityCachePath(deviceName));
+    if (cache.open(QIODevice::ReadOnly)) {
+        ScanCapabilities caps = parseScanOptions(QString::fromUtf8(cache.readAll()));
+        if (caps.valid) {
+            m_scanCapabilities.insert(deviceName, caps);
+            return caps;
+        }
+    }
+    
+    return ScanCapabilities();
+}
+
+void ScanManager::storeScanCapabilities(const QString &deviceName, const QString &output)
+{
+    ScanCapabilities caps = parseScanOptions(output);
     
-    // 扫描源选择 - 支持ADF和双面扫描
-    if (duplex) {
-        args << "--source" << "ADF Duplex";
+    if (caps.valid) {
+        qDebug() << "扫描仪能力:" << deviceName << "分辨率:" << caps.resolutions
+                 << caps.minResolution << ".." << caps.maxResolution
+                 << "模式:" << caps.modes << "扫描源:" << caps.sources
+                 << "区域:" << caps.maxWidthMm << "x" << caps.maxHeightMm << "mm";
+        
+        QFile cache(capabilityCachePath(deviceName));
+        if (cache.open(QIODevice::WriteOnly)) {
+            cache.write(output.toUtf8());
+        }
     } else {
-        args << "--source" << "ADF";
+        qDebug() << "无法读取扫描仪能力:" << deviceName;
     }
     
-    // 输出文件
-    args << "-o" << outputPath;
+    // 探测失败也缓存，避免每次扫描都重新等待设备
+    m_scanCapabilities.insert(deviceName, caps);
+}
+
+void ScanManager::refreshScanCapabilities(const QString &deviceName)
+{
+    m_scanCapabilities.remove(deviceName);
+    QFile::remove(capabilityCachePath(deviceName));
+}
+
+QString ScanManager::capabilityCachePath(const QString &deviceName) const
+{
+    // 设备名称含冒号和空格，用哈希作为文件名
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/scancaps";
+    QDir().mkpath(dir);
+    QByteArray hash = QCryptographicHash::hash(deviceName.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return dir + "/" + QString::fromLatin1(hash.left(16)) + ".txt";
+}
+
+void ScanManager::startCapabilityProbe(const QString &deviceName)
+{
+    if (m_probeProcesses.contains(deviceName)) {
+        return;
+    }
+    
+    // scanimage -A 需要连接设备，不可达时可能长时间无响应，交给看门狗限时
+    QProcess *process = new QProcess(this);
+    m_probeProcesses[deviceName] = process;
     
-    return args.join(" ");
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this, process, deviceName](int exitCode, QProcess::ExitStatus exitStatus) {
+        QString output;
+        if (exitCode == 0 && exitStatus == QProcess::NormalExit) {
+            output = QString::fromLocal8Bit(process->readAllStandardOutput());
+        }
+        m_probeProcesses.remove(deviceName);
+        process->deleteLater();
+        
+        storeScanCapabilities(deviceName, output);
+        
+        // 探测完成后开始等待中的扫描（探测失败时按原设置扫描）
+        if (m_scansAwaitingProbe.contains(deviceName)) {
+            launchScan(deviceName, m_scansAwaitingProbe.take(deviceName));
+        }
+    });
+    connect(process, &QProcess::errorOccurred,
+            this, [this, process, deviceName](QProcess::ProcessError error) {
+        if (error != QProcess::FailedToStart) return;
+        m_probeProcesses.remove(deviceName);
+        process->deleteLater();
+        
+        storeScanCapabilities(deviceName, QString());
+        if (m_scansAwaitingProbe.contains(deviceName)) {
+            launchScan(deviceName, m_scansAwaitingProbe.take(deviceName));
+        }
+    });
+    
+    qDebug() << "探测扫描仪能力:" << deviceName;
+    m_watchdog->watch(process, "scanimage -A " + deviceName, ProcessStartTimeout, ProbeTimeout);
+    process->start("scanimage", QStringList() << "--device-name=" + deviceName << "-A");
+}
+
+ScanCapabilities ScanManager::parseScanOptions(const QString &output)
+{
+    // 选项行格式：
+    //     --resolution 100|200|300|600dpi [300]
+    //     --source Flatbed|ADF|ADF Duplex [Flatbed]
+    //     -x 0..296.926mm [296.926]
+    //     --brightness -100..100% (in steps of 1) [0]
+    ScanCapabilities caps;
+    QRegularExpression optionRegex("^\\s*(-{1,2}[A-Za-z][\\w-]*)\\s+(.+?)\\s*\\[([^\\]]*)\\]\\s*$");
+    QRegularExpression rangeRegex("^(-?[\\d.]+)\\.\\.(-?[\\d.]+)");
+    
+    for (const QString &line : output.split('\n', QString::SkipEmptyParts)) {
+        QRegularExpressionMatch match = optionRegex.match(line);
+        if (!match.hasMatch()) continue;
+        
+        QString option = match.captured(1);
+        QString values = match.captured(2);
+        QString current = match.captured(3);
+        values.remove(QRegularExpression("\\s*\\(in steps of [^)]*\\)"));
+        values.remove(QRegularExpression("(dpi|mm|%)$"));
+        
+        QRegularExpressionMatch range = rangeRegex.match(values);
+        
+        if (option == "--resolution") {
+            if (range.hasMatch()) {
+                caps.minResolution = qRound(range.captured(1).toDouble());
+                caps.maxResolution = qRound(range.captured(2).toDouble());
+            } else {
+                for (const QString &value : values.split('|', QString::SkipEmptyParts)) {
+                    int dpi = value.toInt();
+                    if (dpi > 0) caps.resolutions << dpi;
+                }
+                if (!caps.resolutions.isEmpty()) {
+                    std::sort(caps.resolutions.begin(), caps.resolutions.end());
+                    caps.minResolution = caps.resolutions.first();
+                    caps.maxResolution = caps.resolutions.last();
+                }
+            }
+            caps.defaultResolution = current.remove("dpi").toInt();
+        } else if (option == "--mode") {
+            caps.modes = values.split('|', QString::SkipEmptyParts);
+        } else if (option == "--source") {
+            caps.sources = values.split('|', QString::SkipEmptyParts);
+        } else if (option == "-x" && range.hasMatch()) {
+            caps.maxWidthMm = range.captured(2).toDouble();
+        } else if (option == "-y" && range.hasMatch()) {
+            caps.maxHeightMm = range.captured(2).toDouble();
+        }
+    }
+    
+    caps.valid = caps.maxResolution > 0 && !caps.modes.isEmpty();
+    return caps;
+}
+
+bool ScanManager::clampScanSettings(const QString &deviceName, int *dpi, QString *mode, QString *source,
+                                    double *widthMm, double *heightMm, QString *error)
+{
+    QString message;
+    
+    if (*dpi <= 0) {
+        message = QString("Invalid resolution: %1").arg(*dpi);
+    } else if (*widthMm <= 0 || *heightMm <= 0) {
+        message = QString("Invalid scan area: %1 x %2 mm").arg(*widthMm).arg(*heightMm);
+    }
+    
+    // 能力未知时按原设置扫描
+    ScanCapabilities caps = getScanCapabilities(deviceName);
+    if (message.isEmpty() && caps.valid) {
+        // 分辨率：离散值取最接近的，范围值截断到范围内
+        int requested = *dpi;
+        if (!caps.resolutions.isEmpty()) {
+            int best = caps.resolutions.first();
+            for (int value : caps.resolutions) {
+                if (qAbs(value - requested) <= qAbs(best - requested)) {
+                    best = value;
+                }
+            }
+            *dpi = best;
+        } else {
+            *dpi = qBound(caps.minResolution, requested, caps.maxResolution);
+        }
+        
+        // 颜色模式：不区分大小写匹配，不支持时退回彩色
+        QString matchedMode;
+        for (const QString &value : caps.modes) {
+            if (value.compare(*mode, Qt::CaseInsensitive) == 0) matchedMode = value;
+        }
+        if (matchedMode.isEmpty()) {
+            matchedMode = caps.modes.contains("Color") ? "Color" : caps.modes.first();
+        }
+        *mode = matchedMode;
+        
+        // 扫描源：不支持双面时退回单面进纸器，没有进纸器则报错
+        if (!caps.sources.isEmpty() && !caps.sources.contains(*source)) {
+            if (*source == "ADF Duplex" && caps.sources.contains("ADF")) {
+                *source = "ADF";
+            } else {
+                message = "Unsupported scan source: " + *source;
+            }
+        }
+        
+        // 扫描区域截断到设备上限
+        if (caps.maxWidthMm > 0) *widthMm = qMin(*widthMm, caps.maxWidthMm);
+        if (caps.maxHeightMm > 0) *heightMm = qMin(*heightMm, caps.maxHeightMm);
+        
+        if (*dpi != requested) {
+            qDebug() << "扫描分辨率已校正:" << deviceName << requested << "->" << *dpi;
+        }
+    }
+    
+    if (error) {
+        *error = message;
+    }
+    return message.isEmpty();
 }
 
 QString ScanManager::getScanOutputPath(const QString &deviceName, int pageNumber)
 {
     QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
-    QString format = m_scanFormat.value(deviceName, "jpeg");
+    QString format = acquisitionFormat(deviceName);
     QString filename;
     
     if (pageNumber >= 0) {
@@ -132,6 +411,9 @@ QProcess* ScanManager::getOrCreateScanProcess(const QString &deviceName)
                 this, &ScanManager::onScanProcessFinished);
         connect(process, &QProcess::errorOccurred,
                 this, &ScanManager::onScanProcessError);
+        connect(process, &QProcess::started, this, [this, deviceName]() {
+            emit scanStarted(deviceName);
+        });
         m_scanProcesses[deviceName] = process;
     }
     return m_scanProcesses[deviceName];
@@ -152,99 +434,96 @@ QProcess* ScanManager::getOrCreateUploadProcess(const QString &deviceName)
 
 void ScanManager::cleanupProcess(const QString &deviceName, const QString &processType)
 {
+    QProcess *process = nullptr;
     if (processType == "scan") {
-        if (m_scanProcesses.contains(deviceName)) {
-            QProcess *process = m_scanProcesses[deviceName];
-            if (process) {
-                process->terminate();
-                process->waitForFinished(5000);
-                if (process->state() == QProcess::Running) {
-                    process->kill();
-                }
-                delete process;
-            }
-            m_scanProcesses.remove(deviceName);
-        }
+        process = m_scanProcesses.take(deviceName);
     } else if (processType == "upload") {
-        if (m_uploadProcesses.contains(deviceName)) {
-            QProcess *process = m_uploadProcesses[deviceName];
-            if (process) {
-                process->terminate();
-                process->waitForFinished(5000);
-                if (process->state() == QProcess::Running) {
-                    process->kill();
-                }
-                delete process;
-            }
-            m_uploadProcesses.remove(deviceName);
-        }
+        process = m_uploadProcesses.take(deviceName);
+        m_pendingUploads.remove(deviceName);
+        m_uploadingFiles.remove(deviceName);
+    }
+    if (!process) return;
+    
+    // 异步终止，进程退出后再释放，不阻塞界面线程
+    process->disconnect(this);
+    if (process->state() == QProcess::NotRunning) {
+        process->deleteLater();
+    } else {
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                process, &QObject::deleteLater);
+        ProcessWatchdog::terminateProcess(process);
     }
 }
 
 bool ScanManager::startScan(const QString &deviceName, const QString &outputPath)
 {
+    if (m_esclClients.contains(deviceName)) {
+        return startEsclScan(deviceName, outputPath, 0);
+    }
+    
     QProcess *process = getOrCreateScanProcess(deviceName);
     
-    if (process->state() == QProcess::Running) {
+    if (process->state() != QProcess::NotRunning || m_scansAwaitingProbe.contains(deviceName)) {
         qDebug() << "Scan process is already running for device:" << deviceName;
         return false;
     }
     
-    // 直接构建参数列表，避免字符串分割问题
-    QStringList args;
-    
-    // 设备选择
-    if (!deviceName.isEmpty()) {
-        args << "--device-name=" + deviceName;
+    // 首次使用的设备先异步探测能力，探测完成后再开始扫描
+    if (!m_simulationMode && !getScanCapabilities(deviceName).valid
+        && !m_scanCapabilities.contains(deviceName)) {
+        m_scansAwaitingProbe[deviceName] = outputPath;
+        startCapabilityProbe(deviceName);
+        return true;
     }
     
-    // 获取该设备的扫描设置
-    int dpi = m_scanDpi.value(deviceName, 300);
-    QString format = m_scanFormat.value(deviceName, "jpeg");
-    QString mode = m_scanMode.value(deviceName, "Color");
-    bool duplex = m_scanDuplex.value(deviceName, false);
-    
-    // 扫描参数
-    args << "--mode" << mode;
-    args << "-x" << "297.11" << "-y" << "420";  // A4纸张尺寸
-    args << "--resolution" << QString::number(dpi);
-    args << "--format" << format;
-    
-    // 扫描源选择 - 支持ADF和双面扫描
-    if (duplex) {
-        args << "--source" << "ADF Duplex";
-    } else {
-        args << "--source" << "ADF";
+    return launchScan(deviceName, outputPath);
+}
+
+bool ScanManager::launchScan(const QString &deviceName, const QString &outputPath)
+{
+    // 直接构建参数列表，避免字符串分割问题
+    QString error;
+    QStringList args = buildScanArguments(deviceName, outputPath, &error);
+    if (args.isEmpty()) {
+        failScan(deviceName, ScanOtherError, "Invalid scan settings: " + error);
+        return false;
     }
     
-    // 输出文件
-    args << "-o" << outputPath;
-    
     qDebug() << "Starting scan with command:" << args;
     
+    // 不等待进程启动：启动后发出 scanStarted，启动失败或超时由错误处理上报
+    QProcess *process = getOrCreateScanProcess(deviceName);
+    m_scanTimeouts.remove(deviceName);
+    m_scanOutputPaths[deviceName] = outputPath;
+    m_watchdog->watch(process, "scanimage " + deviceName, ProcessStartTimeout, ScanPageTimeout);
     process->start("scanimage", args);
-    
-    if (process->waitForStarted()) {
-        emit scanStarted(deviceName);
-        return true;
-    } else {
-        emit scanError(deviceName, "Failed to start scan process");
-        return false;
-    }
+    return true;
 }
 
 void ScanManager::stopScan(const QString &deviceName)
 {
+    // 操作员主动停止：结束批量扫描，不保留断点
+    if (m_batchPageCounts.contains(deviceName) || m_esclBatchTotals.contains(deviceName)) {
+        m_batchPageCounts.remove(deviceName);
+        m_currentPages.remove(deviceName);
+        m_batchInFlight.remove(deviceName);
+        m_esclBatchTotals.remove(deviceName);
+        m_esclPageOffsets.remove(deviceName);
+        m_batchFiles.remove(deviceName);
+        discardBatchCheckpoint(deviceName);
+    }
+    
     if (m_scanProcesses.contains(deviceName)) {
         QProcess *process = m_scanProcesses[deviceName];
-        if (process && process->state() == QProcess::Running) {
-            process->terminate();
-            process->waitForFinished(5000);
-            if (process->state() == QProcess::Running) {
-                process->kill();
-            }
+        if (process) {
+            ProcessWatchdog::terminateProcess(process);
         }
     }
+    m_scansAwaitingProbe.remove(deviceName);
+    
+    if (m_esclClients.contains(deviceName)) {
+        m_esclClients[deviceName]->cancelJob();
+    }
 }
 
 
@@ -263,12 +542,19 @@ void ScanManager::onScanProcessFinished(int exitCode, QProcess::ExitStatus exitS
         }
     }
     
-    if (exitCode == 0) {
-        QString outputPath = getScanOutputPath(deviceName, -1);
-        emit scanCompleted(deviceName, outputPath);
+    QString outputPath = m_scanOutputPaths.take(deviceName);
+    if (m_scanTimeouts.contains(deviceName)) {
+        failScan(deviceName, ScanTimedOut, "Scan process timed out at stage: " + m_scanTimeouts.take(deviceName));
+    } else if (exitCode == 0 && exitStatus == QProcess::NormalExit) {
+        finishScannedPage(deviceName, outputPath.isEmpty() ? getScanOutputPath(deviceName, -1) : outputPath);
+        if (m_batchInFlight.contains(deviceName)) {
+            completeBatchPage(deviceName);
+        }
     } else {
-        QString error = process->readAllStandardError();
-        emit scanError(deviceName, "Scan failed: " + error);
+        // scanimage 把 sane_strstatus() 文本写到标准错误，如
+        // "scanimage: sane_read: Document feeder jammed"
+        QString error = QString::fromLocal8Bit(process->readAllStandardError()).trimmed();
+        failScan(deviceName, parseSaneStatus(error), "Scan failed: " + error);
     }
 }
 
@@ -277,6 +563,9 @@ void ScanManager::onScanProcessError(QProcess::ProcessError error)
     QProcess *process = qobject_cast<QProcess*>(sender());
     if (!process) return;
     
+    // 进程崩溃或被看门狗终止时还会发出 finished，在那里统一上报
+    if (error == QProcess::Crashed) return;
+    
     // 找到对应的设备名称
     QString deviceName;
     for (auto it = m_scanProcesses.begin(); it != m_scanProcesses.end(); ++it) {
@@ -302,7 +591,280 @@ void ScanManager::onScanProcessError(QProcess::ProcessError error)
             break;
     }
     
-    emit scanError(deviceName, errorMsg);
+    m_scanOutputPaths.remove(deviceName);
+    failScan(deviceName, error == QProcess::Timedout ? ScanTimedOut : ScanOtherError, errorMsg);
+}
+
+void ScanManager::setPostProcessing(const QString &deviceName, const PageProcessOptions &options)
+{
+    m_postProcessing[deviceName] = options;
+}
+
+void ScanManager::disablePostProcessing(const QString &deviceName)
+{
+    m_postProcessing.remove(deviceName);
+}
+
+void ScanManager::setExamByteBudget(const QString &examType, qint64 bytesPerPage)
+{
+    if (bytesPerPage > 0) {
+        m_examByteBudgets[examType] = bytesPerPage;
+    } else {
+        m_examByteBudgets.remove(examType);
+    }
+}
+
+ScanProfile ScanManager::scanProfileForPaper(const QString &paper)
+{
+    // 任务纸张字段为 "尺寸 + 单双面"，如 "A3双面"、"A4单面"；纵向进纸
+    static const struct { const char *name; double width; double height; } sizes[] = {
+        {"A3", 297.0, 420.0}, {"A4", 210.0, 297.0}, {"A5", 148.0, 210.0},
+        {"B4", 257.0, 364.0}, {"B5", 182.0, 257.0}
+    };
+    
+    ScanProfile profile;
+    profile.paper = paper;
+    for (const auto &size : sizes) {
+        if (paper.startsWith(QLatin1String(size.name), Qt::CaseInsensitive)) {
+            profile.widthMm = size.width + 2 * PaperToleranceMm;
+            profile.heightMm = size.height + 2 * PaperToleranceMm;
+            break;
+        }
+    }
+    if (paper.contains("双面")) {
+        profile.duplex = 1;
+    } else if (paper.contains("单面")) {
+        profile.duplex = 0;
+    }
+    return profile;
+}
+
+void ScanManager::setScanProfile(const QString &deviceName, const ScanProfile &profile)
+{
+    m_scanProfiles[deviceName] = profile;
+    qDebug() << "扫描配置，设备:" << deviceName << "纸张:" << profile.paper
+             << "区域(mm):" << profile.widthMm << "x" << profile.heightMm << "双面:" << profile.duplex;
+}
+
+ScanProfile ScanManager::scanProfile(const QString &deviceName) const
+{
+    // 任务未指定的项取设备设置，区域未知时扫描整个 A3 区域
+    ScanProfile profile = m_scanProfiles.value(deviceName);
+    if (profile.widthMm <= 0 || profile.heightMm <= 0) {
+        profile.widthMm = DefaultScanWidthMm;
+        profile.heightMm = DefaultScanHeightMm;
+    }
+    if (profile.duplex < 0) {
+        profile.duplex = m_scanDuplex.value(deviceName, false) ? 1 : 0;
+    }
+    if (profile.dpi <= 0) {
+        profile.dpi = m_scanDpi.value(deviceName, 300);
+    }
+    profile.mode = acquisitionMode(deviceName);
+    return profile;
+}
+
+void ScanManager::setExamBinarization(const QString &examType, const QString &method)
+{
+    if (!method.isEmpty()) {
+        m_examBinarizations[examType] = method;
+    } else {
+        m_examBinarizations.remove(examType);
+    }
+}
+
+void ScanManager::setExamLayout(const QString &examType, const ExamLayout &layout)
+{
+    if (layout.isValid()) {
+        m_examLayouts[examType] = layout;
+    } else {
+        m_examLayouts.remove(examType);
+    }
+}
+
+QString ScanManager::batchBinarization(const QString &deviceName) const
+{
+    // 当前批次所属考试要求黑白输出（需启用后处理）
+    if (!m_postProcessing.contains(deviceName)) {
+        return QString();
+    }
+    return m_examBinarizations.value(m_batchCheckpoints.value(deviceName).examType);
+}
+
+QString ScanManager::acquisitionMode(const QString &deviceName) const
+{
+    // 黑白输出的批次以灰度采集：数据量为彩色的1/3，二值化也只用灰度
+    // （设备不支持 Gray 时 clampScanSettings 会退回彩色，后处理再转换）
+    QString mode = m_scanProfiles.value(deviceName).mode;
+    if (mode.isEmpty()) {
+        mode = m_scanMode.value(deviceName, "Color");
+    }
+    if (mode.compare("Color", Qt::CaseInsensitive) == 0 && !batchBinarization(deviceName).isEmpty()) {
+        return "Gray";
+    }
+    return mode;
+}
+
+QString ScanManager::acquisitionFormat(const QString &deviceName) const
+{
+    // 启用后处理时 SANE 扫描输出未压缩的 PNM，由后处理线程直接编码，避免二次 JPEG 压缩
+    QString format = m_scanFormat.value(deviceName, "jpeg");
+    if ((format == "jpeg" || format == "jpg") && m_postProcessing.contains(deviceName)
+        && !m_esclClients.contains(deviceName)) {
+        return "pnm";
+    }
+    return format;
+}
+
+void ScanManager::finishScannedPage(const QString &deviceName, const QString &filePath)
+{
+    // 图像处理不在界面线程进行，交给后处理线程池
+    emit scanCompleted(deviceName, filePath);
+    if (!m_postProcessing.contains(deviceName)) {
+        return;
+    }
+    
+    PageProcessOptions options = m_postProcessing.value(deviceName);
+    options.dpi = scanProfile(deviceName).dpi;
+    QString examType = m_batchCheckpoints.value(deviceName).examType;
+    QString binarization = batchBinarization(deviceName);
+    if (!binarization.isEmpty()) {
+        // 黑白输出：二值化后编码为 G4 TIFF，字节预算不再适用
+        options.binarization = binarization;
+    } else if (filePath.endsWith(".pnm")) {
+        options.format = "jpeg";
+        
+        // 当前批次所属考试设置了预算时按预算选择质量
+        if (m_examByteBudgets.contains(examType)) {
+            options.targetBytes = m_examByteBudgets.value(examType);
+        }
+    }
+    
+    // 页面在批次中的序号决定正反面（eSCL 页面此时已计入批次，SANE 页面尚未计入）
+    if (m_examLayouts.contains(examType)) {
+        const QStringList files = m_batchFiles.value(deviceName);
+        int pageIndex = files.indexOf(filePath);
+        options.layout = m_examLayouts.value(examType).side(pageIndex < 0 ? files.size() : pageIndex);
+    }
+    m_processingPages[deviceName] += 1;
+    m_pageProcessor->submit(deviceName, filePath, options);
+}
+
+void ScanManager::finishBatch(const QString &deviceName, const QStringList &filePaths)
+{
+    // 还有页面在后处理（文件名可能随格式变化）时，等处理完再上报整批文件
+    if (m_processingPages.value(deviceName) > 0) {
+        m_processedBatches[deviceName] = filePaths;
+        return;
+    }
+    emit batchScanCompleted(deviceName, filePaths);
+}
+
+void ScanManager::onPageProcessed(const QString &deviceName, const PageResult &result)
+{
+    // 处理后的文件替换批次和断点中的原始文件
+    if (result.ok && result.outputPath != result.sourcePath) {
+        if (m_batchFiles.contains(deviceName)) {
+            m_batchFiles[deviceName].replaceInStrings(result.sourcePath, result.outputPath);
+        }
+        if (m_processedBatches.contains(deviceName)) {
+            m_processedBatches[deviceName].replaceInStrings(result.sourcePath, result.outputPath);
+        }
+        if (m_batchCheckpoints.contains(deviceName)) {
+            m_batchCheckpoints[deviceName].files.replaceInStrings(result.sourcePath, result.outputPath);
+            saveBatchCheckpoint(deviceName);
+        }
+    }
+    emit pageProcessed(deviceName, result);
+    
+    if (--m_processingPages[deviceName] <= 0) {
+        m_processingPages.remove(deviceName);
+        if (m_processedBatches.contains(deviceName)) {
+            emit batchScanCompleted(deviceName, m_processedBatches.take(deviceName));
+        }
+    }
+}
+
+ScanManager::ScanError ScanManager::parseSaneStatus(const QString &message)
+{
+    // sane_strstatus() 的固定文本，后端之间一致
+    if (message.contains("jam", Qt::CaseInsensitive)) {
+        return ScanJammed;
+    }
+    if (message.contains("out of documents", Qt::CaseInsensitive)) {
+        return ScanNoDocuments;
+    }
+    if (message.contains("cover is open", Qt::CaseInsensitive)) {
+        return ScanCoverOpen;
+    }
+    if (message.contains("Device busy", Qt::CaseInsensitive)) {
+        return ScanDeviceBusy;
+    }
+    if (message.contains("Error during device I/O", Qt::CaseInsensitive)) {
+        return ScanIoError;
+    }
+    return ScanOtherError;
+}
+
+ScanManager::ScanError ScanManager::classifyEsclError(const QString &message)
+{
+    // EsclClient 的错误文本："<请求> timed out" 或 "<请求> failed: HTTP <状态码> <说明>"
+    if (message.endsWith(" timed out")) {
+        return ScanTimedOut;
+    }
+    QRegularExpressionMatch match = QRegularExpression("HTTP (\\d+)").match(message);
+    if (!match.hasMatch()) {
+        return ScanOtherError;          // 取消任务、未设置地址等
+    }
+    int status = match.captured(1).toInt();
+    if (status == 0) {
+        return ScanIoError;             // 连接失败，没有收到 HTTP 响应
+    }
+    if (status == 503 || status == 409) {
+        return ScanDeviceBusy;          // 扫描仪正被占用或正在处理上一个任务
+    }
+    if (status >= 500) {
+        return ScanIoError;             // 扫描仪内部错误（卡纸等），排除后可重试
+    }
+    return ScanOtherError;              // 其他 4xx 是请求本身的问题，重试也会失败
+}
+
+bool ScanManager::isRecoverableScanError(ScanError error)
+{
+    // 操作员在设备上处理后即可继续的故障
+    return error == ScanJammed || error == ScanNoDocuments || error == ScanCoverOpen
+           || error == ScanDeviceBusy || error == ScanIoError || error == ScanTimedOut;
+}
+
+void ScanManager::failScan(const QString &deviceName, ScanError error, const QString &message)
+{
+    emit scanError(deviceName, message);
+    
+    // 批量扫描中的故障：当前页作废，停止后续页面并保存断点
+    if (!m_batchInFlight.contains(deviceName)) {
+        return;
+    }
+    QFile::remove(m_batchInFlight.take(deviceName));   // 卡纸时可能留下不完整的文件
+    m_batchPageCounts.remove(deviceName);
+    m_currentPages.remove(deviceName);
+    m_batchFiles.remove(deviceName);
+    
+    // 设置错误等在设备上排除不了的故障，续扫也会同样失败，不保留断点
+    if (!isRecoverableScanError(error)) {
+        qDebug() << "批量扫描失败，不可续扫:" << deviceName << error;
+        discardBatchCheckpoint(deviceName);
+        emit batchScanFailed(deviceName, message);
+        return;
+    }
+    
+    BatchCheckpoint &checkpoint = m_batchCheckpoints[deviceName];
+    checkpoint.error = error;
+    checkpoint.errorMessage = message;
+    saveBatchCheckpoint(deviceName);
+    
+    qDebug() << "批量扫描中断:" << deviceName << error << "已完成:" << checkpoint.completedPages
+             << "/" << checkpoint.totalPages;
+    emit batchScanInterrupted(deviceName, error, checkpoint.completedPages, checkpoint.totalPages);
 }
 
  
@@ -323,10 +885,20 @@ void ScanManager::setUploadServer(const QString &serverUrl)
 // 新增：上传文件
 void ScanManager::uploadFile(const QString &deviceName, const QString &filePath, const QString &parentPath)
 {
-    if (!QFile::exists(filePath)) {
-        emit uploadError(deviceName, "文件不存在: " + filePath);
+    uploadFiles(deviceName, QStringList() << filePath, parentPath);
+}
+
+void ScanManager::uploadFiles(const QString &deviceName, const QStringList &filePaths, const QString &parentPath)
+{
+    if (filePaths.isEmpty()) {
         return;
     }
+    for (const QString &filePath : filePaths) {
+        if (!QFile::exists(filePath)) {
+            emit uploadError(deviceName, "文件不存在: " + filePath);
+            return;
+        }
+    }
     
     QProcess *process = getOrCreateUploadProcess(deviceName);
     if (!process) {
@@ -334,18 +906,42 @@ void ScanManager::uploadFile(const QString &deviceName, const QString &filePath,
         return;
     }
     
+    // 后处理线程池连续完成多页时，上一个 curl 还在上传就排队，避免重启正在运行的进程丢掉页面
+    if (process->state() != QProcess::NotRunning) {
+        m_pendingUploads[deviceName].append(qMakePair(filePaths, parentPath));
+        qDebug() << "上传排队:" << filePaths << "等待:" << m_pendingUploads.value(deviceName).size();
+        return;
+    }
+    
     QStringList args;
     args << "-X" << "POST";
     args << m_uploadServer + "/system/file/upload";
     args << "-F" << "parentPath=" + parentPath;
-    args << "-F" << "file=@" + filePath;
+    for (const QString &filePath : filePaths) {
+        args << "-F" << "file=@" + filePath;
+    }
     
-    qDebug() << "开始上传文件:" << filePath;
-    emit uploadStarted(deviceName, filePath);
+    qDebug() << "开始上传文件:" << filePaths;
+    emit uploadStarted(deviceName, filePaths.first());
+    m_uploadingFiles[deviceName] = filePaths;
     
+    m_watchdog->watch(process, "curl upload " + deviceName, ProcessStartTimeout, UploadTimeout, UploadIdleTimeout);
     process->start("curl", args);
 }
 
+void ScanManager::uploadNextFiles(const QString &deviceName)
+{
+    if (m_pendingUploads.value(deviceName).isEmpty()) {
+        return;
+    }
+    
+    QPair<QStringList, QString> next = m_pendingUploads[deviceName].takeFirst();
+    if (m_pendingUploads[deviceName].isEmpty()) {
+        m_pendingUploads.remove(deviceName);
+    }
+    uploadFiles(deviceName, next.first, next.second);
+}
+
 void ScanManager::onUploadProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
     QProcess *process = qobject_cast<QProcess*>(sender());
@@ -360,23 +956,38 @@ void ScanManager::onUploadProcessFinished(int exitCode, QProcess::ExitStatus exi
         }
     }
     
-    if (exitCode == 0) {
+    QStringList files = m_uploadingFiles.take(deviceName);
+    if (exitCode == 0 && exitStatus == QProcess::NormalExit) {
         QString output = process->readAllStandardOutput();
-        // 解析JSON响应获取文件URL
+        // 解析JSON响应获取文件URL：多个文件一次上传时按表单顺序返回各自的地址，
+        // 每个文件单独上报结果，没有返回地址的文件上报错误
         QRegularExpression regex("\"url\":\"([^\"]+)\"");
-        QRegularExpressionMatch match = regex.match(output);
+        QStringList fileUrls;
+        QRegularExpressionMatchIterator it = regex.globalMatch(output);
+        while (it.hasNext()) {
+            fileUrls << it.next().captured(1);
+        }
         
-        if (match.hasMatch()) {
-            QString fileUrl = match.captured(1);
-            emit uploadCompleted(deviceName, fileUrl);
-            qDebug() << "文件上传成功:" << fileUrl;
-        } else {
+        if (fileUrls.isEmpty()) {
             emit uploadError(deviceName, "无法解析上传响应");
+        } else {
+            for (int i = 0; i < qMax(files.size(), 1); ++i) {
+                QString filePath = files.value(i);
+                if (i < fileUrls.size()) {
+                    emit uploadCompleted(deviceName, fileUrls.at(i));
+                    qDebug() << "文件上传成功:" << filePath << fileUrls.at(i);
+                } else {
+                    emit uploadError(deviceName, "上传响应中没有文件地址: " + filePath);
+                }
+            }
         }
     } else {
         QString error = process->readAllStandardError();
         emit uploadError(deviceName, "上传失败: " + error);
     }
+    
+    // 上传队列中的下一批文件
+    uploadNextFiles(deviceName);
 }
 
 void ScanManager::onUploadProcessError(QProcess::ProcessError error)
@@ -393,6 +1004,9 @@ void ScanManager::onUploadProcessError(QProcess::ProcessError error)
         }
     }
     
+    // 进程崩溃或被看门狗终止时还会发出 finished，在那里统一上报
+    if (error == QProcess::Crashed) return;
+    
     QString errorMsg;
     switch (error) {
         case QProcess::FailedToStart:
@@ -410,6 +1024,12 @@ void ScanManager::onUploadProcessError(QProcess::ProcessError error)
     }
     
     emit uploadError(deviceName, errorMsg);
+    
+    // 启动失败不会发出 finished，继续上传排队的文件
+    if (error == QProcess::FailedToStart) {
+        m_uploadingFiles.remove(deviceName);
+        uploadNextFiles(deviceName);
+    }
 } 
 
 void ScanManager::simulateScan(const QString &deviceName)
@@ -436,68 +1056,410 @@ void ScanManager::simulateScan(const QString &deviceName)
 }
 
 bool ScanManager::startBatchScan(const QString &deviceName, const QString &examType, 
-                               const QString &className, const QString &subject, int pageCount)
+                               const QString &className, const QString &subject, int pageCount,
+                               const QString &paper)
 {
     qDebug() << "开始批量扫描，设备:" << deviceName 
              << "考试类型:" << examType 
              << "班级:" << className 
              << "学科:" << subject 
-             << "页数:" << pageCount;
-    
-    // 初始化批量扫描状态
-    m_batchPageCounts[deviceName] = pageCount;
-    m_currentPages[deviceName] = 0;
-    m_batchFiles[deviceName].clear();
+             << "页数:" << pageCount
+             << "纸张:" << paper;
     
     // 创建输出目录
     createOutputDirectory(deviceName);
     
-    // 启动批量扫描定时器
-    m_batchTimer->start(2000); // 每2秒扫描一页
+    if (m_batchPageCounts.contains(deviceName) || m_esclBatchTotals.contains(deviceName)) {
+        qDebug() << "Batch scan is already running for device:" << deviceName;
+        return false;
+    }
     
-    emit scanStarted(deviceName);
-    return true;
+    // 中断的批次须先续扫或放弃，新批次不能覆盖它的断点
+    if (hasBatchCheckpoint(deviceName)) {
+        qDebug() << "Interrupted batch pending for device, resume or discard it first:" << deviceName;
+        return false;
+    }
+    
+    BatchCheckpoint checkpoint;
+    checkpoint.valid = true;
+    checkpoint.examType = examType;
+    checkpoint.className = className;
+    checkpoint.subject = subject;
+    checkpoint.paper = paper;
+    checkpoint.totalPages = pageCount;
+    m_batchCheckpoints[deviceName] = checkpoint;
+    saveBatchCheckpoint(deviceName);
+    
+    return runBatchScan(deviceName);
 }
 
-void ScanManager::onBatchScanTimer()
+bool ScanManager::resumeBatchScan(const QString &deviceName)
 {
-    // 遍历所有进行批量扫描的设备
-    for (auto it = m_batchPageCounts.begin(); it != m_batchPageCounts.end(); ++it) {
-        QString deviceName = it.key();
-        int totalPages = it.value();
-        int currentPage = m_currentPages.value(deviceName, 0);
-        
-        if (currentPage < totalPages) {
-            // 扫描当前页
-            QString outputPath = getScanOutputPath(deviceName, currentPage + 1);
-            
-            if (startScan(deviceName, outputPath)) {
-                m_batchFiles[deviceName].append(outputPath);
-                m_currentPages[deviceName] = currentPage + 1;
-                
-                emit scanProgress(deviceName, currentPage + 1, totalPages);
-                
-                qDebug() << "批量扫描进度:" << deviceName 
-                         << "当前页:" << (currentPage + 1) 
-                         << "总页数:" << totalPages;
-            }
-        } else {
-            // 批量扫描完成
-            QStringList filePaths = m_batchFiles.value(deviceName);
-            emit batchScanCompleted(deviceName, filePaths);
-            
-            qDebug() << "批量扫描完成:" << deviceName 
-                     << "文件数量:" << filePaths.size();
-            
-            // 清理状态
-            m_batchPageCounts.remove(deviceName);
-            m_currentPages.remove(deviceName);
-            m_batchFiles.remove(deviceName);
+    if (!hasBatchCheckpoint(deviceName)) {
+        qDebug() << "No batch checkpoint for device:" << deviceName;
+        return false;
+    }
+    if (m_batchPageCounts.contains(deviceName) || m_esclBatchTotals.contains(deviceName)) {
+        return false;
+    }
+    
+    BatchCheckpoint &checkpoint = m_batchCheckpoints[deviceName];
+    qDebug() << "继续批量扫描:" << deviceName << "从第" << (checkpoint.completedPages + 1) << "页开始，共"
+             << checkpoint.totalPages << "页";
+    checkpoint.error = NoScanError;
+    checkpoint.errorMessage.clear();
+    createOutputDirectory(deviceName);
+    return runBatchScan(deviceName);
+}
+
+bool ScanManager::runBatchScan(const QString &deviceName)
+{
+    const BatchCheckpoint checkpoint = m_batchCheckpoints.value(deviceName);
+    m_batchFiles[deviceName] = checkpoint.files;
+    setScanProfile(deviceName, scanProfileForPaper(checkpoint.paper));
+    
+    // eSCL 直连：一个扫描任务连续拉取剩余页面
+    if (m_esclClients.contains(deviceName)) {
+        m_esclBatchTotals[deviceName] = checkpoint.totalPages;
+        m_esclPageOffsets[deviceName] = checkpoint.completedPages;
+        if (!startEsclScan(deviceName, QString(), checkpoint.totalPages - checkpoint.completedPages)) {
+            m_esclBatchTotals.remove(deviceName);
+            m_esclPageOffsets.remove(deviceName);
+            return false;
         }
+        return true;
+    }
+    
+    // 每页一个 scanimage 进程，上一页成功后立即扫描下一页
+    m_batchPageCounts[deviceName] = checkpoint.totalPages;
+    m_currentPages[deviceName] = checkpoint.completedPages;
+    startNextBatchPage(deviceName);
+    if (m_batchPageCounts.contains(deviceName) && !m_batchTimer->isActive()) {
+        m_batchTimer->start(BatchRetryInterval);
+    }
+    return m_batchPageCounts.contains(deviceName);
+}
+
+void ScanManager::startNextBatchPage(const QString &deviceName)
+{
+    if (m_batchInFlight.contains(deviceName) || !m_batchPageCounts.contains(deviceName)) {
+        return;
+    }
+    
+    int page = m_currentPages.value(deviceName) + 1;
+    QString outputPath = getScanOutputPath(deviceName, page);
+    m_batchInFlight[deviceName] = outputPath;
+    
+    // 设备忙时返回 false，由定时器稍后重试；设置错误等故障已在 failScan 中中断批次
+    if (!startScan(deviceName, outputPath)) {
+        m_batchInFlight.remove(deviceName);
+    }
+}
+
+void ScanManager::completeBatchPage(const QString &deviceName)
+{
+    // 页面只在 scanimage 成功退出后计入，断点随之前进
+    QString path = m_batchInFlight.take(deviceName);
+    int page = m_currentPages.value(deviceName) + 1;
+    int totalPages = m_batchPageCounts.value(deviceName);
+    m_currentPages[deviceName] = page;
+    m_batchFiles[deviceName].append(path);
+    
+    BatchCheckpoint &checkpoint = m_batchCheckpoints[deviceName];
+    checkpoint.completedPages = page;
+    checkpoint.files = m_batchFiles.value(deviceName);
+    
+    emit scanProgress(deviceName, page, totalPages);
+    qDebug() << "批量扫描进度:" << deviceName << "当前页:" << page << "总页数:" << totalPages;
+    
+    if (page < totalPages) {
+        saveBatchCheckpoint(deviceName);
+        startNextBatchPage(deviceName);
+        return;
+    }
+    
+    // 批量扫描完成
+    QStringList filePaths = m_batchFiles.take(deviceName);
+    m_batchPageCounts.remove(deviceName);
+    m_currentPages.remove(deviceName);
+    discardBatchCheckpoint(deviceName);
+    
+    qDebug() << "批量扫描完成:" << deviceName << "文件数量:" << filePaths.size();
+    finishBatch(deviceName, filePaths);
+}
+
+void ScanManager::onBatchScanTimer()
+{
+    // 只负责重试因设备忙未能启动的页面，正常情况下由上一页完成时启动下一页
+    for (const QString &deviceName : m_batchPageCounts.keys()) {
+        startNextBatchPage(deviceName);
     }
     
     // 如果没有设备在进行批量扫描，停止定时器
     if (m_batchPageCounts.isEmpty()) {
         m_batchTimer->stop();
     }
-} 
\ No newline at end of file
+}
+
+QString ScanManager::checkpointPath(const QString &deviceName) const
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/scancheckpoints";
+    QDir().mkpath(dir);
+    QByteArray hash = QCryptographicHash::hash(deviceName.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return dir + "/" + QString::fromLatin1(hash.left(16)) + ".json";
+}
+
+void ScanManager::saveBatchCheckpoint(const QString &deviceName)
+{
+    // 每完成一页写一次，程序崩溃或重启后仍可续扫
+    const BatchCheckpoint checkpoint = m_batchCheckpoints.value(deviceName);
+    QJsonObject object;
+    object["device"] = deviceName;
+    object["examType"] = checkpoint.examType;
+    object["className"] = checkpoint.className;
+    object["subject"] = checkpoint.subject;
+    object["paper"] = checkpoint.paper;
+    object["totalPages"] = checkpoint.totalPages;
+    object["completedPages"] = checkpoint.completedPages;
+    object["files"] = QJsonArray::fromStringList(checkpoint.files);
+    object["error"] = checkpoint.error;
+    object["errorMessage"] = checkpoint.errorMessage;
+    
+    QFile file(checkpointPath(deviceName));
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    }
+}
+
+void ScanManager::loadBatchCheckpoint(const QString &deviceName)
+{
+    if (m_batchCheckpoints.contains(deviceName)) {
+        return;
+    }
+    
+    QFile file(checkpointPath(deviceName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QJsonObject object = QJsonDocument::fromJson(file.readAll()).object();
+    if (object.value("device").toString() != deviceName) {
+        return;
+    }
+    
+    BatchCheckpoint checkpoint;
+    checkpoint.examType = object.value("examType").toString();
+    checkpoint.className = object.value("className").toString();
+    checkpoint.subject = object.value("subject").toString();
+    checkpoint.paper = object.value("paper").toString();
+    checkpoint.totalPages = object.value("totalPages").toInt();
+    checkpoint.error = object.value("error").toInt();
+    checkpoint.errorMessage = object.value("errorMessage").toString();
+    
+    // 只承认仍然存在的文件，断点按连续存在的页面计算
+    for (const QJsonValue &value : object.value("files").toArray()) {
+        if (!QFile::exists(value.toString())) break;
+        checkpoint.files << value.toString();
+    }
+    checkpoint.completedPages = checkpoint.files.size();
+    checkpoint.valid = checkpoint.totalPages > 0;
+    
+    // 上次运行中途退出的批次也视为中断
+    if (checkpoint.valid && checkpoint.error == NoScanError) {
+        checkpoint.error = ScanOtherError;
+        checkpoint.errorMessage = "Batch scan interrupted by application exit";
+    }
+    if (checkpoint.valid) {
+        m_batchCheckpoints[deviceName] = checkpoint;
+    }
+}
+
+bool ScanManager::hasBatchCheckpoint(const QString &deviceName) const
+{
+    const_cast<ScanManager*>(this)->loadBatchCheckpoint(deviceName);
+    const BatchCheckpoint checkpoint = m_batchCheckpoints.value(deviceName);
+    return checkpoint.valid && checkpoint.error != NoScanError
+           && checkpoint.completedPages < checkpoint.totalPages;
+}
+
+BatchCheckpoint ScanManager::batchCheckpoint(const QString &deviceName) const
+{
+    const_cast<ScanManager*>(this)->loadBatchCheckpoint(deviceName);
+    return m_batchCheckpoints.value(deviceName);
+}
+
+void ScanManager::discardBatchCheckpoint(const QString &deviceName)
+{
+    m_batchCheckpoints.remove(deviceName);
+    QFile::remove(checkpointPath(deviceName));
+}
+
+void ScanManager::setEsclEndpoint(const QString &deviceName, const QUrl &baseUrl)
+{
+    EsclClient *client = m_esclClients.value(deviceName, nullptr);
+    
+    if (!baseUrl.isValid() || baseUrl.isEmpty()) {
+        if (client) {
+            client->cancelJob();
+            client->deleteLater();
+            m_esclClients.remove(deviceName);
+        }
+        return;
+    }
+    
+    if (!client) {
+        client = new EsclClient(this);
+        connect(client, &EsclClient::jobStarted, this, [this, deviceName]() {
+            emit scanStarted(deviceName);
+        });
+        connect(client, &EsclClient::pageReceived, this, [this, deviceName](int page, const QByteArray &data) {
+            onEsclPage(deviceName, page, data);
+        });
+        connect(client, &EsclClient::jobCompleted, this, [this, deviceName](int pages) {
+            onEsclFinished(deviceName, pages, QString());
+        });
+        connect(client, &EsclClient::jobFailed, this, [this, deviceName](const QString &error) {
+            onEsclFinished(deviceName, 0, error);
+        });
+        // 与 scanimage 使用相同的期限，超时记入同一看门狗的统计
+        client->setTimeouts(ProcessStartTimeout, ScanPageTimeout);
+        connect(client, &EsclClient::requestTimedOut, this, [this, deviceName](const QString &request) {
+            m_watchdog->recordTimeout("escl " + deviceName, request);
+        });
+        m_esclClients[deviceName] = client;
+    }
+    
+    client->setBaseUrl(baseUrl);
+    qDebug() << "eSCL 直连扫描:" << deviceName << baseUrl;
+}
+
+bool ScanManager::buildEsclSettings(const QString &deviceName, EsclScanSettings *settings, QString *error)
+{
+    ScanProfile profile = scanProfile(deviceName);
+    int dpi = profile.dpi;
+    QString format = m_scanFormat.value(deviceName, "jpeg");
+    QString mode = profile.mode;
+    bool duplex = profile.duplex == 1;
+    QString source = duplex ? "ADF Duplex" : "ADF";
+    double width = profile.widthMm;
+    double height = profile.heightMm;
+    
+    if (!clampScanSettings(deviceName, &dpi, &mode, &source, &width, &height, error)) {
+        return false;
+    }
+    
+    // SANE 选项名转换为 eSCL 取值
+    if (format == "jpeg" || format == "jpg") {
+        settings->documentFormat = "image/jpeg";
+    } else if (format == "png") {
+        settings->documentFormat = "image/png";
+    } else if (format == "tiff" || format == "tif") {
+        settings->documentFormat = "image/tiff";
+    } else {
+        if (error) *error = "Unsupported eSCL format: " + format;
+        return false;
+    }
+    
+    if (mode.compare("Gray", Qt::CaseInsensitive) == 0) {
+        settings->colorMode = "Grayscale8";
+    } else if (mode.compare("Lineart", Qt::CaseInsensitive) == 0) {
+        settings->colorMode = "BlackAndWhite1";
+    } else {
+        settings->colorMode = "RGB24";
+    }
+    
+    settings->resolution = dpi;
+    settings->inputSource = source == "Flatbed" ? "Platen" : "Feeder";
+    settings->duplex = source == "ADF Duplex";
+    settings->widthMm = width;
+    settings->heightMm = height;
+    return true;
+}
+
+bool ScanManager::startEsclScan(const QString &deviceName, const QString &outputPath, int maxPages)
+{
+    EsclClient *client = m_esclClients.value(deviceName);
+    if (client->isBusy()) {
+        qDebug() << "eSCL scan is already running for device:" << deviceName;
+        return false;
+    }
+    
+    EsclScanSettings settings;
+    QString error;
+    if (!buildEsclSettings(deviceName, &settings, &error)) {
+        emit scanError(deviceName, "Invalid scan settings: " + error);
+        return false;
+    }
+    
+    m_esclOutputPaths[deviceName] = outputPath;
+    return client->startJob(settings, maxPages);
+}
+
+void ScanManager::onEsclPage(const QString &deviceName, int page, const QByteArray &data)
+{
+    QString path;
+    if (m_esclBatchTotals.contains(deviceName)) {
+        path = getScanOutputPath(deviceName, m_esclPageOffsets.value(deviceName) + page);
+    } else {
+        // 单次扫描：第一页写入指定路径，后续页面加页码后缀
+        QString base = m_esclOutputPaths.value(deviceName);
+        if (base.isEmpty()) {
+            base = getScanOutputPath(deviceName, -1);
+        }
+        if (page == 1) {
+            path = base;
+        } else {
+            QFileInfo info(base);
+            path = info.path() + "/" + info.completeBaseName()
+                   + QString("_p%1.").arg(page) + info.suffix();
+        }
+    }
+    
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        emit scanError(deviceName, "Failed to write scanned page: " + path);
+        return;
+    }
+    file.close();
+    
+    if (m_esclBatchTotals.contains(deviceName)) {
+        m_batchFiles[deviceName].append(path);
+        BatchCheckpoint &checkpoint = m_batchCheckpoints[deviceName];
+        checkpoint.files = m_batchFiles.value(deviceName);
+        checkpoint.completedPages = checkpoint.files.size();
+        saveBatchCheckpoint(deviceName);
+        emit scanProgress(deviceName, checkpoint.completedPages, m_esclBatchTotals.value(deviceName));
+    }
+    finishScannedPage(deviceName, path);
+}
+
+void ScanManager::onEsclFinished(const QString &deviceName, int pages, const QString &error)
+{
+    m_esclOutputPaths.remove(deviceName);
+    
+    if (!error.isEmpty()) {
+        emit scanError(deviceName, "eSCL scan failed: " + error);
+    }
+    
+    if (m_esclBatchTotals.contains(deviceName)) {
+        m_esclBatchTotals.remove(deviceName);
+        m_esclPageOffsets.remove(deviceName);
+        QStringList filePaths = m_batchFiles.take(deviceName);
+        qDebug() << "批量扫描完成:" << deviceName << "页数:" << pages << "文件数量:" << filePaths.size();
+        ScanError scanError = error.isEmpty() ? NoScanError : classifyEsclError(error);
+        if (error.isEmpty()) {
+            discardBatchCheckpoint(deviceName);
+            finishBatch(deviceName, filePaths);
+        } else if (!isRecoverableScanError(scanError)) {
+            qDebug() << "批量扫描失败，不可续扫:" << deviceName << scanError;
+            discardBatchCheckpoint(deviceName);
+            emit batchScanFailed(deviceName, error);
+        } else {
+            // 已收到的页面保留在断点中
+            BatchCheckpoint &checkpoint = m_batchCheckpoints[deviceName];
+            checkpoint.error = scanError;
+            checkpoint.errorMessage = error;
+            saveBatchCheckpoint(deviceName);
+            emit batchScanInterrupted(deviceName, scanError, checkpoint.completedPages, checkpoint.totalPages);
+        }
+    }
+}
@@ -7,12 +7,73 @@
 #include <QDir>
 #include <QTimer>
 #include <QMap> // Added for QMap
+#include <QList>
+#include <QUrl>
+#include "pageprocessor.h"
+
+class ProcessWatchdog;
+class PageBufferPool;
+class EsclClient;
+struct EsclScanSettings;
+
+// 扫描仪能力（解析自 scanimage -A 的后端选项列表，按设备缓存）
+struct ScanCapabilities
+{
+    bool valid = false;
+    QList<int> resolutions;       // 离散分辨率(dpi)；为空时使用范围
+    int minResolution = 0;
+    int maxResolution = 0;
+    int defaultResolution = 0;
+    QStringList modes;            // Color / Gray / Lineart
+    QStringList sources;          // Flatbed / ADF / ADF Duplex
+    double maxWidthMm = 0;        // 扫描区域上限（毫米）
+    double maxHeightMm = 0;
+};
+
+// 按任务的扫描配置：纸张尺寸决定扫描区域，未指定的项使用设备的扫描设置
+struct ScanProfile
+{
+    QString paper;                // 任务的纸张字段，如 "A3双面"、"A4单面"
+    double widthMm = 0;           // 扫描区域（毫米），0 表示默认 A3 区域
+    double heightMm = 0;
+    int duplex = -1;              // 1 双面 / 0 单面 / -1 使用设备设置
+    int dpi = 0;                  // 0 表示使用设备设置
+    QString mode;                 // 空表示使用设备设置
+};
+
+// 批量扫描断点：记录已成功的页面，卡纸等故障排除后从下一页继续
+struct BatchCheckpoint
+{
+    bool valid = false;
+    QString examType;
+    QString className;
+    QString subject;
+    QString paper;                // 任务纸张，续扫时恢复相同的扫描区域
+    int totalPages = 0;
+    int completedPages = 0;
+    QStringList files;            // 已完成页面的文件
+    int error = 0;                // ScanManager::ScanError，0 表示进行中
+    QString errorMessage;
+};
 
 class ScanManager : public QObject
 {
     Q_OBJECT
 
 public:
+    // 扫描故障类型（由 SANE 状态文本或 eSCL 请求结果解析）
+    enum ScanError {
+        NoScanError = 0,
+        ScanJammed,           // SANE_STATUS_JAMMED
+        ScanNoDocuments,      // SANE_STATUS_NO_DOCS
+        ScanCoverOpen,        // SANE_STATUS_COVER_OPEN
+        ScanDeviceBusy,       // SANE_STATUS_DEVICE_BUSY
+        ScanIoError,          // SANE_STATUS_IO_ERROR
+        ScanTimedOut,
+        ScanOtherError
+    };
+    Q_ENUM(ScanError)
+
     explicit ScanManager(QObject *parent = nullptr);
     ~ScanManager();
 
@@ -22,15 +83,61 @@ public:
     
     // 批量扫描
     bool startBatchScan(const QString &deviceName, const QString &examType, 
-                       const QString &className, const QString &subject, int pageCount);
+                       const QString &className, const QString &subject, int pageCount,
+                       const QString &paper = QString());
+    
+    // 批量扫描断点续扫：故障中断后保留已完成的页面，排除故障后从下一页继续
+    static ScanError parseSaneStatus(const QString &message);
+    static ScanError classifyEsclError(const QString &message);
+    static bool isRecoverableScanError(ScanError error);
+    bool hasBatchCheckpoint(const QString &deviceName) const;
+    BatchCheckpoint batchCheckpoint(const QString &deviceName) const;
+    bool resumeBatchScan(const QString &deviceName);        // 不依赖 eSCL 进纸器事件，界面也可直接调用
+    void discardBatchCheckpoint(const QString &deviceName);
     
     // 扫描设置
     void setScanSettings(const QString &deviceName, int dpi = 300, const QString &format = "jpeg", 
                         const QString &mode = "Color", bool duplex = false);
     
+    // 按任务的扫描配置：纸张字段换算为扫描区域（A4 只扫约一半面积），批量扫描按断点中的纸张自动设置
+    static ScanProfile scanProfileForPaper(const QString &paper);
+    void setScanProfile(const QString &deviceName, const ScanProfile &profile);
+    ScanProfile scanProfile(const QString &deviceName) const;   // 合并设备设置后的实际取值
+    
+    // 扫描仪能力：首次使用时探测并缓存到本地，扫描参数在启动前按能力校正
+    ScanCapabilities getScanCapabilities(const QString &deviceName);
+    void refreshScanCapabilities(const QString &deviceName);
+    static ScanCapabilities parseScanOptions(const QString &output);
+    ProcessWatchdog *watchdog() const { return m_watchdog; }
+    bool clampScanSettings(const QString &deviceName, int *dpi, QString *mode, QString *source,
+                           double *widthMm, double *heightMm, QString *error = nullptr);
+    
+    // eSCL 直连扫描：设置后该设备不再经过 SANE/scanimage，传入空地址恢复原方式
+    void setEsclEndpoint(const QString &deviceName, const QUrl &baseUrl);
+    bool hasEsclEndpoint(const QString &deviceName) const { return m_esclClients.contains(deviceName); }
+    
+    // 扫描后处理：启用后每页完成时提交到后处理线程池，结果通过 pageProcessed 返回
+    void setPostProcessing(const QString &deviceName, const PageProcessOptions &options);
+    void disablePostProcessing(const QString &deviceName);
+    bool hasPostProcessing(const QString &deviceName) const { return m_postProcessing.contains(deviceName); }
+    PageProcessor *pageProcessor() const { return m_pageProcessor; }
+    PageBufferPool *bufferPool() const { return m_bufferPool; }
+    
+    // 每页字节预算（按考试设置）：启用后处理的 SANE 扫描以 PNM 采集，在进程内按预算编码 JPEG
+    void setExamByteBudget(const QString &examType, qint64 bytesPerPage);
+    
+    // 黑白输出（按考试设置）：otsu/sauvola 二值化后以 CCITT G4 TIFF 保存，彩色扫描改为灰度采集；传入空字符串取消
+    void setExamBinarization(const QString &examType, const QString &method);
+    
+    // 答题卡版面（按考试设置，随班级信息下发）：启用后处理时每页按定位标记配准，只上传答题区域拼图
+    void setExamLayout(const QString &examType, const ExamLayout &layout);
+    bool hasExamLayout(const QString &examType) const { return m_examLayouts.contains(examType); }
+    
     // 网络上传功能
     void uploadFile(const QString &deviceName, const QString &filePath, 
                    const QString &parentPath = "/exam/");
+    void uploadFiles(const QString &deviceName, const QStringList &filePaths,
+                    const QString &parentPath = "/exam/");   // 一次请求上传多个文件
     void setUploadServer(const QString &serverUrl = "http://117.72.74.246:18000");
     
     // 模拟扫描功能（用于测试）
@@ -46,6 +153,10 @@ signals:
     void scanCompleted(const QString &deviceName, const QString &filePath);
     void scanError(const QString &deviceName, const QString &error);
     void batchScanCompleted(const QString &deviceName, const QStringList &filePaths);
+    void pageProcessed(const QString &deviceName, const PageResult &result);
+    void batchScanInterrupted(const QString &deviceName, ScanManager::ScanError error,
+                              int completedPages, int totalPages);
+    void batchScanFailed(const QString &deviceName, const QString &error);   // 不可续扫的故障，批次已结束
     
     // 上传信号
     void uploadStarted(const QString &deviceName, const QString &filePath);
@@ -66,18 +177,25 @@ private:
     // 进程管理
     QMap<QString, QProcess*> m_scanProcesses;
     QMap<QString, QProcess*> m_uploadProcesses;
+    QMap<QString, QList<QPair<QStringList, QString>>> m_pendingUploads;  // 设备 -> (文件, 上传目录)
+    QMap<QString, QStringList> m_uploadingFiles;   // 设备 -> 正在上传的文件，按表单顺序对应响应中的地址
     
     // 批量扫描相关
     QTimer *m_batchTimer;
     QMap<QString, QStringList> m_batchFiles;
     QMap<QString, int> m_batchPageCounts;
-    QMap<QString, int> m_currentPages;
+    QMap<QString, int> m_currentPages;             // 设备 -> 已完成页数
+    QMap<QString, QString> m_batchInFlight;        // 设备 -> 正在扫描的页面文件
+    QMap<QString, QString> m_scanOutputPaths;      // 设备 -> 当前扫描的输出文件
+    QMap<QString, BatchCheckpoint> m_batchCheckpoints;  // 设备 -> 批量扫描断点
     
     // 扫描设置
     QMap<QString, int> m_scanDpi;
     QMap<QString, QString> m_scanFormat;
     QMap<QString, QString> m_scanMode;
     QMap<QString, bool> m_scanDuplex;
+    QMap<QString, ScanCapabilities> m_scanCapabilities;  // 设备 -> 扫描仪能力
+    QMap<QString, ScanProfile> m_scanProfiles;           // 设备 -> 当前任务的扫描配置
     
     // 网络设置
     QString m_uploadServer;
@@ -85,14 +203,59 @@ private:
     // 模拟模式
     bool m_simulationMode;
     
+    // 外部进程看门狗与能力探测
+    ProcessWatchdog *m_watchdog;
+    QMap<QString, QProcess*> m_probeProcesses;     // 设备 -> scanimage -A 进程
+    QMap<QString, QString> m_scansAwaitingProbe;   // 设备 -> 等待探测完成的输出路径
+    QMap<QString, QString> m_scanTimeouts;         // 设备 -> 超时阶段
+    
+    // 扫描后处理（条带缓冲区来自缓冲池）
+    PageBufferPool *m_bufferPool;
+    PageProcessor *m_pageProcessor;
+    QMap<QString, PageProcessOptions> m_postProcessing;   // 设备 -> 后处理选项
+    QMap<QString, qint64> m_examByteBudgets;              // 考试类型 -> 每页字节预算
+    QMap<QString, QString> m_examBinarizations;           // 考试类型 -> 二值化方法
+    QMap<QString, ExamLayout> m_examLayouts;              // 考试类型 -> 答题卡版面
+    QMap<QString, int> m_processingPages;                 // 设备 -> 正在后处理的页数
+    QMap<QString, QStringList> m_processedBatches;        // 设备 -> 已扫描完、等待后处理结束的批次
+    
+    // eSCL 直连扫描
+    QMap<QString, EsclClient*> m_esclClients;      // 设备 -> eSCL 客户端
+    QMap<QString, QString> m_esclOutputPaths;      // 设备 -> 单次扫描的输出路径
+    QMap<QString, int> m_esclBatchTotals;          // 设备 -> 批量扫描页数
+    QMap<QString, int> m_esclPageOffsets;          // 设备 -> 续扫前已完成的页数
+    
     // 辅助方法
     QString buildScanCommand(const QString &deviceName, const QString &outputPath);
+    QStringList buildScanArguments(const QString &deviceName, const QString &outputPath, QString *error = nullptr);
+    QString capabilityCachePath(const QString &deviceName) const;
+    void startCapabilityProbe(const QString &deviceName);
+    void storeScanCapabilities(const QString &deviceName, const QString &output);
+    bool launchScan(const QString &deviceName, const QString &outputPath);
+    bool startEsclScan(const QString &deviceName, const QString &outputPath, int maxPages);
+    bool buildEsclSettings(const QString &deviceName, EsclScanSettings *settings, QString *error);
+    void onEsclPage(const QString &deviceName, int page, const QByteArray &data);
+    void onEsclFinished(const QString &deviceName, int pages, const QString &error);
     QString getScanOutputPath(const QString &deviceName, int pageNumber = -1);
+    bool runBatchScan(const QString &deviceName);
+    void startNextBatchPage(const QString &deviceName);
+    void completeBatchPage(const QString &deviceName);
+    void finishScannedPage(const QString &deviceName, const QString &filePath);
+    void finishBatch(const QString &deviceName, const QStringList &filePaths);
+    void onPageProcessed(const QString &deviceName, const PageResult &result);
+    QString acquisitionFormat(const QString &deviceName) const;
+    QString acquisitionMode(const QString &deviceName) const;
+    QString batchBinarization(const QString &deviceName) const;
+    void failScan(const QString &deviceName, ScanError error, const QString &message);
+    QString checkpointPath(const QString &deviceName) const;
+    void saveBatchCheckpoint(const QString &deviceName);
+    void loadBatchCheckpoint(const QString &deviceName);
     void createOutputDirectory(const QString &deviceName);
     
     // 进程管理
     QProcess* getOrCreateScanProcess(const QString &deviceName);
     QProcess* getOrCreateUploadProcess(const QString &deviceName);
+    void uploadNextFiles(const QString &deviceName);
     void cleanupProcess(const QString &deviceName, const QString &processType);
 };
 
@@ -0,0 +1,341 @@
+#include "stripimage.h"
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+void stripJpegErrorExit(j_common_ptr info)
+{
+    StripJpegError *error = reinterpret_cast<StripJpegError*>(info->err);
+    (*info->err->format_message)(info, error->message);
+    longjmp(error->jump, 1);
+}
+
+void stripJpegSilence(j_common_ptr, int)
+{
+    // 不输出libjpeg的警告信息
+}
+}
+
+// ===== StripReader =====
+
+StripReader *StripReader::open(const QString &filePath, QString *error)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) *error = file.errorString();
+        return nullptr;
+    }
+    QByteArray magic = file.read(2);
+    file.close();
+    
+    if (magic == "P5" || magic == "P6") {
+        PnmStripReader *reader = new PnmStripReader;
+        if (reader->open(filePath)) {
+            return reader;
+        }
+        if (error) *error = reader->errorString();
+        delete reader;
+        return nullptr;
+    }
+    if (magic == QByteArray("\xFF\xD8", 2)) {
+        JpegStripReader *reader = new JpegStripReader;
+        if (reader->open(filePath)) {
+            return reader;
+        }
+        if (error) *error = reader->errorString();
+        delete reader;
+        return nullptr;
+    }
+    
+    if (error) *error = "Unsupported strip image format";
+    return nullptr;
+}
+
+// ===== PnmStripReader =====
+
+bool PnmStripReader::readHeaderValue(int *value)
+{
+    // 跳过空白和 # 注释
+    char c = 0;
+    while (m_file.getChar(&c)) {
+        if (c == '#') {
+            while (m_file.getChar(&c) && c != '\n') {}
+        } else if (!isspace(uchar(c))) {
+            break;
+        }
+    }
+    if (!isdigit(uchar(c))) {
+        return false;
+    }
+    
+    int result = 0;
+    do {
+        result = result * 10 + (c - '0');
+    } while (m_file.getChar(&c) && isdigit(uchar(c)));
+    // 数值后的一个空白字符属于头部，之后才是像素数据
+    *value = result;
+    return true;
+}
+
+bool PnmStripReader::open(const QString &filePath)
+{
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    
+    QByteArray magic = m_file.read(2);
+    m_channels = magic == "P6" ? 3 : 1;
+    
+    int maxValue = 0;
+    if (!readHeaderValue(&m_width) || !readHeaderValue(&m_height) || !readHeaderValue(&maxValue)) {
+        m_error = "Invalid PNM header";
+        return false;
+    }
+    if (maxValue != 255 || m_width <= 0 || m_height <= 0) {
+        m_error = QString("Unsupported PNM: %1x%2 maxval %3").arg(m_width).arg(m_height).arg(maxValue);
+        return false;
+    }
+    return true;
+}
+
+int PnmStripReader::readRows(uchar *buffer, int maxRows)
+{
+    int rows = qMin(maxRows, m_height - m_rowsRead);
+    if (rows <= 0) {
+        return 0;
+    }
+    
+    qint64 bytes = qint64(rows) * rowBytes();
+    if (m_file.read(reinterpret_cast<char*>(buffer), bytes) != bytes) {
+        m_error = "Truncated PNM data";
+        return -1;
+    }
+    m_rowsRead += rows;
+    return rows;
+}
+
+// ===== JpegStripReader =====
+
+JpegStripReader::JpegStripReader()
+    : m_file(nullptr),
+      m_started(false)
+{
+    m_jpeg.err = jpeg_std_error(&m_jpegError.manager);
+    m_jpegError.manager.error_exit = stripJpegErrorExit;
+    m_jpegError.manager.emit_message = stripJpegSilence;
+    jpeg_create_decompress(&m_jpeg);
+}
+
+JpegStripReader::~JpegStripReader()
+{
+    jpeg_destroy_decompress(&m_jpeg);
+    if (m_file) {
+        fclose(m_file);
+    }
+}
+
+bool JpegStripReader::open(const QString &filePath)
+{
+    m_file = fopen(QFile::encodeName(filePath).constData(), "rb");
+    if (!m_file) {
+        m_error = "Cannot open " + filePath;
+        return false;
+    }
+    
+    if (setjmp(m_jpegError.jump)) {
+        m_error = QString::fromLatin1(m_jpegError.message);
+        return false;
+    }
+    
+    jpeg_stdio_src(&m_jpeg, m_file);
+    jpeg_read_header(&m_jpeg, TRUE);
+    
+    // 灰度保持单通道，其余（YCbCr/CMYK 以外）统一输出 RGB
+    if (m_jpeg.jpeg_color_space == JCS_GRAYSCALE) {
+        m_jpeg.out_color_space = JCS_GRAYSCALE;
+    } else {
+        m_jpeg.out_color_space = JCS_RGB;
+    }
+    jpeg_start_decompress(&m_jpeg);
+    m_started = true;
+    
+    m_width = m_jpeg.output_width;
+    m_height = m_jpeg.output_height;
+    m_channels = m_jpeg.output_components;
+    return true;
+}
+
+int JpegStripReader::readRows(uchar *buffer, int maxRows)
+{
+    if (!m_started) {
+        return -1;
+    }
+    if (setjmp(m_jpegError.jump)) {
+        m_error = QString::fromLatin1(m_jpegError.message);
+        return -1;
+    }
+    
+    int rows = 0;
+    int stride = rowBytes();
+    while (rows < maxRows && m_jpeg.output_scanline < m_jpeg.output_height) {
+        JSAMPROW row = buffer + qint64(rows) * stride;
+        rows += jpeg_read_scanlines(&m_jpeg, &row, 1);
+    }
+    
+    if (m_jpeg.output_scanline >= m_jpeg.output_height) {
+        jpeg_finish_decompress(&m_jpeg);
+        m_started = false;
+    }
+    return rows;
+}
+
+// ===== JpegStripWriter =====
+
+JpegStripWriter::JpegStripWriter()
+    : m_file(nullptr),
+      m_started(false)
+{
+    m_jpeg.err = jpeg_std_error(&m_jpegError.manager);
+    m_jpegError.manager.error_exit = stripJpegErrorExit;
+    m_jpegError.manager.emit_message = stripJpegSilence;
+    jpeg_create_compress(&m_jpeg);
+}
+
+JpegStripWriter::~JpegStripWriter()
+{
+    jpeg_destroy_compress(&m_jpeg);
+    if (m_file) {
+        fclose(m_file);
+    }
+}
+
+bool JpegStripWriter::open(const QString &filePath, int width, int height, int channels, int quality, int dpi)
+{
+    m_file = fopen(QFile::encodeName(filePath).constData(), "wb");
+    if (!m_file) {
+        m_error = "Cannot create " + filePath;
+        return false;
+    }
+    
+    if (setjmp(m_jpegError.jump)) {
+        m_error = QString::fromLatin1(m_jpegError.message);
+        return false;
+    }
+    
+    jpeg_stdio_dest(&m_jpeg, m_file);
+    m_jpeg.image_width = width;
+    m_jpeg.image_height = height;
+    m_jpeg.input_components = channels;
+    m_jpeg.in_color_space = channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&m_jpeg);
+    jpeg_set_quality(&m_jpeg, quality, TRUE);
+    if (dpi > 0) {
+        m_jpeg.density_unit = 1;
+        m_jpeg.X_density = dpi;
+        m_jpeg.Y_density = dpi;
+    }
+    jpeg_start_compress(&m_jpeg, TRUE);
+    m_started = true;
+    return true;
+}
+
+bool JpegStripWriter::writeRows(const uchar *buffer, int rows, int stride)
+{
+    if (!m_started) {
+        return false;
+    }
+    if (setjmp(m_jpegError.jump)) {
+        m_error = QString::fromLatin1(m_jpegError.message);
+        m_started = false;
+        return false;
+    }
+    
+    for (int i = 0; i < rows; ++i) {
+        JSAMPROW row = const_cast<uchar*>(buffer + qint64(i) * stride);
+        jpeg_write_scanlines(&m_jpeg, &row, 1);
+    }
+    return true;
+}
+
+bool JpegStripWriter::finish()
+{
+    if (!m_started) {
+        return false;
+    }
+    if (setjmp(m_jpegError.jump)) {
+        m_error = QString::fromLatin1(m_jpegError.message);
+        m_started = false;
+        return false;
+    }
+    
+    jpeg_finish_compress(&m_jpeg);
+    m_started = false;
+    
+    bool ok = fclose(m_file) == 0;
+    m_file = nullptr;
+    if (!ok) {
+        m_error = "Failed to flush JPEG file";
+    }
+    return ok;
+}
+
+qint64 JpegStripWriter::encodedSize(const uchar *buffer, int width, int height, int channels, int stride,
+                                    int quality)
+{
+    jpeg_compress_struct jpeg;
+    StripJpegError jpegError;
+    unsigned char *output = nullptr;
+    unsigned long outputSize = 0;
+    
+    jpeg.err = jpeg_std_error(&jpegError.manager);
+    jpegError.manager.error_exit = stripJpegErrorExit;
+    jpegError.manager.emit_message = stripJpegSilence;
+    jpeg_create_compress(&jpeg);
+    
+    if (setjmp(jpegError.jump)) {
+        jpeg_destroy_compress(&jpeg);
+        free(output);
+        return -1;
+    }
+    
+    jpeg_mem_dest(&jpeg, &output, &outputSize);
+    jpeg.image_width = width;
+    jpeg.image_height = height;
+    jpeg.input_components = channels;
+    jpeg.in_color_space = channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&jpeg);
+    jpeg_set_quality(&jpeg, quality, TRUE);
+    jpeg_start_compress(&jpeg, TRUE);
+    for (int i = 0; i < height; ++i) {
+        JSAMPROW row = const_cast<uchar*>(buffer + qint64(i) * stride);
+        jpeg_write_scanlines(&jpeg, &row, 1);
+    }
+    jpeg_finish_compress(&jpeg);
+    
+    qint64 size = qint64(outputSize);
+    jpeg_destroy_compress(&jpeg);
+    free(output);
+    return size;
+}
+
+// ===== StripOps =====
+
+void StripOps::rgbToGray(const uchar *src, uchar *dst, int pixels)
+{
+    for (int i = 0; i < pixels; ++i, src += 3) {
+        dst[i] = uchar((src[0] * 77 + src[1] * 150 + src[2] * 29) >> 8);
+    }
+}
+
+int StripOps::countInk(const uchar *grayRow, int x0, int x1, int threshold, int step)
+{
+    int ink = 0;
+    for (int x = x0; x < x1; x += step) {
+        if (grayRow[x] < threshold) {
+            ++ink;
+        }
+    }
+    return ink;
+}
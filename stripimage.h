@@ -0,0 +1,109 @@
+#ifndef STRIPIMAGE_H
+#define STRIPIMAGE_H
+
+#include <QString>
+#include <QFile>
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+// 按条带（固定行数）读写图像：整页不进入内存，600dpi A3 彩色页也只占用几MB
+
+// libjpeg 错误处理：出错时跳回调用点，不直接退出进程
+struct StripJpegError
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+// 条带读取接口，按行顺序读取 8 位灰度或 RGB 像素
+class StripReader
+{
+public:
+    virtual ~StripReader() {}
+    
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int channels() const { return m_channels; }
+    int rowBytes() const { return m_width * m_channels; }
+    QString errorString() const { return m_error; }
+    
+    // 读取最多 maxRows 行到 buffer（行间距为 rowBytes()），返回实际行数，出错返回 -1
+    virtual int readRows(uchar *buffer, int maxRows) = 0;
+    
+    // 按文件头选择读取器（PNM P5/P6 或 JPEG），不支持的格式返回 nullptr
+    static StripReader *open(const QString &filePath, QString *error = nullptr);
+
+protected:
+    int m_width = 0;
+    int m_height = 0;
+    int m_channels = 0;
+    QString m_error;
+};
+
+// PNM（scanimage --format=pnm 的输出）：P5 灰度 / P6 RGB，maxval 255
+class PnmStripReader : public StripReader
+{
+public:
+    bool open(const QString &filePath);
+    int readRows(uchar *buffer, int maxRows) override;
+
+private:
+    QFile m_file;
+    int m_rowsRead = 0;
+    
+    bool readHeaderValue(int *value);
+};
+
+// JPEG：libjpeg 逐行解码
+class JpegStripReader : public StripReader
+{
+public:
+    JpegStripReader();
+    ~JpegStripReader();
+    
+    bool open(const QString &filePath);
+    int readRows(uchar *buffer, int maxRows) override;
+
+private:
+    jpeg_decompress_struct m_jpeg;
+    StripJpegError m_jpegError;
+    FILE *m_file;
+    bool m_started;
+};
+
+// JPEG 条带编码：libjpeg 逐行压缩写入文件
+class JpegStripWriter
+{
+public:
+    JpegStripWriter();
+    ~JpegStripWriter();
+    
+    bool open(const QString &filePath, int width, int height, int channels, int quality, int dpi = 0);
+    bool writeRows(const uchar *buffer, int rows, int stride);
+    bool finish();
+    QString errorString() const { return m_error; }
+    
+    // 在内存中编码并返回字节数（用于质量搜索），出错返回 -1
+    static qint64 encodedSize(const uchar *buffer, int width, int height, int channels, int stride, int quality);
+
+private:
+    jpeg_compress_struct m_jpeg;
+    StripJpegError m_jpegError;
+    FILE *m_file;
+    bool m_started;
+    QString m_error;
+};
+
+// 条带上的像素运算
+namespace StripOps
+{
+    // RGB 转 8 位灰度（ITU-R BT.601 整数近似），src 与 dst 可以是同一块内存
+    void rgbToGray(const uchar *src, uchar *dst, int pixels);
+    
+    // 统计 [x0, x1) 范围内低于阈值的像素数，每 step 个像素采样一次
+    int countInk(const uchar *grayRow, int x0, int x1, int threshold, int step);
+}
+
+#endif // STRIPIMAGE_H